@@ -0,0 +1,308 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#include "BVH.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace Util {
+    namespace Renderer {
+        namespace {
+            constexpr uint32_t binCount = 12;
+            // Leaves this small are never split further
+            constexpr uint32_t leafItems = 2;
+            // Cost of visiting an inner node relative to testing one item
+            constexpr float traversalCost = 1.0f;
+
+            Aabb combine(const Aabb &a, const Aabb &b) {
+                Aabb result = a;
+                result.grow(b);
+                return result;
+            }
+        }
+
+        void BVH::build(const Aabb *bounds, uint32_t count) {
+            nodes.clear();
+            items.resize(count);
+            std::iota(items.begin(), items.end(), 0u);
+            if (count == 0) {
+                return;
+            }
+            // A binary tree over count leaves never has more nodes, so references stay valid while building
+            nodes.reserve(2 * count - 1);
+            nodes.push_back({ {}, 0, count });
+
+            struct Task {
+                uint32_t node;
+                uint32_t depth;
+            };
+            std::vector<Task> tasks;
+            tasks.push_back({ 0, 0 });
+            while (!tasks.empty()) {
+                const Task task = tasks.back();
+                tasks.pop_back();
+                Node &node = nodes[task.node];
+
+                Aabb centroidBounds;
+                for (uint32_t i = 0; i < node.count; i++) {
+                    const Aabb &itemBounds = bounds[items[node.first + i]];
+                    node.bounds.grow(itemBounds);
+                    centroidBounds.grow(itemBounds.center());
+                }
+                if (node.count <= leafItems || task.depth >= maxDepth) {
+                    continue;
+                }
+
+                // Binned SAH over the axis with the cheapest split
+                float bestCost = static_cast<float>(node.count) * node.bounds.area();
+                int bestAxis = -1;
+                uint32_t bestBin = 0;
+                for (int axis = 0; axis < 3; axis++) {
+                    const float minimum = centroidBounds.min[axis];
+                    const float extent = centroidBounds.max[axis] - minimum;
+                    if (extent <= 0.0f) {
+                        continue;
+                    }
+                    const float scale = static_cast<float>(binCount) / extent;
+                    Aabb binBounds[binCount];
+                    uint32_t binItems[binCount] = {};
+                    for (uint32_t i = 0; i < node.count; i++) {
+                        const Aabb &itemBounds = bounds[items[node.first + i]];
+                        const auto bin = std::min(binCount - 1, static_cast<uint32_t>((itemBounds.center()[axis] - minimum) * scale));
+                        binBounds[bin].grow(itemBounds);
+                        binItems[bin]++;
+                    }
+                    // Right side areas and counts of every split plane, then sweep from the left
+                    float rightArea[binCount - 1];
+                    uint32_t rightItems[binCount - 1];
+                    Aabb right;
+                    uint32_t rightCount = 0;
+                    for (uint32_t bin = binCount - 1; bin > 0; bin--) {
+                        right.grow(binBounds[bin]);
+                        rightCount += binItems[bin];
+                        rightArea[bin - 1] = rightCount > 0 ? right.area() : 0.0f;
+                        rightItems[bin - 1] = rightCount;
+                    }
+                    Aabb left;
+                    uint32_t leftCount = 0;
+                    for (uint32_t split = 0; split < binCount - 1; split++) {
+                        left.grow(binBounds[split]);
+                        leftCount += binItems[split];
+                        if (leftCount == 0 || rightItems[split] == 0) {
+                            continue;
+                        }
+                        const float cost = traversalCost * node.bounds.area() +
+                                           static_cast<float>(leftCount) * left.area() + static_cast<float>(rightItems[split]) * rightArea[split];
+                        if (cost < bestCost) {
+                            bestCost = cost;
+                            bestAxis = axis;
+                            bestBin = split;
+                        }
+                    }
+                }
+                if (bestAxis < 0) {
+                    continue;
+                }
+
+                const float minimum = centroidBounds.min[bestAxis];
+                const float scale = static_cast<float>(binCount) / (centroidBounds.max[bestAxis] - minimum);
+                auto *begin = items.data() + node.first;
+                auto *middle = std::partition(begin, begin + node.count, [&](uint32_t item) {
+                    const auto bin = std::min(binCount - 1, static_cast<uint32_t>((bounds[item].center()[bestAxis] - minimum) * scale));
+                    return bin <= bestBin;
+                });
+                const auto leftCount = static_cast<uint32_t>(middle - begin);
+                if (leftCount == 0 || leftCount == node.count) {
+                    continue;
+                }
+
+                const auto leftChild = static_cast<uint32_t>(nodes.size());
+                nodes.push_back({ {}, node.first, leftCount });
+                nodes.push_back({ {}, node.first + leftCount, node.count - leftCount });
+                node.first = leftChild;
+                node.count = 0;
+                tasks.push_back({ leftChild, task.depth + 1 });
+                tasks.push_back({ leftChild + 1, task.depth + 1 });
+            }
+        }
+
+        void BVH::refit(const Aabb *bounds) {
+            // Children are always stored after their parent
+            for (size_t i = nodes.size(); i-- > 0;) {
+                Node &node = nodes[i];
+                if (node.count > 0) {
+                    node.bounds = Aabb();
+                    for (uint32_t j = 0; j < node.count; j++) {
+                        node.bounds.grow(bounds[items[node.first + j]]);
+                    }
+                } else {
+                    node.bounds = combine(nodes[node.first].bounds, nodes[node.first + 1].bounds);
+                }
+            }
+        }
+
+        DynamicBVH::DynamicBVH(float _margin)
+            : margin(_margin) { }
+
+        int32_t DynamicBVH::allocateNode() {
+            int32_t node;
+            if (freeList != nullNode) {
+                node = freeList;
+                freeList = nodes[node].parent;
+            } else {
+                node = static_cast<int32_t>(nodes.size());
+                nodes.emplace_back();
+            }
+            nodes[node].parent = nullNode;
+            nodes[node].child1 = nullNode;
+            nodes[node].child2 = nullNode;
+            nodes[node].item = 0;
+            return node;
+        }
+
+        void DynamicBVH::freeNode(int32_t node) {
+            nodes[node].parent = freeList;
+            nodes[node].child1 = nullNode;
+            nodes[node].child2 = nullNode;
+            freeList = node;
+        }
+
+        int32_t DynamicBVH::insert(const Aabb &bounds, uint32_t item) {
+            const int32_t leaf = allocateNode();
+            nodes[leaf].bounds = Aabb(bounds.min - glm::vec3(margin), bounds.max + glm::vec3(margin));
+            nodes[leaf].item = item;
+            insertLeaf(leaf);
+            return leaf;
+        }
+
+        void DynamicBVH::remove(int32_t proxy) {
+            removeLeaf(proxy);
+            freeNode(proxy);
+        }
+
+        bool DynamicBVH::move(int32_t proxy, const Aabb &bounds) {
+            Node &leaf = nodes[proxy];
+            if (leaf.bounds.contains(bounds)) {
+                return false;
+            }
+            leaf.bounds = Aabb(bounds.min - glm::vec3(margin), bounds.max + glm::vec3(margin));
+            refitAncestors(leaf.parent);
+            return true;
+        }
+
+        void DynamicBVH::optimize() {
+            std::vector<int32_t> leaves;
+            std::vector<int32_t> stack;
+            if (root != nullNode) {
+                stack.push_back(root);
+            }
+            while (!stack.empty()) {
+                const int32_t node = stack.back();
+                stack.pop_back();
+                if (nodes[node].isLeaf()) {
+                    leaves.push_back(node);
+                    continue;
+                }
+                stack.push_back(nodes[node].child1);
+                stack.push_back(nodes[node].child2);
+                freeNode(node);
+            }
+            root = nullNode;
+            // Large leaves first gives the insertion heuristic a better upper tree
+            std::sort(leaves.begin(), leaves.end(), [this](int32_t a, int32_t b) {
+                return nodes[a].bounds.area() > nodes[b].bounds.area();
+            });
+            for (int32_t leaf : leaves) {
+                insertLeaf(leaf);
+            }
+        }
+
+        void DynamicBVH::clear() {
+            nodes.clear();
+            root = nullNode;
+            freeList = nullNode;
+        }
+
+        void DynamicBVH::insertLeaf(int32_t leaf) {
+            nodes[leaf].parent = nullNode;
+            if (root == nullNode) {
+                root = leaf;
+                return;
+            }
+
+            // Descend towards the sibling with the smallest increase in surface area
+            const Aabb leafBounds = nodes[leaf].bounds;
+            int32_t index = root;
+            while (!nodes[index].isLeaf()) {
+                const Node &node = nodes[index];
+                const float area = node.bounds.area();
+                const float combinedArea = combine(node.bounds, leafBounds).area();
+                // Cost of pairing with this node, and the cost pushed down to its children for enlarging it
+                const float cost = 2.0f * combinedArea;
+                const float inheritanceCost = 2.0f * (combinedArea - area);
+
+                auto childCost = [&](int32_t child) {
+                    const float childArea = combine(nodes[child].bounds, leafBounds).area();
+                    return nodes[child].isLeaf() ? childArea + inheritanceCost
+                                                 : childArea - nodes[child].bounds.area() + inheritanceCost;
+                };
+                const float cost1 = childCost(node.child1);
+                const float cost2 = childCost(node.child2);
+                if (cost < cost1 && cost < cost2) {
+                    break;
+                }
+                index = cost1 < cost2 ? node.child1 : node.child2;
+            }
+
+            const int32_t sibling = index;
+            const int32_t oldParent = nodes[sibling].parent;
+            const int32_t newParent = allocateNode();
+            nodes[newParent].parent = oldParent;
+            nodes[newParent].bounds = combine(leafBounds, nodes[sibling].bounds);
+            nodes[newParent].child1 = sibling;
+            nodes[newParent].child2 = leaf;
+            nodes[sibling].parent = newParent;
+            nodes[leaf].parent = newParent;
+            if (oldParent == nullNode) {
+                root = newParent;
+            } else if (nodes[oldParent].child1 == sibling) {
+                nodes[oldParent].child1 = newParent;
+            } else {
+                nodes[oldParent].child2 = newParent;
+            }
+            refitAncestors(oldParent);
+        }
+
+        void DynamicBVH::removeLeaf(int32_t leaf) {
+            if (leaf == root) {
+                root = nullNode;
+                return;
+            }
+            const int32_t parent = nodes[leaf].parent;
+            const int32_t grandParent = nodes[parent].parent;
+            const int32_t sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+            nodes[sibling].parent = grandParent;
+            if (grandParent == nullNode) {
+                root = sibling;
+            } else {
+                if (nodes[grandParent].child1 == parent) {
+                    nodes[grandParent].child1 = sibling;
+                } else {
+                    nodes[grandParent].child2 = sibling;
+                }
+            }
+            freeNode(parent);
+            refitAncestors(grandParent);
+        }
+
+        void DynamicBVH::refitAncestors(int32_t node) {
+            while (node != nullNode) {
+                Node &current = nodes[node];
+                current.bounds = combine(nodes[current.child1].bounds, nodes[current.child2].bounds);
+                node = current.parent;
+            }
+        }
+    }
+}
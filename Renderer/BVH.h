@@ -0,0 +1,356 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef LIGHTFIELDFORWARDRENDERER_BVH_H
+#define LIGHTFIELDFORWARDRENDERER_BVH_H
+
+#include <cfloat>
+#include <cstdint>
+#include <vector>
+
+#include "Frustum.h"
+
+namespace Util {
+    namespace Renderer {
+        struct Aabb {
+            glm::vec3 min{FLT_MAX};
+            glm::vec3 max{-FLT_MAX};
+
+            Aabb() = default;
+
+            Aabb(const glm::vec3 &_min, const glm::vec3 &_max) : min(_min), max(_max) { }
+
+            static Aabb fromCenterExtent(const glm::vec3 &center, const glm::vec3 &extent) { return { center - extent, center + extent }; }
+
+            void grow(const glm::vec3 &point) {
+                min = glm::min(min, point);
+                max = glm::max(max, point);
+            }
+
+            void grow(const Aabb &other) {
+                min = glm::min(min, other.min);
+                max = glm::max(max, other.max);
+            }
+
+            [[nodiscard]] glm::vec3 center() const { return (min + max) * 0.5f; }
+
+            [[nodiscard]] glm::vec3 extent() const { return (max - min) * 0.5f; }
+
+            /** @brief Half the surface area, the SAH only compares areas */
+            [[nodiscard]] float area() const {
+                const glm::vec3 size = max - min;
+                return size.x * size.y + size.y * size.z + size.z * size.x;
+            }
+
+            [[nodiscard]] bool contains(const Aabb &other) const {
+                return glm::all(glm::lessThanEqual(min, other.min)) && glm::all(glm::greaterThanEqual(max, other.max));
+            }
+
+            [[nodiscard]] bool intersectsSphere(const glm::vec3 &center, float radius) const {
+                const glm::vec3 offset = glm::clamp(center, min, max) - center;
+                return glm::dot(offset, offset) <= radius * radius;
+            }
+
+            /** @brief Slab test, returns the entry distance along the ray or a negative value for a miss */
+            [[nodiscard]] float intersectRay(const glm::vec3 &origin, const glm::vec3 &inverseDirection, float maxDistance) const {
+                const glm::vec3 t0 = (min - origin) * inverseDirection;
+                const glm::vec3 t1 = (max - origin) * inverseDirection;
+                const glm::vec3 near = glm::min(t0, t1);
+                const glm::vec3 far = glm::max(t0, t1);
+                const float enter = glm::max(glm::max(near.x, near.y), glm::max(near.z, 0.0f));
+                const float exit = glm::min(glm::min(far.x, far.y), glm::min(far.z, maxDistance));
+                return enter <= exit ? enter : -1.0f;
+            }
+        };
+
+        /*
+            Bounding volume hierarchy over static bounds, built top down with a binned surface area heuristic
+            Items are indices into the bounds array passed to build
+        */
+        class BVH {
+        public:
+            // Inner nodes have count 0 and their children at first and first + 1, leaves own items [first, first + count)
+            struct Node {
+                Aabb bounds;
+                uint32_t first;
+                uint32_t count;
+            };
+
+            void build(const Aabb *bounds, uint32_t count);
+
+            /** @brief Recomputes the node bounds for moved items while keeping the tree topology */
+            void refit(const Aabb *bounds);
+
+            [[nodiscard]] bool empty() const { return nodes.empty(); }
+
+            [[nodiscard]] const std::vector<Node> &getNodes() const { return nodes; }
+
+            /** @brief Calls visit(item) for every item whose bounds intersect the frustum */
+            template<typename Visit>
+            void queryFrustum(const Frustum &frustum, Visit &&visit) const;
+
+            template<typename Visit>
+            void querySphere(const glm::vec3 &center, float radius, Visit &&visit) const;
+
+            /**
+            * Walks the items in leaves the ray enters, closest leaf first
+            *
+            * @param hit Called as hit(item, maxDistance) to test the item itself, returns the new maximum distance
+            * so closer hits prune the rest
+            */
+            template<typename Hit>
+            void queryRay(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, Hit &&hit) const;
+
+            // Deeper subtrees become leaves, which bounds the traversal stacks
+            static constexpr uint32_t maxDepth = 48;
+
+        private:
+            std::vector<Node> nodes;
+            std::vector<uint32_t> items;
+
+            template<typename Visit>
+            void visitSubtree(uint32_t node, Visit &visit) const;
+        };
+
+        /*
+            Incrementally updated hierarchy for moving bounds
+            Leaves store bounds enlarged by a margin, small moves inside them cost nothing, larger ones refit the ancestors
+        */
+        class DynamicBVH {
+        public:
+            static constexpr int32_t nullNode = -1;
+
+            struct Node {
+                Aabb bounds;
+                int32_t parent;
+                int32_t child1;
+                int32_t child2;
+                uint32_t item;
+
+                [[nodiscard]] bool isLeaf() const { return child1 == nullNode; }
+            };
+
+            explicit DynamicBVH(float margin = 0.1f);
+
+            /** @brief Adds an item and returns its proxy */
+            int32_t insert(const Aabb &bounds, uint32_t item);
+
+            void remove(int32_t proxy);
+
+            /** @brief Updates an item's bounds, returns true when its leaf had to grow */
+            bool move(int32_t proxy, const Aabb &bounds);
+
+            /** @brief Reinserts every leaf, restores the tree quality after many refits */
+            void optimize();
+
+            void clear();
+
+            /** @brief Enlargement of leaves inserted or grown from now on */
+            void setMargin(float _margin) { margin = _margin; }
+
+            [[nodiscard]] bool empty() const { return root == nullNode; }
+
+            template<typename Visit>
+            void queryFrustum(const Frustum &frustum, Visit &&visit) const;
+
+            template<typename Visit>
+            void querySphere(const glm::vec3 &center, float radius, Visit &&visit) const;
+
+            /** @brief Same contract as BVH::queryRay, leaves are enlarged by the margin so hit must test the item itself */
+            template<typename Hit>
+            void queryRay(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, Hit &&hit) const;
+
+        private:
+            std::vector<Node> nodes;
+            int32_t root = nullNode;
+            int32_t freeList = nullNode;
+            float margin;
+
+            int32_t allocateNode();
+
+            void freeNode(int32_t node);
+
+            void insertLeaf(int32_t leaf);
+
+            void removeLeaf(int32_t leaf);
+
+            void refitAncestors(int32_t node);
+        };
+
+        template<typename Visit>
+        void BVH::visitSubtree(uint32_t node, Visit &visit) const {
+            uint32_t stack[maxDepth + 2];
+            uint32_t stackSize = 0;
+            stack[stackSize++] = node;
+            while (stackSize > 0) {
+                const Node &current = nodes[stack[--stackSize]];
+                if (current.count > 0) {
+                    for (uint32_t i = 0; i < current.count; i++) {
+                        visit(items[current.first + i]);
+                    }
+                    continue;
+                }
+                stack[stackSize++] = current.first;
+                stack[stackSize++] = current.first + 1;
+            }
+        }
+
+        template<typename Visit>
+        void BVH::queryFrustum(const Frustum &frustum, Visit &&visit) const {
+            if (nodes.empty()) {
+                return;
+            }
+            uint32_t stack[maxDepth + 2];
+            uint32_t stackSize = 0;
+            stack[stackSize++] = 0;
+            while (stackSize > 0) {
+                const Node &node = nodes[stack[--stackSize]];
+                const Frustum::Containment containment = frustum.classifyBox(node.bounds.center(), node.bounds.extent());
+                if (containment == Frustum::Outside) {
+                    continue;
+                }
+                if (containment == Frustum::Inside) {
+                    // Everything below is visible without further tests
+                    visitSubtree(static_cast<uint32_t>(&node - nodes.data()), visit);
+                    continue;
+                }
+                if (node.count > 0) {
+                    for (uint32_t i = 0; i < node.count; i++) {
+                        visit(items[node.first + i]);
+                    }
+                    continue;
+                }
+                stack[stackSize++] = node.first;
+                stack[stackSize++] = node.first + 1;
+            }
+        }
+
+        template<typename Visit>
+        void BVH::querySphere(const glm::vec3 &center, float radius, Visit &&visit) const {
+            if (nodes.empty()) {
+                return;
+            }
+            uint32_t stack[maxDepth + 2];
+            uint32_t stackSize = 0;
+            stack[stackSize++] = 0;
+            while (stackSize > 0) {
+                const Node &node = nodes[stack[--stackSize]];
+                if (!node.bounds.intersectsSphere(center, radius)) {
+                    continue;
+                }
+                if (node.count > 0) {
+                    for (uint32_t i = 0; i < node.count; i++) {
+                        visit(items[node.first + i]);
+                    }
+                    continue;
+                }
+                stack[stackSize++] = node.first;
+                stack[stackSize++] = node.first + 1;
+            }
+        }
+
+        template<typename Hit>
+        void BVH::queryRay(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, Hit &&hit) const {
+            if (nodes.empty()) {
+                return;
+            }
+            const glm::vec3 inverseDirection = 1.0f / direction;
+            uint32_t stack[maxDepth + 2];
+            uint32_t stackSize = 0;
+            if (nodes[0].bounds.intersectRay(origin, inverseDirection, maxDistance) >= 0.0f) {
+                stack[stackSize++] = 0;
+            }
+            while (stackSize > 0) {
+                const Node &node = nodes[stack[--stackSize]];
+                if (node.count > 0) {
+                    // Closer hits found since this leaf was pushed may have moved it out of range
+                    if (node.bounds.intersectRay(origin, inverseDirection, maxDistance) < 0.0f) {
+                        continue;
+                    }
+                    for (uint32_t i = 0; i < node.count; i++) {
+                        maxDistance = hit(items[node.first + i], maxDistance);
+                    }
+                    continue;
+                }
+                const float distance1 = nodes[node.first].bounds.intersectRay(origin, inverseDirection, maxDistance);
+                const float distance2 = nodes[node.first + 1].bounds.intersectRay(origin, inverseDirection, maxDistance);
+                // Push the far child first so the near one is visited first
+                if (distance1 >= 0.0f && distance2 >= 0.0f) {
+                    stack[stackSize++] = distance1 <= distance2 ? node.first + 1 : node.first;
+                    stack[stackSize++] = distance1 <= distance2 ? node.first : node.first + 1;
+                } else if (distance1 >= 0.0f) {
+                    stack[stackSize++] = node.first;
+                } else if (distance2 >= 0.0f) {
+                    stack[stackSize++] = node.first + 1;
+                }
+            }
+        }
+
+        template<typename Visit>
+        void DynamicBVH::queryFrustum(const Frustum &frustum, Visit &&visit) const {
+            std::vector<int32_t> stack;
+            if (root != nullNode) {
+                stack.push_back(root);
+            }
+            while (!stack.empty()) {
+                const Node &node = nodes[stack.back()];
+                stack.pop_back();
+                if (!frustum.intersectsBox(node.bounds.center(), node.bounds.extent())) {
+                    continue;
+                }
+                if (node.isLeaf()) {
+                    visit(node.item);
+                    continue;
+                }
+                stack.push_back(node.child1);
+                stack.push_back(node.child2);
+            }
+        }
+
+        template<typename Visit>
+        void DynamicBVH::querySphere(const glm::vec3 &center, float radius, Visit &&visit) const {
+            std::vector<int32_t> stack;
+            if (root != nullNode) {
+                stack.push_back(root);
+            }
+            while (!stack.empty()) {
+                const Node &node = nodes[stack.back()];
+                stack.pop_back();
+                if (!node.bounds.intersectsSphere(center, radius)) {
+                    continue;
+                }
+                if (node.isLeaf()) {
+                    visit(node.item);
+                    continue;
+                }
+                stack.push_back(node.child1);
+                stack.push_back(node.child2);
+            }
+        }
+
+        template<typename Hit>
+        void DynamicBVH::queryRay(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, Hit &&hit) const {
+            const glm::vec3 inverseDirection = 1.0f / direction;
+            std::vector<int32_t> stack;
+            if (root != nullNode) {
+                stack.push_back(root);
+            }
+            while (!stack.empty()) {
+                const Node &node = nodes[stack.back()];
+                stack.pop_back();
+                if (node.bounds.intersectRay(origin, inverseDirection, maxDistance) < 0.0f) {
+                    continue;
+                }
+                if (node.isLeaf()) {
+                    maxDistance = hit(node.item, maxDistance);
+                    continue;
+                }
+                stack.push_back(node.child1);
+                stack.push_back(node.child2);
+            }
+        }
+    }
+}
+
+#endif //LIGHTFIELDFORWARDRENDERER_BVH_H
@@ -0,0 +1,223 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#include "Frustum.h"
+#include "Camera.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define FRUSTUM_SSE 1
+#endif
+
+namespace Util {
+    namespace Renderer {
+        namespace {
+            // Large enough to pass every plane test without overflowing the sums
+            constexpr float unbounded = 1e30f;
+
+            glm::vec4 row(const glm::mat4 &m, int i) {
+                return { m[0][i], m[1][i], m[2][i], m[3][i] };
+            }
+
+            void corners(const glm::mat4 &viewProjection, glm::vec3 out[8]) {
+                const glm::mat4 inverse = glm::inverse(viewProjection);
+                for (int i = 0; i < 8; i++) {
+                    const glm::vec4 ndc((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : 0.0f, 1.0f);
+                    const glm::vec4 corner = inverse * ndc;
+                    out[i] = glm::vec3(corner) / corner.w;
+                }
+            }
+
+            // Distance plane.w has to grow by for every point to be inside
+            float pushOut(const glm::vec4 &plane, const glm::vec3 points[8]) {
+                float push = 0.0f;
+                for (int i = 0; i < 8; i++) {
+                    push = std::max(push, -(glm::dot(glm::vec3(plane), points[i]) + plane.w));
+                }
+                return push;
+            }
+        }
+
+        void BoundsArray::resize(size_t count) {
+            centerX.resize(count);
+            centerY.resize(count);
+            centerZ.resize(count);
+            extentX.resize(count);
+            extentY.resize(count);
+            extentZ.resize(count);
+            radius.resize(count);
+        }
+
+        void BoundsArray::set(size_t index, const glm::mat4 &matrix, const glm::vec3 &localCenter, const glm::vec3 &localExtent) {
+            const glm::vec3 center = glm::vec3(matrix * glm::vec4(localCenter, 1.0f));
+            // Extent of the transformed box along each world axis
+            const glm::mat3 absolute(glm::abs(glm::vec3(matrix[0])), glm::abs(glm::vec3(matrix[1])), glm::abs(glm::vec3(matrix[2])));
+            const glm::vec3 extent = absolute * localExtent;
+            centerX[index] = center.x;
+            centerY[index] = center.y;
+            centerZ[index] = center.z;
+            extentX[index] = extent.x;
+            extentY[index] = extent.y;
+            extentZ[index] = extent.z;
+            radius[index] = glm::length(extent);
+        }
+
+        void BoundsArray::setUnbounded(size_t index) {
+            centerX[index] = centerY[index] = centerZ[index] = 0.0f;
+            extentX[index] = extentY[index] = extentZ[index] = unbounded;
+            radius[index] = unbounded;
+        }
+
+        Frustum::Frustum() {
+            for (auto &plane : planes) {
+                plane = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+            }
+        }
+
+        Frustum::Frustum(const glm::mat4 &viewProjection) {
+            const glm::vec4 x = row(viewProjection, 0);
+            const glm::vec4 y = row(viewProjection, 1);
+            const glm::vec4 z = row(viewProjection, 2);
+            const glm::vec4 w = row(viewProjection, 3);
+            planes[Left] = w + x;
+            planes[Right] = w - x;
+            planes[Bottom] = w + y;
+            planes[Top] = w - y;
+            // Depth is clipped to [0, w]
+            planes[Near] = z;
+            planes[Far] = w - z;
+            for (auto &plane : planes) {
+                plane /= glm::length(glm::vec3(plane));
+            }
+        }
+
+        Frustum Frustum::fromCamera(const Camera &camera) {
+            return Frustum(camera.matrices.perspective * camera.matrices.view);
+        }
+
+        Frustum Frustum::combine(const glm::mat4 &leftViewProjection, const glm::mat4 &rightViewProjection) {
+            const Frustum left(leftViewProjection);
+            const Frustum right(rightViewProjection);
+            glm::vec3 leftCorners[8], rightCorners[8];
+            corners(leftViewProjection, leftCorners);
+            corners(rightViewProjection, rightCorners);
+
+            Frustum combined;
+            for (int i = 0; i < 6; i++) {
+                const float leftPush = pushOut(left.planes[i], rightCorners);
+                const float rightPush = pushOut(right.planes[i], leftCorners);
+                combined.planes[i] = leftPush <= rightPush ? left.planes[i] + glm::vec4(0.0f, 0.0f, 0.0f, leftPush)
+                                                           : right.planes[i] + glm::vec4(0.0f, 0.0f, 0.0f, rightPush);
+            }
+            return combined;
+        }
+
+        bool Frustum::intersectsSphere(const glm::vec3 &center, float radius) const {
+            for (const auto &plane : planes) {
+                if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool Frustum::intersectsBox(const glm::vec3 &center, const glm::vec3 &extent) const {
+            for (const auto &plane : planes) {
+                const float projected = glm::dot(glm::abs(glm::vec3(plane)), extent);
+                if (glm::dot(glm::vec3(plane), center) + plane.w < -projected) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        Frustum::Containment Frustum::classifyBox(const glm::vec3 &center, const glm::vec3 &extent) const {
+            Containment result = Inside;
+            for (const auto &plane : planes) {
+                const float projected = glm::dot(glm::abs(glm::vec3(plane)), extent);
+                const float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+                if (distance < -projected) {
+                    return Outside;
+                }
+                if (distance < projected) {
+                    result = Intersecting;
+                }
+            }
+            return result;
+        }
+
+        size_t Frustum::cullSpheres(const BoundsArray &bounds, uint8_t *visible) const {
+            const size_t count = bounds.size();
+            size_t visibleCount = 0;
+            size_t i = 0;
+#ifdef FRUSTUM_SSE
+            // Four spheres per iteration against all planes
+            for (; i + 4 <= count; i += 4) {
+                const __m128 cx = _mm_loadu_ps(&bounds.centerX[i]);
+                const __m128 cy = _mm_loadu_ps(&bounds.centerY[i]);
+                const __m128 cz = _mm_loadu_ps(&bounds.centerZ[i]);
+                const __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&bounds.radius[i]));
+                __m128 outside = _mm_setzero_ps();
+                for (const auto &plane : planes) {
+                    __m128 distance = _mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(plane.x)), _mm_set1_ps(plane.w));
+                    distance = _mm_add_ps(distance, _mm_mul_ps(cy, _mm_set1_ps(plane.y)));
+                    distance = _mm_add_ps(distance, _mm_mul_ps(cz, _mm_set1_ps(plane.z)));
+                    outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, negativeRadius));
+                }
+                const int mask = _mm_movemask_ps(outside);
+                for (int lane = 0; lane < 4; lane++) {
+                    visible[i + lane] = (mask >> lane) & 1 ? 0 : 1;
+                    visibleCount += visible[i + lane];
+                }
+            }
+#endif
+            for (; i < count; i++) {
+                visible[i] = intersectsSphere({ bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i] }, bounds.radius[i]) ? 1 : 0;
+                visibleCount += visible[i];
+            }
+            return visibleCount;
+        }
+
+        size_t Frustum::cullBoxes(const BoundsArray &bounds, uint8_t *visible) const {
+            const size_t count = bounds.size();
+            size_t visibleCount = 0;
+            size_t i = 0;
+#ifdef FRUSTUM_SSE
+            // Four boxes per iteration, a box is outside when its center lies further behind a plane than its projected extent
+            for (; i + 4 <= count; i += 4) {
+                const __m128 cx = _mm_loadu_ps(&bounds.centerX[i]);
+                const __m128 cy = _mm_loadu_ps(&bounds.centerY[i]);
+                const __m128 cz = _mm_loadu_ps(&bounds.centerZ[i]);
+                const __m128 ex = _mm_loadu_ps(&bounds.extentX[i]);
+                const __m128 ey = _mm_loadu_ps(&bounds.extentY[i]);
+                const __m128 ez = _mm_loadu_ps(&bounds.extentZ[i]);
+                __m128 outside = _mm_setzero_ps();
+                for (const auto &plane : planes) {
+                    __m128 distance = _mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(plane.x)), _mm_set1_ps(plane.w));
+                    distance = _mm_add_ps(distance, _mm_mul_ps(cy, _mm_set1_ps(plane.y)));
+                    distance = _mm_add_ps(distance, _mm_mul_ps(cz, _mm_set1_ps(plane.z)));
+                    __m128 projected = _mm_mul_ps(ex, _mm_set1_ps(std::fabs(plane.x)));
+                    projected = _mm_add_ps(projected, _mm_mul_ps(ey, _mm_set1_ps(std::fabs(plane.y))));
+                    projected = _mm_add_ps(projected, _mm_mul_ps(ez, _mm_set1_ps(std::fabs(plane.z))));
+                    outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, projected), _mm_setzero_ps()));
+                }
+                const int mask = _mm_movemask_ps(outside);
+                for (int lane = 0; lane < 4; lane++) {
+                    visible[i + lane] = (mask >> lane) & 1 ? 0 : 1;
+                    visibleCount += visible[i + lane];
+                }
+            }
+#endif
+            for (; i < count; i++) {
+                visible[i] = intersectsBox({ bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i] },
+                                           { bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i] }) ? 1 : 0;
+                visibleCount += visible[i];
+            }
+            return visibleCount;
+        }
+    }
+}
@@ -0,0 +1,83 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef LIGHTFIELDFORWARDRENDERER_FRUSTUM_H
+#define LIGHTFIELDFORWARDRENDERER_FRUSTUM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+class Camera;
+
+namespace Util {
+    namespace Renderer {
+        /*
+            World space bounds of many objects in structure of arrays layout for the batched frustum tests
+            Boxes are stored as center and half extent, spheres share the center
+        */
+        struct BoundsArray {
+            std::vector<float> centerX, centerY, centerZ;
+            std::vector<float> extentX, extentY, extentZ;
+            std::vector<float> radius;
+
+            void resize(size_t count);
+
+            [[nodiscard]] size_t size() const { return centerX.size(); }
+
+            /** @brief Stores the world space box of a local box transformed by matrix, and its enclosing sphere */
+            void set(size_t index, const glm::mat4 &matrix, const glm::vec3 &localCenter, const glm::vec3 &localExtent);
+
+            /** @brief Makes an entry pass every test */
+            void setUnbounded(size_t index);
+        };
+
+        /*
+            View frustum as six inward facing planes, a point p is inside when dot(plane.xyz, p) + plane.w >= 0
+        */
+        struct Frustum {
+            enum Side {
+                Left = 0, Right, Bottom, Top, Near, Far
+            };
+            enum Containment {
+                Outside = 0, Intersecting, Inside
+            };
+            glm::vec4 planes[6];
+
+            /** @brief Frustum containing everything */
+            Frustum();
+
+            /** @brief Extracts the planes of a view projection matrix with a [0, 1] depth range */
+            explicit Frustum(const glm::mat4 &viewProjection);
+
+            static Frustum fromCamera(const Camera &camera);
+
+            /**
+            * Conservative frustum containing both views of a stereo pair, so culling runs once for both eyes
+            *
+            * @note Each plane is taken from the eye that needs to be pushed out least to contain the other eye's frustum
+            */
+            static Frustum combine(const glm::mat4 &leftViewProjection, const glm::mat4 &rightViewProjection);
+
+            [[nodiscard]] bool intersectsSphere(const glm::vec3 &center, float radius) const;
+
+            [[nodiscard]] bool intersectsBox(const glm::vec3 &center, const glm::vec3 &extent) const;
+
+            /** @brief Like intersectsBox, but also tells boxes completely inside apart so hierarchies can skip testing their children */
+            [[nodiscard]] Containment classifyBox(const glm::vec3 &center, const glm::vec3 &extent) const;
+
+            /** @brief Tests the spheres of all bounds, writes 1 for visible and 0 for culled entries and returns the visible count */
+            size_t cullSpheres(const BoundsArray &bounds, uint8_t *visible) const;
+
+            /** @brief Tests the boxes of all bounds, writes 1 for visible and 0 for culled entries and returns the visible count */
+            size_t cullBoxes(const BoundsArray &bounds, uint8_t *visible) const;
+        };
+    }
+}
+
+#endif //LIGHTFIELDFORWARDRENDERER_FRUSTUM_H
@@ -0,0 +1,80 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace Util {
+    namespace Renderer {
+        ThreadPool::ThreadPool(uint32_t threadCount) {
+            if (threadCount == 0) {
+                threadCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+            }
+            for (uint32_t i = 0; i < threadCount; i++) {
+                workers.emplace_back(&ThreadPool::workerLoop, this);
+            }
+        }
+
+        ThreadPool::~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            condition.notify_all();
+            for (auto &worker : workers) {
+                worker.join();
+            }
+        }
+
+        void ThreadPool::workerLoop() {
+            for (;;) {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+                    if (stopping && tasks.empty()) {
+                        return;
+                    }
+                    task = std::move(tasks.front());
+                    tasks.pop();
+                }
+                task();
+            }
+        }
+
+        void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)> &task, size_t grainSize) {
+            if (count == 0) {
+                return;
+            }
+            grainSize = std::max<size_t>(grainSize, 1);
+            std::atomic<size_t> next{0};
+            auto worker = [&]() {
+                for (size_t begin = next.fetch_add(grainSize); begin < count; begin = next.fetch_add(grainSize)) {
+                    const size_t end = std::min(begin + grainSize, count);
+                    for (size_t i = begin; i < end; i++) {
+                        task(i);
+                    }
+                }
+            };
+            // The calling thread works too, so nested calls can't starve waiting on busy workers
+            const size_t helpers = std::min(workers.size(), (count + grainSize - 1) / grainSize - 1);
+            std::vector<std::future<void>> pending;
+            pending.reserve(helpers);
+            for (size_t i = 0; i < helpers; i++) {
+                pending.push_back(submit(worker));
+            }
+            worker();
+            for (auto &future : pending) {
+                future.wait();
+            }
+        }
+
+        ThreadPool &ThreadPool::global() {
+            static ThreadPool pool;
+            return pool;
+        }
+    }
+}
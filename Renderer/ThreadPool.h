@@ -0,0 +1,70 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef LIGHTFIELDFORWARDRENDERER_THREADPOOL_H
+#define LIGHTFIELDFORWARDRENDERER_THREADPOOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace Util {
+    namespace Renderer {
+        /*
+            Fixed size worker pool for CPU side frame work (animation, asset decoding)
+        */
+        class ThreadPool {
+            std::vector<std::thread> workers;
+            std::queue<std::function<void()>> tasks;
+            std::mutex mutex;
+            std::condition_variable condition;
+            bool stopping = false;
+
+            void workerLoop();
+
+        public:
+            /** @brief Creates threadCount workers, 0 uses one per hardware thread minus the calling thread */
+            explicit ThreadPool(uint32_t threadCount = 0);
+
+            ~ThreadPool();
+
+            ThreadPool(const ThreadPool &) = delete;
+
+            ThreadPool &operator=(const ThreadPool &) = delete;
+
+            [[nodiscard]] size_t size() const { return workers.size(); }
+
+            /** @brief Queues a task, the returned future holds its result */
+            template<typename F>
+            auto submit(F &&task) -> std::future<decltype(task())> {
+                using Result = decltype(task());
+                auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+                std::future<Result> future = packaged->get_future();
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    tasks.emplace([packaged]() { (*packaged)(); });
+                }
+                condition.notify_one();
+                return future;
+            }
+
+            /**
+            * Runs task(0 .. count-1) on the workers and the calling thread, returns when all calls finished
+            *
+            * @param grainSize Number of consecutive indices handed out at once
+            */
+            void parallelFor(size_t count, const std::function<void(size_t)> &task, size_t grainSize = 1);
+
+            /** @brief Process wide pool */
+            static ThreadPool &global();
+        };
+    }
+}
+
+#endif //LIGHTFIELDFORWARDRENDERER_THREADPOOL_H
@@ -0,0 +1,294 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#include "AnimationState.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace Util {
+    namespace Renderer {
+        namespace vkglTF {
+            AnimationState::AnimationState(GLTFModel &_model)
+                : model(_model) { }
+
+            uint32_t AnimationState::play(uint32_t animation, float weight, float timeScale, bool loop, bool additive) {
+                if (animation >= model.animations.size()) {
+                    printf("No animation with index %d\n", animation);
+                    return UINT32_MAX;
+                }
+                const Animation &clip = model.animations[animation];
+                Playback playback{};
+                playback.id = nextId++;
+                playback.animation = animation;
+                playback.time = clip.start;
+                playback.weight = weight;
+                playback.timeScale = timeScale;
+                playback.loop = loop;
+                playback.additive = additive;
+                playback.targetWeight = weight;
+                playback.fadeRate = 0.0f;
+                playback.stopWhenFaded = false;
+                playback.cursors.assign(clip.channels.size(), 0);
+                if (additive) {
+                    // The first frame is the reference the additive difference is measured against
+                    std::vector<uint32_t> referenceCursors(clip.channels.size(), 0);
+                    playback.referenceValues.resize(clip.channels.size());
+                    clip.evaluate(clip.start, referenceCursors.data(), playback.referenceValues.data());
+                }
+                playbacks.push_back(std::move(playback));
+                return playbacks.back().id;
+            }
+
+            void AnimationState::stop(uint32_t playback, float fadeDuration) {
+                if (fadeDuration <= 0.0f) {
+                    playbacks.erase(std::remove_if(playbacks.begin(), playbacks.end(), [playback](const Playback &p) {
+                        return p.id == playback;
+                    }), playbacks.end());
+                    return;
+                }
+                if (Playback *p = getPlayback(playback)) {
+                    p->targetWeight = 0.0f;
+                    p->fadeRate = p->weight / fadeDuration;
+                    p->stopWhenFaded = true;
+                }
+            }
+
+            void AnimationState::setWeight(uint32_t playback, float weight, float fadeDuration) {
+                Playback *p = getPlayback(playback);
+                if (!p) {
+                    return;
+                }
+                p->targetWeight = weight;
+                if (fadeDuration <= 0.0f) {
+                    p->weight = weight;
+                    p->fadeRate = 0.0f;
+                } else {
+                    p->fadeRate = std::abs(weight - p->weight) / fadeDuration;
+                }
+            }
+
+            void AnimationState::setTimeScale(uint32_t playback, float timeScale) {
+                if (Playback *p = getPlayback(playback)) {
+                    p->timeScale = timeScale;
+                }
+            }
+
+            void AnimationState::setTime(uint32_t playback, float time) {
+                if (Playback *p = getPlayback(playback)) {
+                    p->time = time;
+                }
+            }
+
+            uint32_t AnimationState::crossFade(uint32_t animation, float duration, float timeScale, bool loop) {
+                std::vector<uint32_t> fadingOut;
+                for (const Playback &playback : playbacks) {
+                    if (!playback.additive) {
+                        fadingOut.push_back(playback.id);
+                    }
+                }
+                for (uint32_t id : fadingOut) {
+                    stop(id, duration);
+                }
+                const uint32_t id = play(animation, duration > 0.0f ? 0.0f : 1.0f, timeScale, loop);
+                if (duration > 0.0f) {
+                    setWeight(id, 1.0f, duration);
+                }
+                return id;
+            }
+
+            AnimationState::Playback *AnimationState::getPlayback(uint32_t playback) {
+                for (Playback &p : playbacks) {
+                    if (p.id == playback) {
+                        return &p;
+                    }
+                }
+                return nullptr;
+            }
+
+            void AnimationState::advance(float deltaTime) {
+                for (Playback &playback : playbacks) {
+                    const Animation &clip = model.animations[playback.animation];
+                    const float duration = clip.end - clip.start;
+                    playback.time += deltaTime * playback.timeScale;
+                    if (playback.loop && duration > 0.0f) {
+                        playback.time = clip.start + fmodf(playback.time - clip.start, duration);
+                        if (playback.time < clip.start) {
+                            playback.time += duration;
+                        }
+                    } else {
+                        playback.time = std::min(std::max(playback.time, clip.start), clip.end);
+                    }
+
+                    if (playback.weight != playback.targetWeight) {
+                        const float step = playback.fadeRate * deltaTime;
+                        if (playback.weight < playback.targetWeight) {
+                            playback.weight = std::min(playback.weight + step, playback.targetWeight);
+                        } else {
+                            playback.weight = std::max(playback.weight - step, playback.targetWeight);
+                        }
+                    }
+                }
+                playbacks.erase(std::remove_if(playbacks.begin(), playbacks.end(), [](const Playback &p) {
+                    return p.stopWhenFaded && p.weight <= 0.0f;
+                }), playbacks.end());
+            }
+
+            AnimationState::NodeBlend &AnimationState::touch(uint32_t node) {
+                NodeBlend &blend = blends[node];
+                if (stamps[node] != stamp) {
+                    stamps[node] = stamp;
+                    blend = { glm::vec3(0.0f), glm::vec4(0.0f), glm::vec3(0.0f), glm::vec3(0.0f) };
+                    animatedNodes.push_back(node);
+                }
+                return blend;
+            }
+
+            void AnimationState::apply() {
+                blend(model.sceneGraph.local, model.sceneGraph.dirty);
+                // One world matrix pass for all layers
+                model.updateWorldMatrices();
+                model.updateChangedMeshes();
+            }
+
+            void AnimationState::blend(Pose &pose, std::vector<uint8_t> &dirtyFlags) {
+                const Pose &bindPose = model.bindPose;
+                const size_t nodeCount = model.sceneGraph.size();
+                if (blends.size() != nodeCount) {
+                    blends.resize(nodeCount);
+                    stamps.assign(nodeCount, 0);
+                }
+                if (++stamp == 0) {
+                    std::fill(stamps.begin(), stamps.end(), 0);
+                    stamp = 1;
+                }
+                previousNodes.swap(animatedNodes);
+                animatedNodes.clear();
+
+                // Regular clips accumulate weighted sums per channel
+                for (Playback &playback : playbacks) {
+                    if (playback.additive || playback.weight <= 0.0f) {
+                        continue;
+                    }
+                    const Animation &clip = model.animations[playback.animation];
+                    values.resize(clip.channels.size());
+                    clip.evaluate(playback.time, playback.cursors.data(), values.data());
+                    const float w = playback.weight;
+                    for (size_t c = 0; c < clip.channels.size(); c++) {
+                        const AnimationChannel &channel = clip.channels[c];
+                        NodeBlend &blend = touch(channel.node->id);
+                        glm::vec4 value = values[c];
+                        switch (channel.path) {
+                            case AnimationChannel::PathType::TRANSLATION:
+                                blend.translation += glm::vec3(value) * w;
+                                blend.weights.x += w;
+                                break;
+                            case AnimationChannel::PathType::ROTATION:
+                                // q and -q are the same rotation, keep all of them in one hemisphere
+                                if (glm::dot(blend.rotation, value) < 0.0f) {
+                                    value = -value;
+                                }
+                                blend.rotation += value * w;
+                                blend.weights.y += w;
+                                break;
+                            case AnimationChannel::PathType::SCALE:
+                                blend.scale += glm::vec3(value) * w;
+                                blend.weights.z += w;
+                                break;
+                        }
+                    }
+                }
+
+                // Normalize the sums, weight missing to 1 is taken from the bind pose
+                for (uint32_t node : animatedNodes) {
+                    NodeBlend &blend = blends[node];
+                    if (blend.weights.x < 1.0f) {
+                        blend.translation += bindPose.translations[node] * (1.0f - blend.weights.x);
+                    } else {
+                        blend.translation /= blend.weights.x;
+                    }
+                    const glm::quat &bindRotation = bindPose.rotations[node];
+                    glm::vec4 bindValue(bindRotation.x, bindRotation.y, bindRotation.z, bindRotation.w);
+                    if (blend.weights.y < 1.0f) {
+                        if (glm::dot(blend.rotation, bindValue) < 0.0f) {
+                            bindValue = -bindValue;
+                        }
+                        blend.rotation += bindValue * (1.0f - blend.weights.y);
+                    }
+                    blend.rotation = glm::normalize(blend.rotation);
+                    if (blend.weights.z < 1.0f) {
+                        blend.scale += bindPose.scales[node] * (1.0f - blend.weights.z);
+                    } else {
+                        blend.scale /= blend.weights.z;
+                    }
+                    blend.weights = glm::vec3(1.0f);
+                }
+
+                // Additive clips apply their difference to the first frame on top
+                for (Playback &playback : playbacks) {
+                    if (!playback.additive || playback.weight <= 0.0f) {
+                        continue;
+                    }
+                    const Animation &clip = model.animations[playback.animation];
+                    values.resize(clip.channels.size());
+                    clip.evaluate(playback.time, playback.cursors.data(), values.data());
+                    const float w = playback.weight;
+                    for (size_t c = 0; c < clip.channels.size(); c++) {
+                        const AnimationChannel &channel = clip.channels[c];
+                        const uint32_t node = channel.node->id;
+                        const bool resolved = stamps[node] == stamp;
+                        NodeBlend &blend = touch(node);
+                        if (!resolved) {
+                            const glm::quat &r = bindPose.rotations[node];
+                            blend = { bindPose.translations[node], glm::vec4(r.x, r.y, r.z, r.w), bindPose.scales[node], glm::vec3(1.0f) };
+                        }
+                        const glm::vec4 &value = values[c];
+                        const glm::vec4 &reference = playback.referenceValues[c];
+                        switch (channel.path) {
+                            case AnimationChannel::PathType::TRANSLATION:
+                                blend.translation += (glm::vec3(value) - glm::vec3(reference)) * w;
+                                break;
+                            case AnimationChannel::PathType::ROTATION: {
+                                const glm::quat q(value.w, value.x, value.y, value.z);
+                                const glm::quat q0(reference.w, reference.x, reference.y, reference.z);
+                                const glm::quat delta = glm::slerp(glm::quat(1.0f, 0.0f, 0.0f, 0.0f), q * glm::inverse(q0), w);
+                                const glm::quat r = glm::normalize(delta * glm::quat(blend.rotation.w, blend.rotation.x, blend.rotation.y, blend.rotation.z));
+                                blend.rotation = glm::vec4(r.x, r.y, r.z, r.w);
+                                break;
+                            }
+                            case AnimationChannel::PathType::SCALE: {
+                                glm::vec3 ratio(1.0f);
+                                for (int i = 0; i < 3; i++) {
+                                    if (reference[i] != 0.0f) {
+                                        ratio[i] = value[i] / reference[i];
+                                    }
+                                }
+                                blend.scale *= glm::mix(glm::vec3(1.0f), ratio, w);
+                                break;
+                            }
+                        }
+                    }
+                }
+
+                // Nodes no clip animates anymore return to the bind pose
+                for (uint32_t node : previousNodes) {
+                    if (stamps[node] != stamp) {
+                        pose.translations[node] = bindPose.translations[node];
+                        pose.rotations[node] = bindPose.rotations[node];
+                        pose.scales[node] = bindPose.scales[node];
+                        dirtyFlags[node] = 1;
+                    }
+                }
+                for (uint32_t node : animatedNodes) {
+                    const NodeBlend &blend = blends[node];
+                    pose.translations[node] = blend.translation;
+                    pose.rotations[node] = glm::quat(blend.rotation.w, blend.rotation.x, blend.rotation.y, blend.rotation.z);
+                    pose.scales[node] = blend.scale;
+                    dirtyFlags[node] = 1;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,100 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef LIGHTFIELDFORWARDRENDERER_ANIMATIONSTATE_H
+#define LIGHTFIELDFORWARDRENDERER_ANIMATIONSTATE_H
+
+#include <vector>
+
+#include "GLTFModel.h"
+
+namespace Util {
+    namespace Renderer {
+        namespace vkglTF {
+            /*
+                Layered playback of several animation clips of one model
+                Clips are blended in local TRS space and the result is written to the model's scene graph,
+                followed by a single world matrix update and upload
+            */
+            class AnimationState {
+            public:
+                struct Playback {
+                    uint32_t id;
+                    uint32_t animation;
+                    float time;
+                    float weight;
+                    float timeScale;
+                    bool loop;
+                    // Additive clips add their difference to the clip's first frame on top of the blended pose
+                    bool additive;
+                    // Fading moves weight towards targetWeight by fadeRate per second
+                    float targetWeight;
+                    float fadeRate;
+                    bool stopWhenFaded;
+                    std::vector<uint32_t> cursors;
+                    std::vector<glm::vec4> referenceValues;
+                };
+
+                explicit AnimationState(GLTFModel &model);
+
+                /** @brief Starts a clip and returns its playback id */
+                uint32_t play(uint32_t animation, float weight = 1.0f, float timeScale = 1.0f, bool loop = true, bool additive = false);
+
+                /** @brief Fades a playback out and removes it, immediately if fadeDuration is 0 */
+                void stop(uint32_t playback, float fadeDuration = 0.0f);
+
+                void setWeight(uint32_t playback, float weight, float fadeDuration = 0.0f);
+
+                void setTimeScale(uint32_t playback, float timeScale);
+
+                void setTime(uint32_t playback, float time);
+
+                /** @brief Fades all non-additive playbacks out while fading the given clip in, returns the new playback id */
+                uint32_t crossFade(uint32_t animation, float duration, float timeScale = 1.0f, bool loop = true);
+
+                [[nodiscard]] Playback *getPlayback(uint32_t playback);
+
+                [[nodiscard]] const std::vector<Playback> &getPlaybacks() const { return playbacks; }
+
+                /** @brief Advances playback times and weight fades */
+                void advance(float deltaTime);
+
+                /** @brief Blends all playbacks, writes the animated nodes to the scene graph and updates the mesh uniforms */
+                void apply();
+
+                /**
+                * Blends all playbacks into a pose of the model
+                *
+                * @param dirtyFlags Per node flags, set for every node written to the pose
+                */
+                void blend(Pose &pose, std::vector<uint8_t> &dirtyFlags);
+
+            private:
+                struct NodeBlend {
+                    glm::vec3 translation;
+                    glm::vec4 rotation;
+                    glm::vec3 scale;
+                    // Accumulated weight of the translation, rotation and scale channels
+                    glm::vec3 weights;
+                };
+
+                GLTFModel &model;
+                std::vector<Playback> playbacks;
+                uint32_t nextId = 0;
+
+                // Indexed by scene graph id, a node takes part in the current blend when its stamp matches
+                std::vector<NodeBlend> blends;
+                std::vector<uint32_t> stamps;
+                uint32_t stamp = 0;
+                std::vector<uint32_t> animatedNodes;
+                std::vector<uint32_t> previousNodes;
+                std::vector<glm::vec4> values;
+
+                NodeBlend &touch(uint32_t node);
+            };
+        }
+    }
+}
+
+#endif //LIGHTFIELDFORWARDRENDERER_ANIMATIONSTATE_H
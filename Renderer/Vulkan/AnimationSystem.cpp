@@ -0,0 +1,185 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#include "AnimationSystem.h"
+
+#include <algorithm>
+
+#include "Initializers.h"
+
+namespace Util {
+    namespace Renderer {
+        namespace vkglTF {
+            ModelInstance::ModelInstance(GLTFModel &_model)
+                : model(_model)
+                , animation(_model)
+                , pose(_model.bindPose) {
+                const SceneGraph &graph = model.sceneGraph;
+                worldMatrices.assign(graph.size(), glm::mat4(1.0f));
+                dirty.assign(graph.size(), 1);
+                changed.assign(graph.size(), 0);
+                graph.updateWorldMatrices(pose, transform, dirty, changed, worldMatrices);
+
+                for (uint32_t i = 0; i < graph.size(); i++) {
+                    const Node *node = graph.nodes[i];
+                    if (!node->mesh) {
+                        continue;
+                    }
+                    const auto jointCount = node->skin ? static_cast<uint32_t>(node->skin->joints.size()) : 0u;
+                    meshSlots.push_back({ i, matrixTotal, jointCount });
+                    matrixTotal += 1 + jointCount;
+                }
+            }
+
+            void ModelInstance::setTransform(const glm::mat4 &_transform) {
+                transform = _transform;
+                const SceneGraph &graph = model.sceneGraph;
+                for (size_t i = 0; i < graph.size(); i++) {
+                    if (graph.parents[i] < 0) {
+                        dirty[i] = 1;
+                    }
+                }
+            }
+
+            void ModelInstance::update(float deltaTime) {
+                animation.advance(deltaTime);
+                animation.blend(pose, dirty);
+                model.sceneGraph.updateWorldMatrices(pose, transform, dirty, changed, worldMatrices);
+            }
+
+            void ModelInstance::writeMatrices(glm::mat4 *destination) const {
+                for (const MeshSlot &slot : meshSlots) {
+                    const glm::mat4 &meshMatrix = worldMatrices[slot.node];
+                    destination[slot.offset] = meshMatrix;
+                    if (slot.jointCount == 0) {
+                        continue;
+                    }
+                    // Same joint matrices as Node::update, relative to the mesh node
+                    const Skin *skin = model.sceneGraph.nodes[slot.node]->skin;
+                    const glm::mat4 inverseTransform = glm::inverse(meshMatrix);
+                    for (uint32_t j = 0; j < slot.jointCount; j++) {
+                        destination[slot.offset + 1 + j] = inverseTransform * worldMatrices[skin->joints[j]->id] * skin->inverseBindMatrices[j];
+                    }
+                }
+            }
+
+            AnimationSystem::AnimationSystem(Device *_device, uint32_t frameCount, ThreadPool &_pool)
+                : device(_device)
+                , pool(_pool)
+                , frames(frameCount) {
+                // Same binding as descriptorSetLayoutJoints, so pipelines made for the model's palette take these sets
+                VkDescriptorSetLayoutBinding setLayoutBinding = Initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0);
+                VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = Initializers::descriptorSetLayoutCreateInfo(&setLayoutBinding, 1);
+                VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->getLogicalDevice(), &descriptorLayoutCI, nullptr, &descriptorSetLayout))
+                descriptorAllocator.init(device->getLogicalDevice(), frameCount, { { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1.0f } });
+                for (Frame &frame : frames) {
+                    VK_CHECK_RESULT(descriptorAllocator.allocate(descriptorSetLayout, &frame.descriptorSet))
+                }
+            }
+
+            AnimationSystem::~AnimationSystem() {
+                for (Frame &frame : frames) {
+                    if (frame.buffer.mapped) {
+                        frame.buffer.unmap();
+                    }
+                    frame.buffer.destroy();
+                }
+                descriptorAllocator.destroy();
+                vkDestroyDescriptorSetLayout(device->getLogicalDevice(), descriptorSetLayout, nullptr);
+            }
+
+            ModelInstance *AnimationSystem::createInstance(GLTFModel &model) {
+                instances.push_back(std::make_unique<ModelInstance>(model));
+                layoutDirty = true;
+                return instances.back().get();
+            }
+
+            void AnimationSystem::destroyInstance(ModelInstance *instance) {
+                instances.erase(std::remove_if(instances.begin(), instances.end(), [instance](const std::unique_ptr<ModelInstance> &i) {
+                    return i.get() == instance;
+                }), instances.end());
+                layoutDirty = true;
+            }
+
+            void AnimationSystem::layoutInstances() {
+                matrixCount = 0;
+                for (auto &instance : instances) {
+                    instance->matrixOffset = matrixCount;
+                    matrixCount += instance->matrixCount();
+                }
+                layoutDirty = false;
+            }
+
+            bool AnimationSystem::update(float deltaTime, uint32_t frameIndex) {
+                if (layoutDirty) {
+                    layoutInstances();
+                }
+
+                // Only this frame's buffer is known to be idle, the others grow when their frame comes around
+                Frame &frame = frames[frameIndex];
+                const VkDeviceSize required = std::max(matrixCount, 1u) * sizeof(glm::mat4);
+                bool recreated = false;
+                if (frame.capacity < required) {
+                    if (frame.buffer.mapped) {
+                        frame.buffer.unmap();
+                    }
+                    frame.buffer.destroy();
+                    frame.buffer = Buffers{};
+                    // Headroom so a few added instances don't reallocate every frame buffer again
+                    frame.capacity = required + required / 2;
+                    VK_CHECK_RESULT(device->createBuffer(
+                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                            &frame.buffer,
+                            frame.capacity))
+                    VK_CHECK_RESULT(frame.buffer.map())
+                    VkWriteDescriptorSet writeDescriptorSet = Initializers::writeDescriptorSet(frame.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &frame.buffer.descriptor);
+                    vkUpdateDescriptorSets(device->getLogicalDevice(), 1, &writeDescriptorSet, 0, nullptr);
+                    recreated = true;
+                }
+
+                auto *matrices = static_cast<glm::mat4 *>(frame.buffer.mapped);
+                pool.parallelFor(instances.size(), [&](size_t i) {
+                    ModelInstance &instance = *instances[i];
+                    instance.update(deltaTime);
+                    instance.writeMatrices(matrices + instance.matrixOffset);
+                });
+                return recreated;
+            }
+
+            void AnimationSystem::draw(VkCommandBuffer commandBuffer, const ModelInstance &instance, uint32_t frameIndex, VkPipelineLayout pipelineLayout,
+                                       uint32_t jointSet, uint32_t renderFlags, uint32_t bindImageSet) const {
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, jointSet, 1, &frames[frameIndex].descriptorSet, 0, nullptr);
+                // Instances skin in the vertex shader, so they always read the unskinned vertices
+                const GLTFModel &model = instance.model;
+                const VkDeviceSize offsets[1] = {0};
+                vkCmdBindVertexBuffers(commandBuffer, 0, 1, &model.vertices.buffer, offsets);
+                vkCmdBindIndexBuffer(commandBuffer, model.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+
+                struct {
+                    glm::mat4 matrix;
+                    uint32_t jointOffset;
+                } pushConstants{};
+                for (const ModelInstance::MeshSlot &slot : instance.meshSlots) {
+                    // Joints follow the mesh matrix in the instance's block
+                    pushConstants.matrix = instance.worldMatrices[slot.node];
+                    pushConstants.jointOffset = instance.matrixOffset + slot.offset + 1;
+                    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, Mesh::pushConstantSize, &pushConstants);
+                    for (const Primitive *primitive : model.sceneGraph.nodes[slot.node]->mesh->primitives) {
+                        const Material &material = primitive->material;
+                        if (((renderFlags & RenderFlags::RenderOpaqueNodes) && material.alphaMode != Material::ALPHAMODE_OPAQUE) ||
+                            ((renderFlags & RenderFlags::RenderAlphaMaskedNodes) && material.alphaMode != Material::ALPHAMODE_MASK) ||
+                            ((renderFlags & RenderFlags::RenderAlphaBlendedNodes) && material.alphaMode != Material::ALPHAMODE_BLEND)) {
+                            continue;
+                        }
+                        if (renderFlags & RenderFlags::BindImages) {
+                            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &material.descriptorSet, 0, nullptr);
+                        }
+                        vkCmdDrawIndexed(commandBuffer, primitive->indexCount, 1, primitive->firstIndex, 0, 0);
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,134 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef LIGHTFIELDFORWARDRENDERER_ANIMATIONSYSTEM_H
+#define LIGHTFIELDFORWARDRENDERER_ANIMATIONSYSTEM_H
+
+#include <memory>
+#include <vector>
+
+#include "AnimationState.h"
+#include "DescriptorAllocator.h"
+#include "../ThreadPool.h"
+
+namespace Util {
+    namespace Renderer {
+        namespace vkglTF {
+            /*
+                One animated copy of a model
+                Owns its pose, playback state and world matrices, the model itself is only read while updating
+            */
+            class ModelInstance {
+            public:
+                /*
+                    Location of a mesh node's matrices in the instance's block: the node's world matrix,
+                    followed by jointCount joint matrices relative to it for skinned meshes
+                */
+                struct MeshSlot {
+                    uint32_t node;
+                    uint32_t offset;
+                    uint32_t jointCount;
+                };
+
+                GLTFModel &model;
+                AnimationState animation;
+                Pose pose;
+                std::vector<glm::mat4> worldMatrices;
+                std::vector<MeshSlot> meshSlots;
+                // First matrix of this instance in the AnimationSystem frame buffers
+                uint32_t matrixOffset = 0;
+
+                explicit ModelInstance(GLTFModel &model);
+
+                void setTransform(const glm::mat4 &transform);
+
+                [[nodiscard]] const glm::mat4 &getTransform() const { return transform; }
+
+                /** @brief Advances the playbacks and recomputes the pose and world matrices */
+                void update(float deltaTime);
+
+                /** @brief Number of matrices written by writeMatrices */
+                [[nodiscard]] uint32_t matrixCount() const { return matrixTotal; }
+
+                void writeMatrices(glm::mat4 *destination) const;
+
+            private:
+                glm::mat4 transform{1.0f};
+                std::vector<uint8_t> dirty;
+                std::vector<uint8_t> changed;
+                uint32_t matrixTotal = 0;
+            };
+
+            /*
+                Updates many model instances in parallel and writes their mesh and joint matrices
+                into one host visible storage buffer per frame in flight
+                draw renders an instance with shaders/skinnedmodel.vert, the frame's buffer takes the place of the
+                model's joint palette and every mesh pushes the offset of its joints in it
+            */
+            class AnimationSystem {
+            public:
+                AnimationSystem(Device *device, uint32_t frameCount, ThreadPool &pool = ThreadPool::global());
+
+                ~AnimationSystem();
+
+                ModelInstance *createInstance(GLTFModel &model);
+
+                void destroyInstance(ModelInstance *instance);
+
+                /**
+                * Advances every instance and writes the results for a frame
+                *
+                * @param frameIndex Frame in flight whose buffer is written, the GPU must be done reading it
+                *
+                * @note The frame's buffer is recreated when instances were added, descriptors must then be updated
+                * from getFrameBuffer(), which is signaled by the return value
+                *
+                * @return True if the frame buffer was recreated
+                */
+                bool update(float deltaTime, uint32_t frameIndex);
+
+                [[nodiscard]] Buffers &getFrameBuffer(uint32_t frameIndex) { return frames[frameIndex].buffer; }
+
+                /** @brief One vertex stage storage buffer at binding 0, compatible with descriptorSetLayoutJoints */
+                [[nodiscard]] VkDescriptorSetLayout getDescriptorSetLayout() const { return descriptorSetLayout; }
+
+                /** @brief Set of the frame's buffer, rewritten when update recreates the buffer */
+                [[nodiscard]] VkDescriptorSet getDescriptorSet(uint32_t frameIndex) const { return frames[frameIndex].descriptorSet; }
+
+                /**
+                * Binds the frame's set at jointSet and the model's source vertices, then draws the instance's meshes
+                * with their world matrix and joint offset pushed like RenderFlags::PushMeshMatrix
+                *
+                * @note update must have written frameIndex first, the pipeline layout pushes Mesh::pushConstantSize bytes
+                * to the vertex stage at offset 0
+                * @param renderFlags Alpha mode selection and BindImages, as for GLTFModel::draw
+                */
+                void draw(VkCommandBuffer commandBuffer, const ModelInstance &instance, uint32_t frameIndex, VkPipelineLayout pipelineLayout,
+                          uint32_t jointSet = 1, uint32_t renderFlags = 0, uint32_t bindImageSet = 2) const;
+
+                [[nodiscard]] const std::vector<std::unique_ptr<ModelInstance>> &getInstances() const { return instances; }
+
+            private:
+                struct Frame {
+                    Buffers buffer;
+                    VkDeviceSize capacity = 0;
+                    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+                };
+
+                Device *device;
+                ThreadPool &pool;
+                VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+                DescriptorAllocator descriptorAllocator;
+                std::vector<std::unique_ptr<ModelInstance>> instances;
+                std::vector<Frame> frames;
+                uint32_t matrixCount = 0;
+                bool layoutDirty = false;
+
+                void layoutInstances();
+            };
+        }
+    }
+}
+
+#endif //LIGHTFIELDFORWARDRENDERER_ANIMATIONSYSTEM_H
@@ -0,0 +1,253 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#include "BindlessMaterials.h"
+
+#include <algorithm>
+
+#include "Initializers.h"
+
+namespace Util {
+    namespace Renderer {
+        namespace vkglTF {
+            namespace {
+                VkPhysicalDeviceDescriptorIndexingFeaturesEXT queryFeatures(VkPhysicalDevice physicalDevice) {
+                    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{};
+                    indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+                    VkPhysicalDeviceFeatures2 features2{};
+                    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+                    features2.pNext = &indexingFeatures;
+                    vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+                    return indexingFeatures;
+                }
+
+                /*
+                    Combined image samplers a set and a stage can hold, both the sampler and the sampled image limits apply
+                */
+                uint32_t textureLimit(Device *device, bool updateAfterBind) {
+                    if (!updateAfterBind) {
+                        const VkPhysicalDeviceLimits limits = device->getProperties().limits;
+                        return std::min({ limits.maxDescriptorSetSampledImages, limits.maxDescriptorSetSamplers,
+                                          limits.maxPerStageDescriptorSampledImages, limits.maxPerStageDescriptorSamplers });
+                    }
+                    VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties{};
+                    indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+                    VkPhysicalDeviceProperties2 properties2{};
+                    properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+                    properties2.pNext = &indexingProperties;
+                    vkGetPhysicalDeviceProperties2(device->getPhysicalDevice(), &properties2);
+                    return std::min({ indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+                                      indexingProperties.maxDescriptorSetUpdateAfterBindSamplers,
+                                      indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                                      indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers });
+                }
+            }
+
+            bool BindlessMaterials::isSupported(VkPhysicalDevice physicalDevice) {
+                const VkPhysicalDeviceDescriptorIndexingFeaturesEXT features = queryFeatures(physicalDevice);
+                return features.runtimeDescriptorArray && features.shaderSampledImageArrayNonUniformIndexing &&
+                       features.descriptorBindingPartiallyBound && features.descriptorBindingVariableDescriptorCount;
+            }
+
+            void *BindlessMaterials::enableFeatures(VkPhysicalDevice physicalDevice, VkPhysicalDeviceDescriptorIndexingFeaturesEXT &features, void *pNext) {
+                const VkPhysicalDeviceDescriptorIndexingFeaturesEXT supported = queryFeatures(physicalDevice);
+                features = {};
+                features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+                features.pNext = pNext;
+                features.runtimeDescriptorArray = VK_TRUE;
+                features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+                features.descriptorBindingPartiallyBound = VK_TRUE;
+                features.descriptorBindingVariableDescriptorCount = VK_TRUE;
+                features.descriptorBindingSampledImageUpdateAfterBind = supported.descriptorBindingSampledImageUpdateAfterBind;
+                return &features;
+            }
+
+            BindlessMaterials::BindlessMaterials(Device *_device, uint32_t _maxMaterials, uint32_t _maxTextures)
+                : device(_device)
+                , maxMaterials(_maxMaterials)
+                , maxTextures(_maxTextures) {
+                VkDevice logicalDevice = device->getLogicalDevice();
+                updateAfterBind = queryFeatures(device->getPhysicalDevice()).descriptorBindingSampledImageUpdateAfterBind;
+                const uint32_t limit = textureLimit(device, updateAfterBind);
+                if (maxTextures > limit) {
+                    fprintf(stderr, "BindlessMaterials: the device holds %u textures per set, not %u\n", limit, maxTextures);
+                    maxTextures = limit;
+                }
+
+                // Records are written in place, the buffer never moves so the set is written once
+                VK_CHECK_RESULT(device->createBuffer(
+                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                        &materials,
+                        maxMaterials * sizeof(MaterialRecord)))
+                VK_CHECK_RESULT(materials.map())
+
+                std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+                        Initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+                        Initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1, maxTextures),
+                };
+                // Unused texture slots stay unwritten, with update after bind models can be added while the set is in use
+                const VkDescriptorBindingFlagsEXT textureFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+                                                                 VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT_EXT |
+                                                                 (updateAfterBind ? VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT : 0);
+                const VkDescriptorBindingFlagsEXT bindingFlags[2] = { 0, textureFlags };
+                VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsCI{};
+                bindingFlagsCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+                bindingFlagsCI.bindingCount = 2;
+                bindingFlagsCI.pBindingFlags = bindingFlags;
+                VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = Initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+                descriptorLayoutCI.pNext = &bindingFlagsCI;
+                if (updateAfterBind) {
+                    descriptorLayoutCI.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+                }
+                VK_CHECK_RESULT(vkCreateDescriptorSetLayout(logicalDevice, &descriptorLayoutCI, nullptr, &descriptorSetLayout))
+
+                std::vector<VkDescriptorPoolSize> poolSizes = {
+                        Initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1),
+                        Initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxTextures),
+                };
+                VkDescriptorPoolCreateInfo descriptorPoolCI = Initializers::descriptorPoolCreateInfo(poolSizes, 1);
+                if (updateAfterBind) {
+                    descriptorPoolCI.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+                }
+                VK_CHECK_RESULT(vkCreateDescriptorPool(logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool))
+
+                VkDescriptorSetVariableDescriptorCountAllocateInfoEXT variableCountAI{};
+                variableCountAI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO_EXT;
+                variableCountAI.descriptorSetCount = 1;
+                variableCountAI.pDescriptorCounts = &maxTextures;
+                VkDescriptorSetAllocateInfo descriptorSetAllocInfo = Initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+                descriptorSetAllocInfo.pNext = &variableCountAI;
+                VK_CHECK_RESULT(vkAllocateDescriptorSets(logicalDevice, &descriptorSetAllocInfo, &descriptorSet))
+
+                VkWriteDescriptorSet writeDescriptorSet = Initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &materials.descriptor);
+                vkUpdateDescriptorSets(logicalDevice, 1, &writeDescriptorSet, 0, nullptr);
+            }
+
+            BindlessMaterials::~BindlessMaterials() {
+                if (materials.mapped) {
+                    materials.unmap();
+                }
+                materials.destroy();
+                if (descriptorSetLayout != VK_NULL_HANDLE) {
+                    vkDestroyDescriptorSetLayout(device->getLogicalDevice(), descriptorSetLayout, nullptr);
+                }
+                if (descriptorPool != VK_NULL_HANDLE) {
+                    vkDestroyDescriptorPool(device->getLogicalDevice(), descriptorPool, nullptr);
+                }
+            }
+
+            uint32_t BindlessMaterials::acquireTexture(const Texture *texture, std::vector<VkWriteDescriptorSet> &writes) {
+                if (!texture) {
+                    return noTexture;
+                }
+                auto slot = textureSlots.find(texture);
+                if (slot != textureSlots.end()) {
+                    slot->second.references++;
+                    return slot->second.index;
+                }
+                uint32_t index;
+                if (!freeTextures.empty()) {
+                    index = freeTextures.back();
+                    freeTextures.pop_back();
+                } else if (textureCount < maxTextures) {
+                    index = textureCount++;
+                } else {
+                    return noTexture;
+                }
+                textureSlots[texture] = { index, 1 };
+                VkWriteDescriptorSet writeDescriptorSet = Initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1,
+                                                                                           const_cast<VkDescriptorImageInfo *>(&texture->descriptor));
+                writeDescriptorSet.dstArrayElement = index;
+                writes.push_back(writeDescriptorSet);
+                return index;
+            }
+
+            void BindlessMaterials::releaseTexture(const Texture *texture) {
+                auto slot = textureSlots.find(texture);
+                if (slot == textureSlots.end()) {
+                    return;
+                }
+                if (--slot->second.references == 0) {
+                    freeTextures.push_back(slot->second.index);
+                    textureSlots.erase(slot);
+                }
+            }
+
+            bool BindlessMaterials::addModel(GLTFModel &model) {
+                // Re-adding must not leak the slots and texture references of the previous registration
+                if (modelTextures.count(&model)) {
+                    removeModel(model);
+                }
+                std::vector<VkWriteDescriptorSet> writes;
+                bool complete = true;
+                auto *records = static_cast<MaterialRecord *>(materials.mapped);
+                std::vector<const Texture *> &acquired = modelTextures[&model];
+                auto textureIndex = [&](const Texture *texture) {
+                    const uint32_t index = acquireTexture(texture, writes);
+                    if (index != noTexture) {
+                        acquired.push_back(texture);
+                    } else if (texture) {
+                        complete = false;
+                    }
+                    return index;
+                };
+                for (Material &material : model.materials) {
+                    uint32_t index;
+                    if (!freeMaterials.empty()) {
+                        index = freeMaterials.back();
+                        freeMaterials.pop_back();
+                    } else if (materialCount < maxMaterials) {
+                        index = materialCount++;
+                    } else {
+                        fprintf(stderr, "BindlessMaterials: all %u material slots are in use\n", maxMaterials);
+                        complete = false;
+                        break;
+                    }
+                    MaterialRecord &record = records[index];
+                    record.baseColorFactor = material.baseColorFactor;
+                    record.metallicFactor = material.metallicFactor;
+                    record.roughnessFactor = material.roughnessFactor;
+                    record.alphaCutoff = material.alphaCutoff;
+                    record.alphaMode = static_cast<uint32_t>(material.alphaMode);
+                    record.baseColorTexture = textureIndex(material.baseColorTexture);
+                    record.metallicRoughnessTexture = textureIndex(material.metallicRoughnessTexture);
+                    record.normalTexture = textureIndex(material.normalTexture);
+                    record.occlusionTexture = textureIndex(material.occlusionTexture);
+                    record.emissiveTexture = textureIndex(material.emissiveTexture);
+                    material.bindlessIndex = index;
+                }
+                if (!writes.empty()) {
+                    vkUpdateDescriptorSets(device->getLogicalDevice(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+                }
+                if (!complete) {
+                    fprintf(stderr, "BindlessMaterials: %s did not fit completely\n", model.path.c_str());
+                }
+                return complete;
+            }
+
+            void BindlessMaterials::removeModel(GLTFModel &model) {
+                // Only the references addModel took, textures that didn't fit hold none
+                auto acquired = modelTextures.find(&model);
+                if (acquired != modelTextures.end()) {
+                    for (const Texture *texture : acquired->second) {
+                        releaseTexture(texture);
+                    }
+                    modelTextures.erase(acquired);
+                }
+                for (Material &material : model.materials) {
+                    if (material.bindlessIndex == UINT32_MAX) {
+                        continue;
+                    }
+                    freeMaterials.push_back(material.bindlessIndex);
+                    material.bindlessIndex = UINT32_MAX;
+                }
+            }
+
+            void BindlessMaterials::bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t set) const {
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, set, 1, &descriptorSet, 0, nullptr);
+            }
+        }
+    }
+}
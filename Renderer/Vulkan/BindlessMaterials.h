@@ -0,0 +1,115 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef LIGHTFIELDFORWARDRENDERER_BINDLESSMATERIALS_H
+#define LIGHTFIELDFORWARDRENDERER_BINDLESSMATERIALS_H
+
+#include <unordered_map>
+#include <vector>
+
+#include "GLTFModel.h"
+
+namespace Util {
+    namespace Renderer {
+        namespace vkglTF {
+            /*
+                Materials and textures of any number of models in one descriptor set
+                Binding 0 holds every MaterialRecord, binding 1 a runtime sized array of all textures, shaders
+                index materials with Material::bindlessIndex and textures with the indices stored in the records
+                See Shaders/bindless.frag for the expected layout
+
+                Needs descriptor indexing (VK_EXT_descriptor_indexing or Vulkan 1.2), enable the features from
+                enableFeatures before the device is created
+            */
+            class BindlessMaterials {
+            public:
+                // Texture index of absent textures
+                static constexpr uint32_t noTexture = UINT32_MAX;
+
+                // Matches MaterialRecord in Shaders/bindless.frag
+                struct MaterialRecord {
+                    glm::vec4 baseColorFactor;
+                    float metallicFactor;
+                    float roughnessFactor;
+                    float alphaCutoff;
+                    uint32_t alphaMode;
+                    uint32_t baseColorTexture;
+                    uint32_t metallicRoughnessTexture;
+                    uint32_t normalTexture;
+                    uint32_t occlusionTexture;
+                    uint32_t emissiveTexture;
+                    uint32_t padding[3];
+                };
+
+                /** @brief Whether the physical device supports everything the material set needs */
+                static bool isSupported(VkPhysicalDevice physicalDevice);
+
+                /**
+                * Requests the descriptor indexing features used by the material set, update after bind only where supported
+                *
+                * @param features Filled in and chained in front of pNext, must outlive device creation
+                * @return The new head of the pNext chain, pass it as the device create pNext chain
+                */
+                static void *enableFeatures(VkPhysicalDevice physicalDevice, VkPhysicalDeviceDescriptorIndexingFeaturesEXT &features, void *pNext = nullptr);
+
+                /**
+                * @note The device must have been created with the features from enableFeatures
+                * @param maxTextures Lowered to the device's sampler and sampled image limits for the set
+                */
+                BindlessMaterials(Device *device, uint32_t maxMaterials = 4096, uint32_t maxTextures = 4096);
+
+                ~BindlessMaterials();
+
+                /**
+                * Adds the materials and textures of a loaded model and stores each material's index in Material::bindlessIndex
+                *
+                * @return False if the set is full, materials that didn't fit keep an invalid index
+                * @note A model that is already registered is removed first, so re-adding picks up changed materials
+                * @note Without update after bind support the set must not be in use by pending command buffers
+                */
+                bool addModel(GLTFModel &model);
+
+                /** @brief Frees the slots of a model's materials and textures, they are reused by later models */
+                void removeModel(GLTFModel &model);
+
+                [[nodiscard]] VkDescriptorSetLayout getDescriptorSetLayout() const { return descriptorSetLayout; }
+
+                [[nodiscard]] VkDescriptorSet getDescriptorSet() const { return descriptorSet; }
+
+                void bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t set) const;
+
+            private:
+                Device *device;
+                uint32_t maxMaterials;
+                uint32_t maxTextures;
+                bool updateAfterBind = false;
+
+                Buffers materials;
+                // Next never used slot and the released ones
+                uint32_t materialCount = 0;
+                uint32_t textureCount = 0;
+                std::vector<uint32_t> freeMaterials;
+                std::vector<uint32_t> freeTextures;
+                // Slot and user count of every texture in the array
+                struct TextureSlot {
+                    uint32_t index;
+                    uint32_t references;
+                };
+                std::unordered_map<const Texture *, TextureSlot> textureSlots;
+                // Texture references every added model holds, released by removeModel
+                std::unordered_map<const GLTFModel *, std::vector<const Texture *>> modelTextures;
+
+                VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+                VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+                VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+                uint32_t acquireTexture(const Texture *texture, std::vector<VkWriteDescriptorSet> &writes);
+
+                void releaseTexture(const Texture *texture);
+            };
+        }
+    }
+}
+
+#endif //LIGHTFIELDFORWARDRENDERER_BINDLESSMATERIALS_H
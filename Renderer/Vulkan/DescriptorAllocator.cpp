@@ -0,0 +1,103 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#include "DescriptorAllocator.h"
+
+#include <algorithm>
+
+#include "CommonHelper.h"
+#include "Initializers.h"
+
+namespace Util {
+    namespace Renderer {
+        const std::vector<DescriptorAllocator::PoolSizeRatio> &DescriptorAllocator::defaultRatios() {
+            static const std::vector<PoolSizeRatio> ratios = {
+                    { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f },
+                    { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0.5f },
+                    { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1.0f },
+                    { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2.0f },
+                    { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 0.5f },
+                    { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0.5f },
+                    { VK_DESCRIPTOR_TYPE_SAMPLER, 0.5f },
+            };
+            return ratios;
+        }
+
+        DescriptorAllocator::DescriptorAllocator(VkDevice _device, uint32_t _setsPerPool,
+                                                 const std::vector<PoolSizeRatio> &_ratios, VkDescriptorPoolCreateFlags _flags) {
+            init(_device, _setsPerPool, _ratios, _flags);
+        }
+
+        DescriptorAllocator::~DescriptorAllocator() {
+            destroy();
+        }
+
+        void DescriptorAllocator::init(VkDevice _device, uint32_t _setsPerPool,
+                                       const std::vector<PoolSizeRatio> &_ratios, VkDescriptorPoolCreateFlags _flags) {
+            destroy();
+            device = _device;
+            setsPerPool = std::max(_setsPerPool, 1u);
+            ratios = _ratios;
+            flags = _flags;
+        }
+
+        VkDescriptorPool DescriptorAllocator::createPool(uint32_t setCount) {
+            std::vector<VkDescriptorPoolSize> poolSizes;
+            for (const PoolSizeRatio &ratio : ratios) {
+                const auto count = static_cast<uint32_t>(ratio.ratio * static_cast<float>(setCount));
+                poolSizes.push_back(Initializers::descriptorPoolSize(ratio.type, std::max(count, 1u)));
+            }
+            VkDescriptorPoolCreateInfo descriptorPoolCI = Initializers::descriptorPoolCreateInfo(poolSizes, setCount);
+            descriptorPoolCI.flags = flags;
+            VkDescriptorPool pool = VK_NULL_HANDLE;
+            VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCI, nullptr, &pool))
+            return pool;
+        }
+
+        VkDescriptorPool DescriptorAllocator::getPool() {
+            if (!readyPools.empty()) {
+                return readyPools.back();
+            }
+            readyPools.push_back(createPool(setsPerPool));
+            // The next pool only exists if this one ran out, so grow it
+            setsPerPool = std::min(setsPerPool * 2, maxSetsPerPool);
+            return readyPools.back();
+        }
+
+        VkResult DescriptorAllocator::allocate(VkDescriptorSetLayout layout, VkDescriptorSet *descriptorSet, const void *pNext) {
+            VkDescriptorSetAllocateInfo descriptorSetAllocInfo = Initializers::descriptorSetAllocateInfo(getPool(), &layout, 1);
+            descriptorSetAllocInfo.pNext = pNext;
+            VkResult result = vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, descriptorSet);
+            if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+                fullPools.push_back(readyPools.back());
+                readyPools.pop_back();
+                descriptorSetAllocInfo.descriptorPool = getPool();
+                result = vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, descriptorSet);
+            }
+            return result;
+        }
+
+        void DescriptorAllocator::reset() {
+            for (VkDescriptorPool pool : readyPools) {
+                VK_CHECK_RESULT(vkResetDescriptorPool(device, pool, 0))
+            }
+            for (VkDescriptorPool pool : fullPools) {
+                VK_CHECK_RESULT(vkResetDescriptorPool(device, pool, 0))
+                readyPools.push_back(pool);
+            }
+            fullPools.clear();
+        }
+
+        void DescriptorAllocator::destroy() {
+            for (VkDescriptorPool pool : readyPools) {
+                vkDestroyDescriptorPool(device, pool, nullptr);
+            }
+            for (VkDescriptorPool pool : fullPools) {
+                vkDestroyDescriptorPool(device, pool, nullptr);
+            }
+            readyPools.clear();
+            fullPools.clear();
+        }
+    }
+}
@@ -0,0 +1,77 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef LIGHTFIELDFORWARDRENDERER_DESCRIPTORALLOCATOR_H
+#define LIGHTFIELDFORWARDRENDERER_DESCRIPTORALLOCATOR_H
+
+#include <vector>
+#include <vulkan/vulkan.h>
+
+namespace Util {
+    namespace Renderer {
+        /*
+            Descriptor set allocation from a growing list of pools
+            A pool that runs out is retired and the next one is created twice as large, so callers never size pools by hand
+            Use one allocator per class of layouts with similar descriptor mixes, and one per frame in flight for
+            transient sets that are all released together with reset
+        */
+        class DescriptorAllocator final {
+        public:
+            // Descriptors of a type per set, multiplied by the sets of a pool to get its pool sizes
+            struct PoolSizeRatio {
+                VkDescriptorType type;
+                float ratio;
+            };
+
+            static const std::vector<PoolSizeRatio> &defaultRatios();
+
+            DescriptorAllocator() = default;
+
+            explicit DescriptorAllocator(VkDevice device, uint32_t setsPerPool = 32,
+                                         const std::vector<PoolSizeRatio> &ratios = defaultRatios(), VkDescriptorPoolCreateFlags flags = 0);
+
+            ~DescriptorAllocator();
+
+            DescriptorAllocator(const DescriptorAllocator &) = delete;
+
+            DescriptorAllocator &operator=(const DescriptorAllocator &) = delete;
+
+            /** @brief Sets up an allocator made with the default constructor, destroys the pools of a previous setup */
+            void init(VkDevice device, uint32_t setsPerPool = 32,
+                      const std::vector<PoolSizeRatio> &ratios = defaultRatios(), VkDescriptorPoolCreateFlags flags = 0);
+
+            /**
+            * Allocates a set, moving on to a new pool when the current one is exhausted
+            *
+            * @param pNext Extension structures of the allocation, e.g. variable descriptor counts
+            */
+            VkResult allocate(VkDescriptorSetLayout layout, VkDescriptorSet *descriptorSet, const void *pNext = nullptr);
+
+            /** @brief Releases every set allocated so far, the pools are kept for reuse */
+            void reset();
+
+            void destroy();
+
+            [[nodiscard]] size_t poolCount() const { return readyPools.size() + fullPools.size(); }
+
+        private:
+            // Pools never grow beyond this many sets
+            static constexpr uint32_t maxSetsPerPool = 4096;
+
+            VkDevice device = VK_NULL_HANDLE;
+            std::vector<PoolSizeRatio> ratios;
+            VkDescriptorPoolCreateFlags flags = 0;
+            uint32_t setsPerPool = 0;
+            // The back of readyPools is allocated from, fullPools ran out and wait for a reset
+            std::vector<VkDescriptorPool> readyPools;
+            std::vector<VkDescriptorPool> fullPools;
+
+            VkDescriptorPool createPool(uint32_t setCount);
+
+            VkDescriptorPool getPool();
+        };
+    }
+}
+
+#endif //LIGHTFIELDFORWARDRENDERER_DESCRIPTORALLOCATOR_H
@@ -0,0 +1,114 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#include "DrawList.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Util {
+    namespace Renderer {
+        namespace vkglTF {
+            namespace {
+                // Maps a float to an unsigned integer with the same ordering
+                uint32_t sortableDepth(float depth) {
+                    uint32_t bits;
+                    memcpy(&bits, &depth, sizeof(bits));
+                    return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+                }
+            }
+
+            uint64_t DrawList::makeKey(uint32_t pass, uint32_t pipeline, uint32_t material, float depth, bool blended) {
+                const uint64_t state = (static_cast<uint64_t>(pass & ((1u << passBits) - 1)) << (64 - passBits)) |
+                                       (static_cast<uint64_t>(blended) << (63 - passBits)) |
+                                       (static_cast<uint64_t>(pipeline & ((1u << pipelineBits) - 1)) << (63 - passBits - pipelineBits));
+                const uint64_t materialKey = material & ((1u << materialBits) - 1);
+                if (blended) {
+                    // Depth before material, farther packets first
+                    return state | (static_cast<uint64_t>(~sortableDepth(depth)) << materialBits) | materialKey;
+                }
+                return state | (materialKey << 32) | sortableDepth(depth);
+            }
+
+            void DrawList::add(const GLTFModel &model, const glm::mat4 &view, uint32_t renderFlags, uint32_t pass, uint32_t pipelineBase) {
+                const uint32_t alphaModes = renderFlags & (RenderOpaqueNodes | RenderAlphaMaskedNodes | RenderAlphaBlendedNodes);
+                const auto &entries = model.culling.entries;
+                for (size_t i = 0; i < entries.size(); i++) {
+                    const Node *node = entries[i].first;
+                    const Primitive *primitive = entries[i].second;
+                    const Material &material = primitive->material;
+                    // RenderOpaqueNodes, RenderAlphaMaskedNodes and RenderAlphaBlendedNodes follow the AlphaMode order
+                    if ((alphaModes != 0 && !(alphaModes & (RenderOpaqueNodes << material.alphaMode))) || !model.isVisible(primitive)) {
+                        continue;
+                    }
+                    float depth = 0.0f;
+                    if (primitive->dimensions.min.x <= primitive->dimensions.max.x) {
+                        depth = -(view * model.getEntryMatrix(i) * glm::vec4(primitive->dimensions.center, 1.0f)).z;
+                    }
+                    // Bindless indices are shared by all models, so packets of different models can still batch
+                    const auto materialIndex = material.bindlessIndex != UINT32_MAX ? material.bindlessIndex
+                                                                                     : static_cast<uint32_t>(&material - model.materials.data());
+                    const uint32_t pipeline = pipelineBase + material.alphaMode;
+
+                    Packet packet{};
+                    packet.key = makeKey(pass, pipeline, materialIndex, depth, material.alphaMode == Material::ALPHAMODE_BLEND);
+                    packet.model = &model;
+                    packet.node = node;
+                    packet.primitive = primitive;
+                    packet.pipeline = pipeline;
+                    const Primitive::Lod *lod = model.selectLod(node, primitive);
+                    packet.firstIndex = lod ? lod->firstIndex : primitive->firstIndex;
+                    packet.indexCount = lod ? lod->indexCount : primitive->indexCount;
+                    packets.push_back(packet);
+                }
+            }
+
+            void DrawList::sort() {
+                std::sort(packets.begin(), packets.end(), [](const Packet &a, const Packet &b) {
+                    return a.key < b.key;
+                });
+            }
+
+            void DrawList::draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const std::vector<VkPipeline> &pipelines,
+                                uint32_t renderFlags, uint32_t bindImageSet, uint32_t frameIndex) const {
+                const GLTFModel *boundModel = nullptr;
+                const Node *pushedNode = nullptr;
+                VkPipeline boundPipeline = VK_NULL_HANDLE;
+                VkDescriptorSet boundMaterial = VK_NULL_HANDLE;
+                uint32_t pushedMaterial = UINT32_MAX;
+                for (const Packet &packet : packets) {
+                    if (!pipelines.empty() && pipelines[packet.pipeline] != boundPipeline) {
+                        boundPipeline = pipelines[packet.pipeline];
+                        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, boundPipeline);
+                    }
+                    if (packet.model != boundModel) {
+                        // Material indices of different models come from the same bindless set, but push offsets may differ
+                        pushedMaterial = UINT32_MAX;
+                        boundModel = packet.model;
+                        const VkDeviceSize offsets[1] = {0};
+                        const VkBuffer vertexBuffer = boundModel->getVertexBuffer(frameIndex);
+                        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, offsets);
+                        vkCmdBindIndexBuffer(commandBuffer, boundModel->indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+                    }
+                    if ((renderFlags & PushMeshMatrix) && packet.node != pushedNode) {
+                        pushedNode = packet.node;
+                        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, Mesh::pushConstantSize, &pushedNode->mesh->uniformBlock);
+                    }
+                    if (renderFlags & PushMaterialIndex) {
+                        const Material &material = packet.primitive->material;
+                        if (material.bindlessIndex != pushedMaterial) {
+                            pushedMaterial = material.bindlessIndex;
+                            vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                                               packet.model->materialIndexPushOffset, sizeof(uint32_t), &pushedMaterial);
+                        }
+                    } else if ((renderFlags & BindImages) && packet.primitive->material.descriptorSet != boundMaterial) {
+                        boundMaterial = packet.primitive->material.descriptorSet;
+                        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &boundMaterial, 0, nullptr);
+                    }
+                    vkCmdDrawIndexed(commandBuffer, packet.indexCount, 1, packet.firstIndex, 0, 0);
+                }
+            }
+        }
+    }
+}
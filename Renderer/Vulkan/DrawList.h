@@ -0,0 +1,79 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef LIGHTFIELDFORWARDRENDERER_DRAWLIST_H
+#define LIGHTFIELDFORWARDRENDERER_DRAWLIST_H
+
+#include <vector>
+
+#include "GLTFModel.h"
+
+namespace Util {
+    namespace Renderer {
+        namespace vkglTF {
+            /*
+                Visible primitives of one or more models flattened into packets and sorted by a 64 bit state key
+                Opaque and masked packets are ordered by pass, pipeline, material and then front to back,
+                blended packets by pass, pipeline and then back to front so they still composite correctly
+                Drawing binds pipelines, buffers and material sets only when they differ from the previous packet
+            */
+            class DrawList {
+            public:
+                struct Packet {
+                    uint64_t key;
+                    const GLTFModel *model;
+                    const Node *node;
+                    const Primitive *primitive;
+                    uint32_t firstIndex;
+                    uint32_t indexCount;
+                    uint32_t pipeline;
+                };
+
+                // Key layout from the most significant bit down
+                static constexpr uint32_t passBits = 8;
+                static constexpr uint32_t pipelineBits = 11;
+                static constexpr uint32_t materialBits = 12;
+
+                /**
+                * Builds a key, the blended flag sits below the pass so blended packets follow every other packet of their pass
+                *
+                * @param depth View space distance to the primitive, larger is farther
+                */
+                static uint64_t makeKey(uint32_t pass, uint32_t pipeline, uint32_t material, float depth, bool blended);
+
+                void clear() { packets.clear(); }
+
+                /**
+                * Appends the visible primitives of a model in a single pass over its culling entries
+                *
+                * @param view View matrix the depths are measured in
+                * @param renderFlags RenderOpaqueNodes, RenderAlphaMaskedNodes and RenderAlphaBlendedNodes select alpha modes, none adds all
+                * @param pipelineBase Pipeline of opaque packets, masked and blended packets use the two following indices
+                */
+                void add(const GLTFModel &model, const glm::mat4 &view, uint32_t renderFlags = 0, uint32_t pass = 0, uint32_t pipelineBase = 0);
+
+                void sort();
+
+                /**
+                * Records the sorted packets
+                *
+                * @param pipelines Indexed by the packets' pipeline, empty leaves pipeline binding to the caller
+                * @param renderFlags BindImages binds material sets at bindImageSet of pipelineLayout, PushMaterialIndex pushes bindless indices instead,
+                * PushMeshMatrix pushes the matrix and joint offset of each packet's mesh like GLTFModel::drawNode
+                */
+                void draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const std::vector<VkPipeline> &pipelines,
+                          uint32_t renderFlags = 0, uint32_t bindImageSet = 1, uint32_t frameIndex = 0) const;
+
+                [[nodiscard]] const std::vector<Packet> &getPackets() const { return packets; }
+
+                [[nodiscard]] size_t size() const { return packets.size(); }
+
+            private:
+                std::vector<Packet> packets;
+            };
+        }
+    }
+}
+
+#endif //LIGHTFIELDFORWARDRENDERER_DRAWLIST_H
@@ -2,6 +2,7 @@
 // Created by swinston on 10/19/20.
 //
 
+#include <algorithm>
 #include <filesystem>
 #include "ktx.h"
 
@@ -9,9 +10,19 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "GLTFModel.h"
 #include "Initializers.h"
+#include "MeshOptimizer.h"
+#include "MipGenerator.h"
+#include "TextureLoader.h"
+#include "../ThreadPool.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define GLTF_ANIMATION_SSE 1
+#endif
 
 /*
 	We use a custom image loading function with tinyglTF, so we can do custom stuff loading ktx textures
+	Other images keep their encoded bytes, GLTFModel::loadImages decodes them on the worker threads
 */
 bool loadImageDataFunc(tinygltf::Image* image, const int imageIndex, std::string* error, std::string* warning, int req_width, int req_height, const unsigned char* bytes, int size, void* userData)
 {
@@ -22,7 +33,37 @@ bool loadImageDataFunc(tinygltf::Image* image, const int imageIndex, std::string
         }
     }
 
-    return tinygltf::LoadImageData(image, imageIndex, error, warning, req_width, req_height, bytes, size, userData);
+    // A zero width marks the data as still encoded, see Texture::decodeglTfImage
+    image->width = 0;
+    image->height = 0;
+    image->component = 0;
+    image->image.assign(bytes, bytes + size);
+    return true;
+}
+
+/*
+	Image a texture samples, KHR_texture_basisu textures name their KTX2 image in the extension and keep source as a fallback
+*/
+int textureSource(const tinygltf::Texture &texture)
+{
+    auto basisu = texture.extensions.find("KHR_texture_basisu");
+    if (basisu != texture.extensions.end() && basisu->second.Has("source")) {
+        return basisu->second.Get("source").Get<int>();
+    }
+    return texture.source;
+}
+
+/*
+	Cache key of a glTF image, external files by path and embedded images by their encoded contents
+	Color and data uses of one image get entries of their own, their generated mip levels differ
+*/
+std::string imageCacheKey(const tinygltf::Image &image, const std::string &path, bool srgb)
+{
+    const char *usage = srgb ? ":srgb" : ":linear";
+    if (!image.uri.empty() && image.uri.compare(0, 5, "data:") != 0) {
+        return Util::Renderer::vkglTF::TextureCache::fileKey(path + "/" + image.uri) + usage;
+    }
+    return Util::Renderer::vkglTF::TextureCache::contentKey(image.image.data(), image.image.size()) + usage;
 }
 
 bool loadImageDataFuncEmpty(tinygltf::Image* image, const int imageIndex, std::string* error, std::string* warning, int req_width, int req_height, const unsigned char* bytes, int size, void* userData)
@@ -35,11 +76,15 @@ namespace Util {
     namespace Renderer {
         VkDescriptorSetLayout vkglTF::descriptorSetLayoutImage = VK_NULL_HANDLE;
         VkDescriptorSetLayout vkglTF::descriptorSetLayoutUbo = VK_NULL_HANDLE;
+        VkDescriptorSetLayout vkglTF::descriptorSetLayoutJoints = VK_NULL_HANDLE;
         VkMemoryPropertyFlags vkglTF::memoryPropertyFlags = 0;
         uint32_t vkglTF::descriptorBindingFlags = vkglTF::DescriptorBindingFlags::ImageBaseColor;
         VkVertexInputBindingDescription vkglTF::Vertex::vertexInputBindingDescription;
         std::vector<VkVertexInputAttributeDescription> vkglTF::Vertex::vertexInputAttributeDescriptions;
         VkPipelineVertexInputStateCreateInfo vkglTF::Vertex::pipelineVertexInputStateCreateInfo;
+        VkVertexInputBindingDescription vkglTF::InstanceData::vertexInputBindingDescriptions[2];
+        std::vector<VkVertexInputAttributeDescription> vkglTF::InstanceData::vertexInputAttributeDescriptions;
+        VkPipelineVertexInputStateCreateInfo vkglTF::InstanceData::pipelineVertexInputStateCreateInfo;
         namespace vkglTF {
 
             void Texture::updateDescriptor() {
@@ -55,331 +100,57 @@ namespace Util {
                 vkDestroySampler(device->getLogicalDevice(), sampler, nullptr);
             }
 
-            void Texture::fromglTfImage(tinygltf::Image &gltfimage, const std::string& path, Device *pDevice, VkQueue copyQueue) {
+            void Texture::create(const TextureData &data, Device *pDevice, const MipGenerator *mipGenerator) {
                 this->device = pDevice;
+                width = data.width;
+                height = data.height;
+                mipLevels = data.mipLevels;
+                layerCount = 1;
+                imageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
-                bool isKtx = false;
-                // Image points to an external ktx file
-                if (gltfimage.uri.find_last_of('.') != std::string::npos) {
-                    if (gltfimage.uri.substr(gltfimage.uri.find_last_of('.') + 1) == "ktx") {
-                        isKtx = true;
-                    }
-                }
-
-                VkFormat format;
-
-                if (!isKtx) {
-                    // Texture was loaded using STB_Image
-
-                    unsigned char* buffer = nullptr;
-                    VkDeviceSize bufferSize = 0;
-                    bool deleteBuffer = false;
-                    if (gltfimage.component == 3) {
-                        // Most devices don't support RGB only on Vulkan so convert if necessary
-                        // TODO: Check actual format support and transform only if required
-                        bufferSize = gltfimage.width * gltfimage.height * 4;
-                        buffer = new unsigned char[bufferSize];
-                        unsigned char* rgba = buffer;
-                        unsigned char* rgb = &gltfimage.image[0];
-                        for (size_t i = 0; i < gltfimage.width * gltfimage.height; ++i) {
-                            for (int32_t j = 0; j < 3; ++j) {
-                                rgba[j] = rgb[j];
-                            }
-                            rgba += 4;
-                            rgb += 3;
-                        }
-                        deleteBuffer = true;
-                    }
-                    else {
-                        buffer = &gltfimage.image[0];
-                        bufferSize = gltfimage.image.size();
-                    }
-
-                    format = VK_FORMAT_R8G8B8A8_UNORM;
-
-                    VkFormatProperties formatProperties;
-
-                    width = gltfimage.width;
-                    height = gltfimage.height;
-                    mipLevels = static_cast<uint32_t>(floor(log2(std::max(width, height))) + 1.0);
-
-                    vkGetPhysicalDeviceFormatProperties(pDevice->getPhysicalDevice(), format, &formatProperties);
-                    assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT);
-                    assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
-
-                    VkMemoryAllocateInfo memAllocInfo{};
-                    memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-                    VkMemoryRequirements memReqs{};
-
-                    VkBuffer stagingBuffer;
-                    VkDeviceMemory stagingMemory;
-
-                    VkBufferCreateInfo bufferCreateInfo{};
-                    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-                    bufferCreateInfo.size = bufferSize;
-                    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-                    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-                    VK_CHECK_RESULT(vkCreateBuffer(pDevice->getLogicalDevice(), &bufferCreateInfo, nullptr, &stagingBuffer))
-                    vkGetBufferMemoryRequirements(pDevice->getLogicalDevice(), stagingBuffer, &memReqs);
-                    memAllocInfo.allocationSize = memReqs.size;
-                    memAllocInfo.memoryTypeIndex = pDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-                    VK_CHECK_RESULT(vkAllocateMemory(pDevice->getLogicalDevice(), &memAllocInfo, nullptr, &stagingMemory))
-                    VK_CHECK_RESULT(vkBindBufferMemory(pDevice->getLogicalDevice(), stagingBuffer, stagingMemory, 0))
-
-                    uint8_t* data;
-                    VK_CHECK_RESULT(vkMapMemory(pDevice->getLogicalDevice(), stagingMemory, 0, memReqs.size, 0, (void**)&data))
-                    memcpy(data, buffer, bufferSize);
-                    vkUnmapMemory(pDevice->getLogicalDevice(), stagingMemory);
-
-                    VkImageCreateInfo imageCreateInfo{};
-                    imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-                    imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-                    imageCreateInfo.format = format;
-                    imageCreateInfo.mipLevels = mipLevels;
-                    imageCreateInfo.arrayLayers = 1;
-                    imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-                    imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-                    imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
-                    imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-                    imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-                    imageCreateInfo.extent = { width, height, 1 };
-                    imageCreateInfo.usage = static_cast<uint32_t>(VK_IMAGE_USAGE_TRANSFER_DST_BIT) | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-                    VK_CHECK_RESULT(vkCreateImage(pDevice->getLogicalDevice(), &imageCreateInfo, nullptr, &image))
-                    vkGetImageMemoryRequirements(pDevice->getLogicalDevice(), image, &memReqs);
-                    memAllocInfo.allocationSize = memReqs.size;
-                    memAllocInfo.memoryTypeIndex = pDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-                    VK_CHECK_RESULT(vkAllocateMemory(pDevice->getLogicalDevice(), &memAllocInfo, nullptr, &deviceMemory))
-                    VK_CHECK_RESULT(vkBindImageMemory(pDevice->getLogicalDevice(), image, deviceMemory, 0))
-
-                    VkCommandBuffer copyCmd = pDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-                    VkImageSubresourceRange subresourceRange = {};
-                    subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                    subresourceRange.levelCount = 1;
-                    subresourceRange.layerCount = 1;
-
-                    {
-                        VkImageMemoryBarrier imageMemoryBarrier{};
-                        imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-                        imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-                        imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-                        imageMemoryBarrier.srcAccessMask = 0;
-                        imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-                        imageMemoryBarrier.image = image;
-                        imageMemoryBarrier.subresourceRange = subresourceRange;
-                        vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-                    }
-
-                    VkBufferImageCopy bufferCopyRegion = {};
-                    bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                    bufferCopyRegion.imageSubresource.mipLevel = 0;
-                    bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
-                    bufferCopyRegion.imageSubresource.layerCount = 1;
-                    bufferCopyRegion.imageExtent.width = width;
-                    bufferCopyRegion.imageExtent.height = height;
-                    bufferCopyRegion.imageExtent.depth = 1;
-
-                    vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
-
-                    {
-                        VkImageMemoryBarrier imageMemoryBarrier{};
-                        imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-                        imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-                        imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-                        imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-                        imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-                        imageMemoryBarrier.image = image;
-                        imageMemoryBarrier.subresourceRange = subresourceRange;
-                        vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-                    }
-
-                    pDevice->flushCommandBuffer(copyCmd, copyQueue, true);
-
-                    vkFreeMemory(pDevice->getLogicalDevice(), stagingMemory, nullptr);
-                    vkDestroyBuffer(pDevice->getLogicalDevice(), stagingBuffer, nullptr);
-
-                    // Generate the mip chain (glTF uses jpg and png, so we need to create this manually)
-                    VkCommandBuffer blitCmd = pDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-                    uint32_t timeSkipped = 0;
-                    for (uint32_t i = 1; i < mipLevels; i++) {
-                        VkImageBlit imageBlit{};
-
-                        imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                        imageBlit.srcSubresource.layerCount = 1;
-                        imageBlit.srcSubresource.mipLevel = i - 1;
-                        imageBlit.srcOffsets[1].x = int32_t(width >> (i - 1));
-                        imageBlit.srcOffsets[1].y = int32_t(height >> (i - 1));
-                        imageBlit.srcOffsets[1].z = 1;
-
-                        imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                        imageBlit.dstSubresource.layerCount = 1;
-                        imageBlit.dstSubresource.mipLevel = i;
-                        imageBlit.dstOffsets[1].x = int32_t(width >> i);
-                        imageBlit.dstOffsets[1].y = int32_t(height >> i);
-                        imageBlit.dstOffsets[1].z = 1;
-                        if(imageBlit.dstOffsets[0].x == imageBlit.dstOffsets[1].x || imageBlit.dstOffsets[0].y == imageBlit.dstOffsets[1].y || imageBlit.dstOffsets[0].z == imageBlit.dstOffsets[1].z) {
-                            timeSkipped++;
-                            continue;
-                        }
-
-                        VkImageSubresourceRange mipSubRange = {};
-                        mipSubRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                        mipSubRange.baseMipLevel = i;
-                        mipSubRange.levelCount = 1;
-                        mipSubRange.layerCount = 1;
-
-                        {
-                            VkImageMemoryBarrier imageMemoryBarrier{};
-                            imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-                            imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-                            imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-                            imageMemoryBarrier.srcAccessMask = 0;
-                            imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-                            imageMemoryBarrier.image = image;
-                            imageMemoryBarrier.subresourceRange = mipSubRange;
-                            vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+                VkImageCreateInfo imageCreateInfo = Initializers::imageCreateInfo();
+                imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+                imageCreateInfo.format = data.format;
+                imageCreateInfo.mipLevels = mipLevels;
+                imageCreateInfo.arrayLayers = 1;
+                imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+                imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+                imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+                imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                imageCreateInfo.extent = { width, height, 1 };
+                imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+                if (data.generateMipmaps && data.levelOffsets.size() < mipLevels) {
+                    if (mipGenerator && mipGenerator->supports(data.format)) {
+                        // Generated levels are written through storage views, sRGB images are viewed as UNORM
+                        imageCreateInfo.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+                        if (MipGenerator::storageFormat(data.format) != data.format) {
+                            imageCreateInfo.flags |= VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT;
                         }
-
-                        vkCmdBlitImage(blitCmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
-
-                        {
-                            VkImageMemoryBarrier imageMemoryBarrier{};
-                            imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-                            imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-                            imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-                            imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-                            imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-                            imageMemoryBarrier.image = image;
-                            imageMemoryBarrier.subresourceRange = mipSubRange;
-                            vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+                    } else {
+                        // Generated levels are blitted from the previous one
+                        VkFormatProperties formatProperties;
+                        vkGetPhysicalDeviceFormatProperties(pDevice->getPhysicalDevice(), data.format, &formatProperties);
+                        const VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                                                  VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+                        if ((formatProperties.optimalTilingFeatures & blitFeatures) == blitFeatures) {
+                            imageCreateInfo.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+                        } else {
+                            fprintf(stderr, "Texture: format %d can not be blitted, keeping %zu of %u mip levels\n",
+                                    data.format, data.levelOffsets.size(), mipLevels);
+                            mipLevels = static_cast<uint32_t>(data.levelOffsets.size());
+                            imageCreateInfo.mipLevels = mipLevels;
                         }
                     }
-                    mipLevels -= timeSkipped;
-
-                    subresourceRange.levelCount = mipLevels;
-                    imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-                    {
-                        VkImageMemoryBarrier imageMemoryBarrier{};
-                        imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-                        imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-                        imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                        imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-                        imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-                        imageMemoryBarrier.image = image;
-                        imageMemoryBarrier.subresourceRange = subresourceRange;
-                        vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-                    }
-
-                    pDevice->flushCommandBuffer(blitCmd, copyQueue, true);
                 }
-                else {
-                    // Texture is stored in an external ktx file
-                    std::string filename = path + "/" + gltfimage.uri;
+                VK_CHECK_RESULT(vkCreateImage(pDevice->getLogicalDevice(), &imageCreateInfo, nullptr, &image))
 
-                    ktxTexture* ktxTexture;
-
-                    ktxResult result;
-                    if (!std::filesystem::exists(filename.c_str())) {
-                        fprintf(stderr, "Could not load texture from %s \n\nThe file may be part of the additional asset pack.\n\nRun \"download_assets.py\" in the repository root to download the latest version.", filename.c_str());
-                        assert(false);
-                    }
-                    result = ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
-                    assert(result == KTX_SUCCESS);
-
-                    this->device = pDevice;
-                    width = ktxTexture->baseWidth;
-                    height = ktxTexture->baseHeight;
-                    mipLevels = ktxTexture->numLevels;
-
-                    ktx_uint8_t* ktxTextureData = ktxTexture_GetData(ktxTexture);
-                    ktx_size_t ktxTextureSize = ktxTexture_GetDataSize(ktxTexture);
-                    // @todo: Use ktxTexture_GetVkFormat(ktxTexture)
-                    format = VK_FORMAT_R8G8B8A8_UNORM;
-
-                    // Get device properties for the requested texture format
-                    VkFormatProperties formatProperties;
-                    vkGetPhysicalDeviceFormatProperties(pDevice->getPhysicalDevice(), format, &formatProperties);
-
-                    VkCommandBuffer copyCmd = pDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-                    VkBuffer stagingBuffer;
-                    VkDeviceMemory stagingMemory;
-
-                    VkBufferCreateInfo bufferCreateInfo = Initializers::bufferCreateInfo();
-                    bufferCreateInfo.size = ktxTextureSize;
-                    // This buffer is used as a transfer source for the buffer copy
-                    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-                    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-                    VK_CHECK_RESULT(vkCreateBuffer(pDevice->getLogicalDevice(), &bufferCreateInfo, nullptr, &stagingBuffer))
-
-                    VkMemoryAllocateInfo memAllocInfo = Initializers::memoryAllocateInfo();
-                    VkMemoryRequirements memReqs;
-                    vkGetBufferMemoryRequirements(pDevice->getLogicalDevice(), stagingBuffer, &memReqs);
-                    memAllocInfo.allocationSize = memReqs.size;
-                    memAllocInfo.memoryTypeIndex = pDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-                    VK_CHECK_RESULT(vkAllocateMemory(pDevice->getLogicalDevice(), &memAllocInfo, nullptr, &stagingMemory))
-                    VK_CHECK_RESULT(vkBindBufferMemory(pDevice->getLogicalDevice(), stagingBuffer, stagingMemory, 0))
-
-                    uint8_t* data;
-                    VK_CHECK_RESULT(vkMapMemory(pDevice->getLogicalDevice(), stagingMemory, 0, memReqs.size, 0, (void**)&data))
-                    memcpy(data, ktxTextureData, ktxTextureSize);
-                    vkUnmapMemory(pDevice->getLogicalDevice(), stagingMemory);
-
-                    std::vector<VkBufferImageCopy> bufferCopyRegions;
-                    for (uint32_t i = 0; i < mipLevels; i++)
-                    {
-                        ktx_size_t offset;
-                        KTX_error_code locResult = ktxTexture_GetImageOffset(ktxTexture, i, 0, 0, &offset);
-                        assert(locResult == KTX_SUCCESS);
-                        VkBufferImageCopy bufferCopyRegion = {};
-                        bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                        bufferCopyRegion.imageSubresource.mipLevel = i;
-                        bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
-                        bufferCopyRegion.imageSubresource.layerCount = 1;
-                        bufferCopyRegion.imageExtent.width = std::max(1u, ktxTexture->baseWidth >> i);
-                        bufferCopyRegion.imageExtent.height = std::max(1u, ktxTexture->baseHeight >> i);
-                        bufferCopyRegion.imageExtent.depth = 1;
-                        bufferCopyRegion.bufferOffset = offset;
-                        bufferCopyRegions.push_back(bufferCopyRegion);
-                    }
-
-                    // Create optimal tiled target image
-                    VkImageCreateInfo imageCreateInfo = Initializers::imageCreateInfo();
-                    imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-                    imageCreateInfo.format = format;
-                    imageCreateInfo.mipLevels = mipLevels;
-                    imageCreateInfo.arrayLayers = 1;
-                    imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-                    imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-                    imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-                    imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-                    imageCreateInfo.extent = { width, height, 1 };
-                    imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-                    VK_CHECK_RESULT(vkCreateImage(pDevice->getLogicalDevice(), &imageCreateInfo, nullptr, &image))
-
-                    vkGetImageMemoryRequirements(pDevice->getLogicalDevice(), image, &memReqs);
-                    memAllocInfo.allocationSize = memReqs.size;
-                    memAllocInfo.memoryTypeIndex = pDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-                    VK_CHECK_RESULT(vkAllocateMemory(pDevice->getLogicalDevice(), &memAllocInfo, nullptr, &deviceMemory))
-                    VK_CHECK_RESULT(vkBindImageMemory(pDevice->getLogicalDevice(), image, deviceMemory, 0))
-
-                    VkImageSubresourceRange subresourceRange = {};
-                    subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                    subresourceRange.baseMipLevel = 0;
-                    subresourceRange.levelCount = mipLevels;
-                    subresourceRange.layerCount = 1;
-
-                    tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
-                    vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
-                    tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
-                    pDevice->flushCommandBuffer(copyCmd, copyQueue);
-                    this->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-                    vkFreeMemory(pDevice->getLogicalDevice(), stagingMemory, nullptr);
-                    vkDestroyBuffer(pDevice->getLogicalDevice(), stagingBuffer, nullptr);
-
-                    ktxTexture_Destroy(ktxTexture);
-                }
+                VkMemoryAllocateInfo memAllocInfo = Initializers::memoryAllocateInfo();
+                VkMemoryRequirements memReqs;
+                vkGetImageMemoryRequirements(pDevice->getLogicalDevice(), image, &memReqs);
+                memAllocInfo.allocationSize = memReqs.size;
+                memAllocInfo.memoryTypeIndex = pDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+                VK_CHECK_RESULT(vkAllocateMemory(pDevice->getLogicalDevice(), &memAllocInfo, nullptr, &deviceMemory))
+                VK_CHECK_RESULT(vkBindImageMemory(pDevice->getLogicalDevice(), image, deviceMemory, 0))
 
                 VkSamplerCreateInfo samplerInfo{};
                 samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
@@ -391,8 +162,6 @@ namespace Util {
                 samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
                 samplerInfo.compareOp = VK_COMPARE_OP_NEVER;
                 samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-                samplerInfo.maxAnisotropy = 1.0;
-                samplerInfo.anisotropyEnable = VK_FALSE;
                 samplerInfo.maxLod = (float)mipLevels;
                 samplerInfo.maxAnisotropy = 8.0f;
                 samplerInfo.anisotropyEnable = VK_TRUE;
@@ -402,26 +171,146 @@ namespace Util {
                 viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
                 viewInfo.image = image;
                 viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-                viewInfo.format = format;
+                viewInfo.format = data.format;
                 viewInfo.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
                 viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
                 viewInfo.subresourceRange.layerCount = 1;
                 viewInfo.subresourceRange.levelCount = mipLevels;
                 VK_CHECK_RESULT(vkCreateImageView(pDevice->getLogicalDevice(), &viewInfo, nullptr, &view))
 
-                descriptor.sampler = sampler;
-                descriptor.imageView = view;
-                descriptor.imageLayout = imageLayout;
+                // The descriptor is valid once the recorded upload completed
+                imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                updateDescriptor();
+            }
+
+            void Texture::recordUpload(VkCommandBuffer commandBuffer, VkBuffer staging, VkDeviceSize offset, const TextureData &data,
+                                       MipGenerator *mipGenerator) {
+                const auto storedLevels = static_cast<uint32_t>(data.levelOffsets.size());
+
+                VkImageSubresourceRange subresourceRange = {};
+                subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                subresourceRange.baseMipLevel = 0;
+                subresourceRange.levelCount = mipLevels;
+                subresourceRange.layerCount = 1;
+                tools::setImageLayout(commandBuffer, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange,
+                                      VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+                std::vector<VkBufferImageCopy> bufferCopyRegions(storedLevels);
+                for (uint32_t i = 0; i < storedLevels; i++) {
+                    VkBufferImageCopy &bufferCopyRegion = bufferCopyRegions[i];
+                    bufferCopyRegion = {};
+                    bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                    bufferCopyRegion.imageSubresource.mipLevel = i;
+                    bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
+                    bufferCopyRegion.imageSubresource.layerCount = 1;
+                    bufferCopyRegion.imageExtent.width = std::max(1u, width >> i);
+                    bufferCopyRegion.imageExtent.height = std::max(1u, height >> i);
+                    bufferCopyRegion.imageExtent.depth = 1;
+                    bufferCopyRegion.bufferOffset = offset + data.levelOffsets[i];
+                }
+                vkCmdCopyBufferToImage(commandBuffer, staging, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                       static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
+
+                if (!data.generateMipmaps || storedLevels >= mipLevels) {
+                    tools::setImageLayout(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange,
+                                          VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+                    return;
+                }
+
+                // Generate the rest of the chain (glTF uses jpg and png, so we need to create this manually)
+                if (mipGenerator && mipGenerator->supports(data.format)) {
+                    mipGenerator->record(commandBuffer, image, data.format, width, height, storedLevels, mipLevels, data.srgb);
+                    return;
+                }
+                VkImageSubresourceRange mipSubRange = subresourceRange;
+                mipSubRange.levelCount = 1;
+                for (uint32_t i = storedLevels; i < mipLevels; i++) {
+                    mipSubRange.baseMipLevel = i - 1;
+                    tools::setImageLayout(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, mipSubRange,
+                                          VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+                    VkImageBlit imageBlit{};
+                    imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                    imageBlit.srcSubresource.layerCount = 1;
+                    imageBlit.srcSubresource.mipLevel = i - 1;
+                    imageBlit.srcOffsets[1].x = int32_t(std::max(1u, width >> (i - 1)));
+                    imageBlit.srcOffsets[1].y = int32_t(std::max(1u, height >> (i - 1)));
+                    imageBlit.srcOffsets[1].z = 1;
+                    imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                    imageBlit.dstSubresource.layerCount = 1;
+                    imageBlit.dstSubresource.mipLevel = i;
+                    imageBlit.dstOffsets[1].x = int32_t(std::max(1u, width >> i));
+                    imageBlit.dstOffsets[1].y = int32_t(std::max(1u, height >> i));
+                    imageBlit.dstOffsets[1].z = 1;
+                    vkCmdBlitImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
+                }
+
+                // Every level but the last one was a blit source
+                VkImageSubresourceRange sourceRange = subresourceRange;
+                sourceRange.levelCount = mipLevels - 1;
+                tools::setImageLayout(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, sourceRange,
+                                      VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+                mipSubRange.baseMipLevel = mipLevels - 1;
+                tools::setImageLayout(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipSubRange,
+                                      VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+            }
+
+            void Texture::fromTextureData(TextureData &data, Device *pDevice, VkQueue copyQueue, MipGenerator *mipGenerator) {
+                data.prepareUpload(pDevice, mipGenerator);
+                Buffers staging;
+                VK_CHECK_RESULT(pDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                      &staging, data.stagingSize()))
+                VK_CHECK_RESULT(staging.map())
+                data.writeStaging(static_cast<uint8_t *>(staging.mapped));
+                staging.unmap();
+                create(data, pDevice, mipGenerator);
+                VkCommandBuffer copyCmd = pDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+                recordUpload(copyCmd, staging.buffer, 0, data, mipGenerator);
+                pDevice->flushCommandBuffer(copyCmd, copyQueue, true);
+                staging.destroy();
+            }
+
+            bool Texture::fromglTfImage(tinygltf::Image &gltfimage, const std::string& path, Device *pDevice, VkQueue copyQueue) {
+                TextureData data;
+                if (!decodeglTfImage(data, gltfimage, path, TranscodeTargets::select(pDevice))) {
+                    fprintf(stderr, "Could not decode glTF image %s\n", gltfimage.uri.empty() ? gltfimage.name.c_str() : gltfimage.uri.c_str());
+                    return false;
+                }
+                fromTextureData(data, pDevice, copyQueue);
+                return true;
             }
 
-            void Material::createDescriptorSet(VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout,
+            bool Texture::decodeglTfImage(TextureData &data, const tinygltf::Image &gltfimage, const std::string &path,
+                                          const TranscodeTargets &targets) {
+                // Image points to an external ktx file
+                const size_t dot = gltfimage.uri.find_last_of('.');
+                const std::string extension = dot != std::string::npos ? gltfimage.uri.substr(dot + 1) : std::string();
+                if (extension == "ktx") {
+                    std::string filename = path + "/" + gltfimage.uri;
+                    if (!std::filesystem::exists(filename.c_str())) {
+                        fprintf(stderr, "Could not load texture from %s \n\nThe file may be part of the additional asset pack.\n\nRun \"download_assets.py\" in the repository root to download the latest version.", filename.c_str());
+                        return false;
+                    }
+                    return data.loadKtx(filename);
+                }
+                if (gltfimage.image.empty()) {
+                    return false;
+                }
+                // KHR_texture_basisu images, loadImageDataFunc keeps them like any other encoded image
+                if (gltfimage.mimeType == "image/ktx2" || extension == "ktx2") {
+                    return data.loadKtx(gltfimage.image.data(), gltfimage.image.size(), targets);
+                }
+                // loadImageDataFunc keeps the encoded bytes, images decoded by tinyglTF itself have their size set
+                if (gltfimage.width <= 0) {
+                    return data.decodeImage(gltfimage.image.data(), gltfimage.image.size());
+                }
+                return data.fromPixels(gltfimage.image.data(), gltfimage.width, gltfimage.height, gltfimage.component);
+            }
+
+            void Material::createDescriptorSet(DescriptorAllocator &descriptorAllocator, VkDescriptorSetLayout descriptorSetLayout,
                                           uint32_t _descriptorBindingFlags) {
-                VkDescriptorSetAllocateInfo descriptorSetAllocInfo{};
-                descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-                descriptorSetAllocInfo.descriptorPool = descriptorPool;
-                descriptorSetAllocInfo.pSetLayouts = &descriptorSetLayout;
-                descriptorSetAllocInfo.descriptorSetCount = 1;
-                VK_CHECK_RESULT(vkAllocateDescriptorSets(device->getLogicalDevice(), &descriptorSetAllocInfo, &descriptorSet))
+                VK_CHECK_RESULT(descriptorAllocator.allocate(descriptorSetLayout, &descriptorSet))
                 std::vector<VkDescriptorImageInfo> imageDescriptors{};
                 std::vector<VkWriteDescriptorSet> writeDescriptorSets{};
                 if (_descriptorBindingFlags & DescriptorBindingFlags::ImageBaseColor) {
@@ -467,7 +356,8 @@ namespace Util {
                 , indexCount(indexCount)
                 , firstVertex(0)
                 , vertexCount(0)
-                , material(_material) { }
+                , material(_material)
+                , boundsIndex(UINT32_MAX) { }
 
             Mesh::Mesh(Device *_device, glm::mat4 matrix)
             : device(_device)
@@ -489,49 +379,237 @@ namespace Util {
                 vkFreeMemory(device->getLogicalDevice(), uniformBuffer.memory, nullptr);
             }
 
+            const glm::vec3 &Node::getTranslation() const {
+                return graph->local.translations[id];
+            }
+
+            const glm::quat &Node::getRotation() const {
+                return graph->local.rotations[id];
+            }
+
+            const glm::vec3 &Node::getScale() const {
+                return graph->local.scales[id];
+            }
+
+            void Node::setTranslation(const glm::vec3 &translation) {
+                graph->local.translations[id] = translation;
+                graph->dirty[id] = 1;
+            }
+
+            void Node::setRotation(const glm::quat &rotation) {
+                graph->local.rotations[id] = rotation;
+                graph->dirty[id] = 1;
+            }
+
+            void Node::setScale(const glm::vec3 &scale) {
+                graph->local.scales[id] = scale;
+                graph->dirty[id] = 1;
+            }
+
+            void Node::setMatrix(const glm::mat4 &matrix) {
+                graph->matrices[id] = matrix;
+                graph->dirty[id] = 1;
+            }
+
             glm::mat4 Node::localMatrix() const {
-                return glm::translate(glm::mat4(1.0f), translation) * glm::mat4(rotation) * glm::scale(glm::mat4(1.0f), scale) * matrix;
+                return graph->localMatrix(graph->local, id);
             }
 
-            glm::mat4 Node::getMatrix() const {
-                glm::mat4 m = localMatrix();
-                vkglTF::Node *p = parent;
-                while (p) {
-                    m = p->localMatrix() * m;
-                    p = p->parent;
-                }
-                return m;
+            const glm::mat4 &Node::getMatrix() const {
+                return graph->worldMatrices[id];
+            }
+
+            void Node::markDirty() {
+                graph->dirty[id] = 1;
             }
 
             void Node::update() {
                 if (mesh) {
-                    glm::mat4 m = getMatrix();
+                    mesh->uniformBlock.matrix = getMatrix();
                     if (skin) {
-                        mesh->uniformBlock.matrix = m;
-                        // Update join matrices
-                        glm::mat4 inverseTransform = glm::inverse(m);
-                        for (size_t i = 0; i < skin->joints.size(); i++) {
-                            vkglTF::Node *jointNode = skin->joints[i];
-                            glm::mat4 jointMat = jointNode->getMatrix() * skin->inverseBindMatrices[i];
-                            jointMat = inverseTransform * jointMat;
-                            mesh->uniformBlock.jointMatrix[i] = jointMat;
-                        }
-                        mesh->uniformBlock.jointcount = (float)skin->joints.size();
-                        memcpy(mesh->uniformBuffer.mapped, &mesh->uniformBlock, sizeof(mesh->uniformBlock));
+                        mesh->uniformBlock.jointCount = static_cast<uint32_t>(skin->joints.size());
+                    }
+                    memcpy(mesh->uniformBuffer.mapped, &mesh->uniformBlock, sizeof(mesh->uniformBlock));
+                }
+            }
+
+            uint32_t SceneGraph::add(Node *node, int32_t parent, int32_t meshIndex, int32_t skinIndex) {
+                assert(parent < static_cast<int32_t>(nodes.size()));
+                const auto id = static_cast<uint32_t>(nodes.size());
+                parents.push_back(parent);
+                local.translations.emplace_back(0.0f);
+                local.rotations.emplace_back(1.0f, 0.0f, 0.0f, 0.0f);
+                local.scales.emplace_back(1.0f);
+                matrices.emplace_back(1.0f);
+                worldMatrices.emplace_back(1.0f);
+                meshIndices.push_back(meshIndex);
+                skinIndices.push_back(skinIndex);
+                dirty.push_back(1);
+                changed.push_back(0);
+                nodes.push_back(node);
+                node->graph = this;
+                node->id = id;
+                return id;
+            }
+
+            glm::mat4 SceneGraph::localMatrix(const Pose &pose, uint32_t id) const {
+                return glm::translate(glm::mat4(1.0f), pose.translations[id]) * glm::mat4(pose.rotations[id]) * glm::scale(glm::mat4(1.0f), pose.scales[id]) * matrices[id];
+            }
+
+            void SceneGraph::updateWorldMatrices(const Pose &pose, const glm::mat4 &rootMatrix, std::vector<uint8_t> &dirtyFlags,
+                                                 std::vector<uint8_t> &changedFlags, std::vector<glm::mat4> &world) const {
+                // Parents always precede their children, so their world matrix and changed flag are final when read
+                for (size_t i = 0; i < nodes.size(); i++) {
+                    const int32_t parent = parents[i];
+                    const bool parentChanged = parent >= 0 && changedFlags[parent];
+                    if (dirtyFlags[i] || parentChanged) {
+                        const glm::mat4 &parentMatrix = parent >= 0 ? world[parent] : rootMatrix;
+                        world[i] = parentMatrix * localMatrix(pose, static_cast<uint32_t>(i));
+                        dirtyFlags[i] = 0;
+                        changedFlags[i] = 1;
                     } else {
-                        memcpy(mesh->uniformBuffer.mapped, &m, sizeof(glm::mat4));
+                        changedFlags[i] = 0;
                     }
                 }
+            }
+
+            void SceneGraph::updateWorldMatrices() {
+                updateWorldMatrices(local, glm::mat4(1.0f), dirty, changed, worldMatrices);
+            }
 
-                for (auto& child : children) {
-                    child->update();
+            uint32_t AnimationSampler::findKey(float time, uint32_t &cursor, float &u) const {
+                const auto last = static_cast<uint32_t>(inputs.size()) - 1;
+                if (last == 0 || time <= inputs.front()) {
+                    cursor = 0;
+                    u = 0.0f;
+                    return 0;
+                }
+                if (time >= inputs.back()) {
+                    cursor = last - 1;
+                    u = 1.0f;
+                    return cursor;
+                }
+                // Monotonic playback stays in the cached interval or advances to the next one
+                if (cursor >= last || !(inputs[cursor] <= time && time < inputs[cursor + 1])) {
+                    if (cursor + 1 < last && inputs[cursor + 1] <= time && time < inputs[cursor + 2]) {
+                        cursor++;
+                    } else {
+                        // Seek: first key after time, the interval starts one before it
+                        auto it = std::upper_bound(inputs.begin(), inputs.end(), time);
+                        cursor = static_cast<uint32_t>(it - inputs.begin()) - 1;
+                    }
                 }
+                const float span = inputs[cursor + 1] - inputs[cursor];
+                u = span > 0.0f ? std::min(std::max((time - inputs[cursor]) / span, 0.0f), 1.0f) : 0.0f;
+                return cursor;
             }
 
-            Node::~Node() {
-                delete mesh;
-                for (auto& child : children) {
-                    delete child;
+            namespace {
+                /*
+                    Every interpolation mode reduces to a weighted sum of at most four key values,
+                    which lets the summation run over a batch of channels with one vec4 per SIMD register
+                */
+                struct KeyBlend {
+                    const glm::vec4 *values[4];
+                    float weights[4];
+                    bool normalize;
+                };
+
+                const glm::vec4 zeroValue(0.0f);
+
+                void blendKeys(const KeyBlend *blends, size_t count, glm::vec4 *results) {
+                    for (size_t i = 0; i < count; i++) {
+                        const KeyBlend &blend = blends[i];
+#ifdef GLTF_ANIMATION_SSE
+                        __m128 r = _mm_mul_ps(_mm_loadu_ps(&blend.values[0]->x), _mm_set1_ps(blend.weights[0]));
+                        r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(&blend.values[1]->x), _mm_set1_ps(blend.weights[1])));
+                        r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(&blend.values[2]->x), _mm_set1_ps(blend.weights[2])));
+                        r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(&blend.values[3]->x), _mm_set1_ps(blend.weights[3])));
+                        if (blend.normalize) {
+                            __m128 sq = _mm_mul_ps(r, r);
+                            sq = _mm_add_ps(sq, _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(2, 3, 0, 1)));
+                            sq = _mm_add_ps(sq, _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(1, 0, 3, 2)));
+                            r = _mm_div_ps(r, _mm_sqrt_ps(sq));
+                        }
+                        _mm_storeu_ps(&results[i].x, r);
+#else
+                        glm::vec4 r = *blend.values[0] * blend.weights[0] + *blend.values[1] * blend.weights[1]
+                                      + *blend.values[2] * blend.weights[2] + *blend.values[3] * blend.weights[3];
+                        if (blend.normalize) {
+                            r = glm::normalize(r);
+                        }
+                        results[i] = r;
+#endif
+                    }
+                }
+            }
+
+            void Animation::evaluate(float time, uint32_t *cursors, glm::vec4 *values) const {
+                const size_t batchSize = 64;
+                KeyBlend blends[batchSize];
+                for (size_t base = 0; base < channels.size(); base += batchSize) {
+                    const size_t count = std::min(batchSize, channels.size() - base);
+                    for (size_t c = 0; c < count; c++) {
+                        const AnimationChannel &channel = channels[base + c];
+                        const AnimationSampler &sampler = samplers[channel.samplerIndex];
+                        KeyBlend &blend = blends[c];
+                        blend.normalize = channel.path == AnimationChannel::PathType::ROTATION;
+                        for (int k = 0; k < 4; k++) {
+                            blend.values[k] = &zeroValue;
+                            blend.weights[k] = 0.0f;
+                        }
+
+                        float u;
+                        const uint32_t key = sampler.findKey(time, cursors[base + c], u);
+                        const uint32_t next = std::min(key + 1, static_cast<uint32_t>(sampler.inputs.size()) - 1);
+                        switch (sampler.interpolation) {
+                            case AnimationSampler::InterpolationType::STEP: {
+                                // Clamping past the last key reports u = 1 on the final interval
+                                blend.values[0] = &sampler.outputsVec4[u >= 1.0f ? next : key];
+                                blend.weights[0] = 1.0f;
+                                break;
+                            }
+                            case AnimationSampler::InterpolationType::CUBICSPLINE: {
+                                // Hermite spline, tangents are scaled by the interval length (glTF 2.0 appendix C)
+                                const float delta = sampler.inputs[next] - sampler.inputs[key];
+                                const float u2 = u * u;
+                                const float u3 = u2 * u;
+                                blend.values[0] = &sampler.outputsVec4[key * 3 + 1];
+                                blend.values[1] = &sampler.outputsVec4[key * 3 + 2];
+                                blend.values[2] = &sampler.outputsVec4[next * 3 + 1];
+                                blend.values[3] = &sampler.outputsVec4[next * 3];
+                                blend.weights[0] = 2.0f * u3 - 3.0f * u2 + 1.0f;
+                                blend.weights[1] = (u3 - 2.0f * u2 + u) * delta;
+                                blend.weights[2] = -2.0f * u3 + 3.0f * u2;
+                                blend.weights[3] = (u3 - u2) * delta;
+                                break;
+                            }
+                            case AnimationSampler::InterpolationType::LINEAR:
+                            default: {
+                                const glm::vec4 &v0 = sampler.outputsVec4[key];
+                                const glm::vec4 &v1 = sampler.outputsVec4[next];
+                                blend.values[0] = &v0;
+                                blend.values[1] = &v1;
+                                blend.weights[0] = 1.0f - u;
+                                blend.weights[1] = u;
+                                if (blend.normalize) {
+                                    // Slerp as a weighted sum, taking the shorter arc
+                                    float d = glm::dot(v0, v1);
+                                    const float sign = d < 0.0f ? -1.0f : 1.0f;
+                                    d *= sign;
+                                    if (d < 0.9995f) {
+                                        const float theta = acosf(d);
+                                        const float sinTheta = sinf(theta);
+                                        blend.weights[0] = sinf((1.0f - u) * theta) / sinTheta;
+                                        blend.weights[1] = sinf(u * theta) / sinTheta;
+                                    }
+                                    blend.weights[1] *= sign;
+                                }
+                                break;
+                            }
+                        }
+                    }
+                    blendKeys(blends, count, values + base);
                 }
             }
 
@@ -591,6 +669,37 @@ namespace Util {
                 return &pipelineVertexInputStateCreateInfo;
             }
 
+            VkVertexInputBindingDescription InstanceData::inputBindingDescription(uint32_t binding) {
+                return VkVertexInputBindingDescription({ binding, sizeof(InstanceData), VK_VERTEX_INPUT_RATE_INSTANCE });
+            }
+
+            std::vector<VkVertexInputAttributeDescription>
+            InstanceData::inputAttributeDescriptions(uint32_t binding, uint32_t firstLocation) {
+                std::vector<VkVertexInputAttributeDescription> result;
+                for (uint32_t column = 0; column < 4; column++) {
+                    result.push_back({ firstLocation + column, binding, VK_FORMAT_R32G32B32A32_SFLOAT,
+                                       static_cast<uint32_t>(offsetof(InstanceData, transform) + column * sizeof(glm::vec4)) });
+                }
+                result.push_back({ firstLocation + 4, binding, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(InstanceData, parameters) });
+                return result;
+            }
+
+            VkPipelineVertexInputStateCreateInfo *
+            InstanceData::getPipelineVertexInputState(const std::vector<VertexComponent>& components) {
+                vertexInputBindingDescriptions[0] = Vertex::inputBindingDescription(0);
+                vertexInputBindingDescriptions[1] = InstanceData::inputBindingDescription(1);
+                vertexInputAttributeDescriptions = Vertex::inputAttributeDescriptions(0, components);
+                const std::vector<VkVertexInputAttributeDescription> instanceAttributes =
+                        InstanceData::inputAttributeDescriptions(1, static_cast<uint32_t>(components.size()));
+                vertexInputAttributeDescriptions.insert(vertexInputAttributeDescriptions.end(), instanceAttributes.begin(), instanceAttributes.end());
+                pipelineVertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+                pipelineVertexInputStateCreateInfo.vertexBindingDescriptionCount = 2;
+                pipelineVertexInputStateCreateInfo.pVertexBindingDescriptions = vertexInputBindingDescriptions;
+                pipelineVertexInputStateCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexInputAttributeDescriptions.size());
+                pipelineVertexInputStateCreateInfo.pVertexAttributeDescriptions = vertexInputAttributeDescriptions.data();
+                return &pipelineVertexInputStateCreateInfo;
+            }
+
             vkglTF::Texture *GLTFModel::getTexture(uint32_t index) {
                 if (index < textures.size()) {
                     return &textures[index];
@@ -704,7 +813,6 @@ namespace Util {
             GLTFModel::GLTFModel()
             : emptyTexture()
             , device(nullptr)
-            , descriptorPool()
             , vertices()
             , indices() { }
 
@@ -713,9 +821,8 @@ namespace Util {
                 vkFreeMemory(device->getLogicalDevice(), vertices.memory, nullptr);
                 vkDestroyBuffer(device->getLogicalDevice(), indices.buffer, nullptr);
                 vkFreeMemory(device->getLogicalDevice(), indices.memory, nullptr);
-                for (auto texture : textures) {
-                    texture.destroy();
-                }
+                // Cached textures outlive the model while other models or the cache budget keep them
+                textureHandles.clear();
                 for (auto node : nodes) {
                     delete node;
                 }
@@ -723,11 +830,28 @@ namespace Util {
                     vkDestroyDescriptorSetLayout(device->getLogicalDevice(), descriptorSetLayoutUbo, nullptr);
                     descriptorSetLayoutUbo = VK_NULL_HANDLE;
                 }
+                for (auto &buffer : joints.buffers) {
+                    buffer.unmap();
+                    buffer.destroy();
+                }
+                for (size_t frame = 0; frame < skinning.buffers.size(); frame++) {
+                    vkDestroyBuffer(device->getLogicalDevice(), skinning.buffers[frame], nullptr);
+                    vkFreeMemory(device->getLogicalDevice(), skinning.memories[frame], nullptr);
+                }
+                if (skinning.pipeline != VK_NULL_HANDLE) {
+                    vkDestroyPipeline(device->getLogicalDevice(), skinning.pipeline, nullptr);
+                    vkDestroyPipelineLayout(device->getLogicalDevice(), skinning.pipelineLayout, nullptr);
+                    vkDestroyDescriptorSetLayout(device->getLogicalDevice(), skinning.descriptorSetLayout, nullptr);
+                }
+                if (descriptorSetLayoutJoints != VK_NULL_HANDLE) {
+                    vkDestroyDescriptorSetLayout(device->getLogicalDevice(), descriptorSetLayoutJoints, nullptr);
+                    descriptorSetLayoutJoints = VK_NULL_HANDLE;
+                }
                 if (descriptorSetLayoutImage != VK_NULL_HANDLE) {
                     vkDestroyDescriptorSetLayout(device->getLogicalDevice(), descriptorSetLayoutImage, nullptr);
                     descriptorSetLayoutImage = VK_NULL_HANDLE;
                 }
-                vkDestroyDescriptorPool(device->getLogicalDevice(), descriptorPool, nullptr);
+                descriptorAllocator.destroy();
                 emptyTexture.destroy();
             }
 
@@ -739,26 +863,27 @@ namespace Util {
                 newNode->parent = parent;
                 newNode->name = node.name;
                 newNode->skinIndex = node.skin;
-                newNode->matrix = glm::mat4(1.0f);
+                // Added before the children are loaded, which keeps the scene graph in topological order
+                sceneGraph.add(newNode, parent ? static_cast<int32_t>(parent->id) : -1, node.mesh, node.skin);
+                if (nodeIndex < nodeLookup.size()) {
+                    nodeLookup[nodeIndex] = newNode;
+                }
+                if (!node.name.empty()) {
+                    nodeNameLookup.emplace(node.name, newNode);
+                }
 
                 // Generate local node matrix
-                auto translation = glm::vec3(0.0f);
                 if (node.translation.size() == 3) {
-                    translation = glm::make_vec3(node.translation.data());
-                    newNode->translation = translation;
+                    newNode->setTranslation(glm::make_vec3(node.translation.data()));
                 }
-                glm::mat4 rotation = glm::mat4(1.0f);
                 if (node.rotation.size() == 4) {
-                    glm::quat q = glm::make_quat(node.rotation.data());
-                    newNode->rotation = glm::mat4(q);
+                    newNode->setRotation(glm::make_quat(node.rotation.data()));
                 }
-                auto scale = glm::vec3(1.0f);
                 if (node.scale.size() == 3) {
-                    scale = glm::make_vec3(node.scale.data());
-                    newNode->scale = scale;
+                    newNode->setScale(glm::make_vec3(node.scale.data()));
                 }
                 if (node.matrix.size() == 16) {
-                    newNode->matrix = glm::make_mat4x4(node.matrix.data());
+                    newNode->setMatrix(glm::make_mat4x4(node.matrix.data()));
                     if (globalscale != 1.0f) {
                         //newNode->matrix = glm::scale(newNode->matrix, glm::vec3(globalscale));
                     }
@@ -774,7 +899,7 @@ namespace Util {
                 // Node contains mesh data
                 if (node.mesh > -1) {
                     const tinygltf::Mesh mesh = model.meshes[node.mesh];
-                    Mesh *newMesh = new Mesh(device, newNode->matrix);
+                    Mesh *newMesh = new Mesh(device, sceneGraph.matrices[newNode->id]);
                     newMesh->name = mesh.name;
                     for (const auto & primitive : mesh.primitives) {
                         if (primitive.indices < 0) {
@@ -948,7 +1073,7 @@ namespace Util {
                     for (int jointIndex : source.joints) {
                         Node* node = nodeFromIndex(jointIndex);
                         if (node) {
-                            newSkin->joints.push_back(nodeFromIndex(jointIndex));
+                            newSkin->joints.push_back(node);
                         }
                     }
 
@@ -966,24 +1091,73 @@ namespace Util {
             }
 
             void GLTFModel::loadImages(tinygltf::Model &gltfModel, Device *_device, VkQueue transferQueue) {
-                for (tinygltf::Image &image : gltfModel.images) {
-                    vkglTF::Texture texture({});
-                    texture.fromglTfImage(image, path, _device, transferQueue);
-                    textures.push_back(texture);
-                }
                 // Create an empty texture to be used for empty material images
                 createEmptyTexture(transferQueue);
+
+                // Images already cached by other models are shared, the rest is decoded on the workers and uploaded in batches
+                TextureCache &cache = TextureCache::global();
+                TextureLoader loader(_device, transferQueue);
+                const TranscodeTargets &targets = loader.getTranscodeTargets();
+                const size_t imageCount = gltfModel.images.size();
+                std::vector<std::string> keys(imageCount);
+                std::vector<TextureLoader::Handle> requests(imageCount);
+                textureHandles.resize(imageCount);
+
+                // Color images hold sRGB encoded values, their generated mip levels are averaged in linear space
+                std::vector<bool> srgbImages(imageCount, false);
+                // Sparse assets may reference textures without a source, or bad indices the materials later ignore
+                auto markSrgb = [&gltfModel, &srgbImages, imageCount](int textureIndex) {
+                    if (textureIndex < 0 || static_cast<size_t>(textureIndex) >= gltfModel.textures.size()) {
+                        return;
+                    }
+                    const int source = textureSource(gltfModel.textures[textureIndex]);
+                    if (source >= 0 && static_cast<size_t>(source) < imageCount) {
+                        srgbImages[source] = true;
+                    }
+                };
+                for (tinygltf::Material &mat : gltfModel.materials) {
+                    auto baseColor = mat.values.find("baseColorTexture");
+                    if (baseColor != mat.values.end()) {
+                        markSrgb(baseColor->second.TextureIndex());
+                    }
+                    auto emissive = mat.additionalValues.find("emissiveTexture");
+                    if (emissive != mat.additionalValues.end()) {
+                        markSrgb(emissive->second.TextureIndex());
+                    }
+                }
+
+                for (size_t i = 0; i < imageCount; i++) {
+                    const tinygltf::Image &image = gltfModel.images[i];
+                    const bool srgb = srgbImages[i];
+                    keys[i] = imageCacheKey(image, path, srgb);
+                    textureHandles[i] = cache.find(keys[i]);
+                    if (textureHandles[i]) {
+                        continue;
+                    }
+                    requests[i] = loader.load([&image, &targets, srgb, this](TextureData &data) {
+                        data.srgb = srgb;
+                        return Texture::decodeglTfImage(data, image, path, targets);
+                    }, image.uri.empty() ? image.name : image.uri);
+                }
+                loader.finish();
+                for (size_t i = 0; i < imageCount; i++) {
+                    if (requests[i] && requests[i]->isResident()) {
+                        textureHandles[i] = cache.insert(keys[i], requests[i]->texture);
+                    }
+                    // Materials of images that failed to load sample the empty texture
+                    textures.push_back(textureHandles[i] ? textureHandles[i].texture() : emptyTexture);
+                }
             }
 
             void GLTFModel::loadMaterials(tinygltf::Model &gltfModel) {
                 for (tinygltf::Material &mat : gltfModel.materials) {
                     vkglTF::Material material(device);
                     if (mat.values.find("baseColorTexture") != mat.values.end()) {
-                        material.baseColorTexture = getTexture(gltfModel.textures[mat.values["baseColorTexture"].TextureIndex()].source);
+                        material.baseColorTexture = getTexture(textureSource(gltfModel.textures[mat.values["baseColorTexture"].TextureIndex()]));
                     }
                     // Metallic roughness workflow
                     if (mat.values.find("metallicRoughnessTexture") != mat.values.end()) {
-                        material.metallicRoughnessTexture = getTexture(gltfModel.textures[mat.values["metallicRoughnessTexture"].TextureIndex()].source);
+                        material.metallicRoughnessTexture = getTexture(textureSource(gltfModel.textures[mat.values["metallicRoughnessTexture"].TextureIndex()]));
                     }
                     if (mat.values.find("roughnessFactor") != mat.values.end()) {
                         material.roughnessFactor = static_cast<float>(mat.values["roughnessFactor"].Factor());
@@ -995,15 +1169,15 @@ namespace Util {
                         material.baseColorFactor = glm::make_vec4(mat.values["baseColorFactor"].ColorFactor().data());
                     }
                     if (mat.additionalValues.find("normalTexture") != mat.additionalValues.end()) {
-                        material.normalTexture = getTexture(gltfModel.textures[mat.additionalValues["normalTexture"].TextureIndex()].source);
+                        material.normalTexture = getTexture(textureSource(gltfModel.textures[mat.additionalValues["normalTexture"].TextureIndex()]));
                     } else {
                         material.normalTexture = &emptyTexture;
                     }
                     if (mat.additionalValues.find("emissiveTexture") != mat.additionalValues.end()) {
-                        material.emissiveTexture = getTexture(gltfModel.textures[mat.additionalValues["emissiveTexture"].TextureIndex()].source);
+                        material.emissiveTexture = getTexture(textureSource(gltfModel.textures[mat.additionalValues["emissiveTexture"].TextureIndex()]));
                     }
                     if (mat.additionalValues.find("occlusionTexture") != mat.additionalValues.end()) {
-                        material.occlusionTexture = getTexture(gltfModel.textures[mat.additionalValues["occlusionTexture"].TextureIndex()].source);
+                        material.occlusionTexture = getTexture(textureSource(gltfModel.textures[mat.additionalValues["occlusionTexture"].TextureIndex()]));
                     }
                     if (mat.additionalValues.find("alphaMode") != mat.additionalValues.end()) {
                         tinygltf::Parameter param = mat.additionalValues["alphaMode"];
@@ -1054,11 +1228,8 @@ namespace Util {
 
                             assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
 
-                            auto *buf = new float[accessor.count];
-                            memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(float));
-                            for (size_t index = 0; index < accessor.count; index++) {
-                                sampler.inputs.push_back(buf[index]);
-                            }
+                            sampler.inputs.resize(accessor.count);
+                            memcpy(sampler.inputs.data(), &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(float));
 
                             for (auto input : sampler.inputs) {
                                 if (input < animation.start) {
@@ -1080,19 +1251,16 @@ namespace Util {
 
                             switch (accessor.type) {
                                 case TINYGLTF_TYPE_VEC3: {
-                                    auto *buf = new glm::vec3[accessor.count];
-                                    memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(glm::vec3));
+                                    std::vector<glm::vec3> buf(accessor.count);
+                                    memcpy(buf.data(), &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(glm::vec3));
                                     for (size_t index = 0; index < accessor.count; index++) {
                                         sampler.outputsVec4.emplace_back(buf[index], 0.0f);
                                     }
                                     break;
                                 }
                                 case TINYGLTF_TYPE_VEC4: {
-                                    auto *buf = new glm::vec4[accessor.count];
-                                    memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(glm::vec4));
-                                    for (size_t index = 0; index < accessor.count; index++) {
-                                        sampler.outputsVec4.push_back(buf[index]);
-                                    }
+                                    sampler.outputsVec4.resize(accessor.count);
+                                    memcpy(sampler.outputsVec4.data(), &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(glm::vec4));
                                     break;
                                 }
                                 default: {
@@ -1127,9 +1295,14 @@ namespace Util {
                         if (!channel.node) {
                             continue;
                         }
+                        if (!animation.samplers[channel.samplerIndex].valid()) {
+                            printf("sampler %d has fewer outputs than keys, skipping channel\n", channel.samplerIndex);
+                            continue;
+                        }
 
                         animation.channels.push_back(channel);
                     }
+                    animation.cursors.assign(animation.channels.size(), 0);
 
                     animations.push_back(animation);
                 }
@@ -1161,6 +1334,7 @@ namespace Util {
                         loadImages(gltfModel, device, transferQueue);
                     }
                     loadMaterials(gltfModel);
+                    nodeLookup.assign(gltfModel.nodes.size(), nullptr);
                     const tinygltf::Scene &scene = gltfModel.scenes[gltfModel.defaultScene > -1 ? gltfModel.defaultScene : 0];
                     for (int i : scene.nodes) {
                         const tinygltf::Node node = gltfModel.nodes[i];
@@ -1170,17 +1344,48 @@ namespace Util {
                         loadAnimations(gltfModel);
                     }
                     loadSkins(gltfModel);
+                    bindPose = sceneGraph.local;
 
+                    uint32_t jointCount = 0;
                     for (auto node : linearNodes) {
                         // Assign skins
                         if (node->skinIndex > -1) {
                             node->skin = skins[node->skinIndex];
                         }
-                        // Initial pose
-                        if (node->mesh) {
-                            node->update();
+                        // Every skinned mesh gets its own palette range, joints are relative to the mesh node
+                        if (node->mesh && node->skin) {
+                            node->mesh->uniformBlock.jointOffset = jointCount;
+                            node->mesh->uniformBlock.jointCount = static_cast<uint32_t>(node->skin->joints.size());
+                            jointCount += node->mesh->uniformBlock.jointCount;
                         }
                     }
+                    assert(framesInFlight > 0 && framesInFlight <= 32);
+                    joints.matrices.assign(jointCount, glm::mat4(1.0f));
+                    joints.pendingFrames.assign(jointCount, 0);
+
+                    // Pre-transformed vertices have lost their skin space
+                    if ((fileLoadingFlags & FileLoadingFlags::ComputeSkinning) && !(fileLoadingFlags & FileLoadingFlags::PreTransformVertices)) {
+                        std::vector<const Mesh *> skinnedMeshes;
+                        for (auto node : linearNodes) {
+                            // Meshes shared by several skinned nodes are skinned once, with the palette range they were given last
+                            if (!node->mesh || !node->skin || node->mesh->uniformBlock.jointCount == 0 ||
+                                std::find(skinnedMeshes.begin(), skinnedMeshes.end(), node->mesh) != skinnedMeshes.end()) {
+                                continue;
+                            }
+                            skinnedMeshes.push_back(node->mesh);
+                        }
+                        for (const Mesh *mesh : skinnedMeshes) {
+                            for (const Primitive *primitive : mesh->primitives) {
+                                if (primitive->vertexCount > 0) {
+                                    skinning.dispatches.push_back({ primitive->firstVertex, primitive->vertexCount, mesh->uniformBlock.jointOffset });
+                                }
+                            }
+                        }
+                    }
+
+                    // Initial pose
+                    updateWorldMatrices();
+                    updateChangedMeshes();
                 }
                 else {
                     // TODO: throw
@@ -1188,6 +1393,14 @@ namespace Util {
                     return;
                 }
 
+                if (fileLoadingFlags & FileLoadingFlags::OptimizeMeshes) {
+                    optimizeMeshes(indexBuffer, vertexBuffer);
+                }
+                // Simplify after optimizing, the vertex fetch remap reorders the vertices the levels index into
+                if (fileLoadingFlags & FileLoadingFlags::GenerateLods) {
+                    generateLods(indexBuffer, vertexBuffer, fileLoadingFlags & FileLoadingFlags::OptimizeMeshes);
+                }
+
                 // Pre-Calculations for requested features
                 if ((fileLoadingFlags & FileLoadingFlags::PreTransformVertices) || (fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors) || (fileLoadingFlags & FileLoadingFlags::FlipY)) {
                     const bool preTransform = fileLoadingFlags & FileLoadingFlags::PreTransformVertices;
@@ -1258,12 +1471,27 @@ namespace Util {
 
                 // Create device local buffers
                 // Vertex buffer
+                // The skinning pass reads it as a storage buffer and copies it into the skinned buffers
+                const VkBufferUsageFlags skinningUsage = skinning.dispatches.empty() ? 0 : VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
                 VK_CHECK_RESULT(device->createBuffer(
-                        static_cast<uint32_t>(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT) | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags,
+                        static_cast<uint32_t>(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT) | VK_BUFFER_USAGE_TRANSFER_DST_BIT | skinningUsage | memoryPropertyFlags,
                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                         vertexBufferSize,
                         &vertices.buffer,
                         &vertices.memory))
+                // Skinned vertex buffers, unskinned vertices are only ever written by the initial copy
+                if (!skinning.dispatches.empty()) {
+                    skinning.buffers.resize(framesInFlight);
+                    skinning.memories.resize(framesInFlight);
+                    for (uint32_t frame = 0; frame < framesInFlight; frame++) {
+                        VK_CHECK_RESULT(device->createBuffer(
+                                static_cast<uint32_t>(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT) | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags,
+                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                vertexBufferSize,
+                                &skinning.buffers[frame],
+                                &skinning.memories[frame]))
+                    }
+                }
                 // Index buffer
                 VK_CHECK_RESULT(device->createBuffer(
                         static_cast<uint32_t>(VK_BUFFER_USAGE_INDEX_BUFFER_BIT) | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags,
@@ -1279,6 +1507,9 @@ namespace Util {
 
                 copyRegion.size = vertexBufferSize;
                 vkCmdCopyBuffer(copyCmd, vertexStaging.buffer, vertices.buffer, 1, &copyRegion);
+                for (VkBuffer buffer : skinning.buffers) {
+                    vkCmdCopyBuffer(copyCmd, vertexStaging.buffer, buffer, 1, &copyRegion);
+                }
 
                 copyRegion.size = indexBufferSize;
                 vkCmdCopyBuffer(copyCmd, indexStaging.buffer, indices.buffer, 1, &copyRegion);
@@ -1291,37 +1522,17 @@ namespace Util {
                 vkFreeMemory(device->getLogicalDevice(), indexStaging.memory, nullptr);
 
                 getSceneDimensions();
-
-                // Setup descriptors
-                uint32_t uboCount{ 0 };
-                uint32_t imageCount{ 0 };
-                for (auto node : linearNodes) {
-                    if (node->mesh) {
-                        uboCount++;
-                    }
-                }
-                for (auto material : materials) {
-                    if (material.baseColorTexture != nullptr) {
-                        imageCount++;
-                    }
-                }
-                std::vector<VkDescriptorPoolSize> poolSizes = {
-                        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uboCount },
-                };
-                if (imageCount > 0) {
-                    if (descriptorBindingFlags & DescriptorBindingFlags::ImageBaseColor) {
-                        poolSizes.push_back({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, imageCount });
-                    }
-                    if (descriptorBindingFlags & DescriptorBindingFlags::ImageNormalMap) {
-                        poolSizes.push_back({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, imageCount });
-                    }
-                }
-                VkDescriptorPoolCreateInfo descriptorPoolCI{};
-                descriptorPoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-                descriptorPoolCI.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-                descriptorPoolCI.pPoolSizes = poolSizes.data();
-                descriptorPoolCI.maxSets = uboCount + imageCount;
-                VK_CHECK_RESULT(vkCreateDescriptorPool(device->getLogicalDevice(), &descriptorPoolCI, nullptr, &descriptorPool))
+                prepareCulling(fileLoadingFlags & FileLoadingFlags::PreTransformVertices, fileLoadingFlags & FileLoadingFlags::FlipY);
+
+                // Setup descriptors, the mesh and material counts only size the first pool
+                const auto jointSetCount = static_cast<uint32_t>(joints.matrices.empty() ? 0 : framesInFlight);
+                const auto skinningSetCount = static_cast<uint32_t>(skinning.buffers.size());
+                descriptorAllocator.init(device->getLogicalDevice(), static_cast<uint32_t>(linearNodes.size() + materials.size()) + jointSetCount + skinningSetCount, {
+                        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f },
+                        // Skinning sets read the source vertices and joints and write the skinned vertices
+                        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1.0f },
+                        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2.0f },
+                });
 
                 // Descriptors for per-node uniform buffers
                 {
@@ -1341,6 +1552,41 @@ namespace Util {
                     }
                 }
 
+                // Joint palette buffers, one per frame in flight
+                if (jointSetCount > 0) {
+                    // Layout is global, so only create if it hasn't already been created before
+                    if (descriptorSetLayoutJoints == VK_NULL_HANDLE) {
+                        VkDescriptorSetLayoutBinding setLayoutBinding = Initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0);
+                        VkDescriptorSetLayoutCreateInfo descriptorLayoutCI{};
+                        descriptorLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+                        descriptorLayoutCI.bindingCount = 1;
+                        descriptorLayoutCI.pBindings = &setLayoutBinding;
+                        VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->getLogicalDevice(), &descriptorLayoutCI, nullptr, &descriptorSetLayoutJoints))
+                    }
+                    joints.buffers.resize(jointSetCount);
+                    joints.descriptorSets.resize(jointSetCount);
+                    for (uint32_t frame = 0; frame < jointSetCount; frame++) {
+                        Buffers &buffer = joints.buffers[frame];
+                        VK_CHECK_RESULT(device->createBuffer(
+                                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                &buffer,
+                                joints.matrices.size() * sizeof(glm::mat4),
+                                joints.matrices.data()))
+                        VK_CHECK_RESULT(buffer.map())
+
+                        VK_CHECK_RESULT(descriptorAllocator.allocate(descriptorSetLayoutJoints, &joints.descriptorSets[frame]))
+                        VkWriteDescriptorSet writeDescriptorSet = Initializers::writeDescriptorSet(joints.descriptorSets[frame], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &buffer.descriptor);
+                        vkUpdateDescriptorSets(device->getLogicalDevice(), 1, &writeDescriptorSet, 0, nullptr);
+                    }
+                    // The initial contents were copied at creation
+                    std::fill(joints.pendingFrames.begin(), joints.pendingFrames.end(), 0);
+                }
+
+                if (skinningSetCount > 0) {
+                    prepareSkinning();
+                }
+
                 // Descriptors for per-material images
                 {
                     // Layout is global, so only create if it hasn't already been created before
@@ -1360,15 +1606,398 @@ namespace Util {
                     }
                     for (auto& material : materials) {
                         if (material.baseColorTexture != nullptr) {
-                            material.createDescriptorSet(descriptorPool, vkglTF::descriptorSetLayoutImage, descriptorBindingFlags);
+                            material.createDescriptorSet(descriptorAllocator, vkglTF::descriptorSetLayoutImage, descriptorBindingFlags);
+                        }
+                    }
+                }
+            }
+
+            void GLTFModel::optimizeMeshes(std::vector<uint32_t> &indexBuffer, std::vector<Vertex> &vertexBuffer) {
+                std::vector<Primitive *> primitives;
+                for (auto node : linearNodes) {
+                    if (node->mesh) {
+                        for (Primitive *primitive : node->mesh->primitives) {
+                            if (primitive->indexCount >= 3 && primitive->vertexCount > 0) {
+                                primitives.push_back(primitive);
+                            }
+                        }
+                    }
+                }
+
+                // Every primitive owns its index and vertex range, so they can be optimized independently
+                ThreadPool::global().parallelFor(primitives.size(), [&](size_t i) {
+                    std::vector<uint32_t> remap;
+                    Primitive *primitive = primitives[i];
+                    uint32_t *indices = &indexBuffer[primitive->firstIndex];
+                    Vertex *vertices = &vertexBuffer[primitive->firstVertex];
+                    const size_t indexCount = primitive->indexCount - primitive->indexCount % 3;
+
+                    // Work on indices relative to the primitive's first vertex
+                    for (size_t j = 0; j < indexCount; j++) {
+                        indices[j] -= primitive->firstVertex;
+                    }
+                    MeshOptimizer::optimizeVertexCache(indices, indexCount, primitive->vertexCount);
+                    MeshOptimizer::optimizeOverdraw(indices, indexCount, &vertices[0].pos.x, primitive->vertexCount, sizeof(Vertex));
+                    MeshOptimizer::buildVertexFetchRemap(remap, indices, indexCount, primitive->vertexCount);
+                    MeshOptimizer::remapIndices(indices, indexCount, remap);
+                    MeshOptimizer::remapVertices(vertices, primitive->vertexCount, remap);
+                    for (size_t j = 0; j < indexCount; j++) {
+                        indices[j] += primitive->firstVertex;
+                    }
+                });
+            }
+
+            void GLTFModel::generateLods(std::vector<uint32_t> &indexBuffer, const std::vector<Vertex> &vertexBuffer, bool optimize) {
+                // Each level aims for half the triangles of the previous one
+                const uint32_t maxLevels = 8;
+                // Stop the chain once a level fails to remove at least 10% of the triangles
+                const float minReduction = 0.9f;
+                // Coarsest allowed deviation relative to the primitive's bounding radius
+                const float maxRelativeError = 0.1f;
+
+                std::vector<Primitive *> primitives;
+                for (auto node : linearNodes) {
+                    if (node->mesh) {
+                        for (Primitive *primitive : node->mesh->primitives) {
+                            if (primitive->indexCount >= 3 && primitive->vertexCount > 0) {
+                                primitives.push_back(primitive);
+                            }
+                        }
+                    }
+                }
+
+                // Simplified indices are built in parallel, per primitive level offsets are relative to its own list
+                std::vector<std::vector<uint32_t>> lodIndices(primitives.size());
+                std::vector<std::vector<Primitive::Lod>> lods(primitives.size());
+                ThreadPool::global().parallelFor(primitives.size(), [&](size_t i) {
+                    const Primitive *primitive = primitives[i];
+                    const size_t indexCount = primitive->indexCount - primitive->indexCount % 3;
+                    std::vector<uint32_t> source(indexBuffer.begin() + primitive->firstIndex, indexBuffer.begin() + primitive->firstIndex + indexCount);
+                    for (uint32_t &index : source) {
+                        index -= primitive->firstVertex;
+                    }
+                    const float *positions = &vertexBuffer[primitive->firstVertex].pos.x;
+                    const float errorLimit = primitive->dimensions.radius * maxRelativeError;
+
+                    std::vector<uint32_t> level(source.size());
+                    float error = 0.0f;
+                    for (uint32_t l = 1; l < maxLevels; l++) {
+                        const size_t targetIndexCount = source.size() / 6 * 3;
+                        if (targetIndexCount == 0 || error >= errorLimit) {
+                            break;
+                        }
+                        float levelError = 0.0f;
+                        // Levels are simplified from the previous one, so each only gets what is left of the limit
+                        const size_t count = MeshOptimizer::simplify(level.data(), source.data(), source.size(), positions, primitive->vertexCount,
+                                                                     sizeof(Vertex), targetIndexCount, errorLimit - error, &levelError);
+                        if (count == 0 || static_cast<float>(count) > static_cast<float>(source.size()) * minReduction) {
+                            break;
+                        }
+                        if (optimize) {
+                            MeshOptimizer::optimizeVertexCache(level.data(), count, primitive->vertexCount);
+                        }
+                        // Quadrics are not carried over between levels, the deviation from level 0 is bounded by the sum
+                        error += levelError;
+                        lods[i].push_back({ static_cast<uint32_t>(lodIndices[i].size()), static_cast<uint32_t>(count), error });
+                        for (size_t j = 0; j < count; j++) {
+                            lodIndices[i].push_back(level[j] + primitive->firstVertex);
                         }
+                        source.assign(level.begin(), level.begin() + count);
+                    }
+                });
+
+                for (size_t i = 0; i < primitives.size(); i++) {
+                    Primitive *primitive = primitives[i];
+                    const auto offset = static_cast<uint32_t>(indexBuffer.size());
+                    primitive->lods.clear();
+                    primitive->lods.push_back({ primitive->firstIndex, primitive->indexCount, 0.0f });
+                    for (Primitive::Lod lod : lods[i]) {
+                        lod.firstIndex += offset;
+                        primitive->lods.push_back(lod);
+                    }
+                    indexBuffer.insert(indexBuffer.end(), lodIndices[i].begin(), lodIndices[i].end());
+                }
+            }
+
+            void GLTFModel::setLodCamera(const Camera &camera, float viewportHeight, float pixelThreshold) {
+                lodSelection.enabled = true;
+                lodSelection.view = camera.matrices.view;
+                // perspective[1][1] is cot(fov / 2), half the viewport spans a height of 1 / cot(fov / 2) at distance 1
+                lodSelection.projectionScale = std::abs(camera.matrices.perspective[1][1]) * 0.5f * viewportHeight;
+                lodSelection.pixelThreshold = pixelThreshold;
+            }
+
+            const Primitive::Lod *GLTFModel::selectLod(const Node *node, const Primitive *primitive) const {
+                if (primitive->lods.empty()) {
+                    return nullptr;
+                }
+                if (!lodSelection.enabled) {
+                    return &primitive->lods.front();
+                }
+                // Dimensions predate FlipY and PreTransformVertices, measure them where the draw puts them like culling does
+                const glm::mat4 world = primitive->boundsIndex < culling.entries.size() ? getEntryMatrix(primitive->boundsIndex) : node->getMatrix();
+                const float scale = std::max(glm::length(glm::vec3(world[0])), std::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+                const glm::vec3 center = glm::vec3(lodSelection.view * world * glm::vec4(primitive->dimensions.center, 1.0f));
+                // Use the closest point of the bounding sphere, a camera inside it always gets full detail
+                const float distance = glm::length(center) - primitive->dimensions.radius * scale;
+                if (distance <= 0.0f) {
+                    return &primitive->lods.front();
+                }
+                const float pixelsPerUnit = lodSelection.projectionScale * scale / distance;
+                // Levels are ordered by increasing error, pick the coarsest one that stays below the threshold
+                const Primitive::Lod *selected = &primitive->lods.front();
+                for (const Primitive::Lod &lod : primitive->lods) {
+                    if (lod.error * pixelsPerUnit > lodSelection.pixelThreshold) {
+                        break;
+                    }
+                    selected = &lod;
+                }
+                return selected;
+            }
+
+            void GLTFModel::prepareCulling(bool preTransformed, bool flipY) {
+                culling.entries.clear();
+                for (Node *node : linearNodes) {
+                    if (!node->mesh) {
+                        continue;
+                    }
+                    for (Primitive *primitive : node->mesh->primitives) {
+                        primitive->boundsIndex = static_cast<uint32_t>(culling.entries.size());
+                        culling.entries.emplace_back(node, primitive);
+                    }
+                }
+                culling.bounds.resize(culling.entries.size());
+                culling.visible.assign(culling.entries.size(), 1);
+                culling.visibleCount = culling.entries.size();
+                // Primitive dimensions come from the accessors, before the vertices were flipped or pre-transformed
+                culling.vertexTransform = flipY ? glm::scale(glm::mat4(1.0f), glm::vec3(1.0f, -1.0f, 1.0f)) : glm::mat4(1.0f);
+                culling.preTransformed = preTransformed;
+                buildBvh();
+            }
+
+            bool GLTFModel::updateEntryBounds(size_t entry) {
+                const Node *node = culling.entries[entry].first;
+                const Primitive *primitive = culling.entries[entry].second;
+                if (node->skin || primitive->dimensions.min.x > primitive->dimensions.max.x) {
+                    culling.bounds.setUnbounded(entry);
+                    return false;
+                }
+                culling.bounds.set(entry, getEntryMatrix(entry), primitive->dimensions.center, primitive->dimensions.size * 0.5f);
+                return true;
+            }
+
+            glm::mat4 GLTFModel::getEntryMatrix(size_t entry) const {
+                const Node *node = culling.entries[entry].first;
+                // Pre-transformed vertices were flipped after the node transform, the others before it
+                return culling.preTransformed ? culling.vertexTransform * node->getMatrix()
+                                              : node->getMatrix() * culling.vertexTransform;
+            }
+
+            void GLTFModel::buildBvh() {
+                // Animated nodes move their whole subtree, parents come before their children in the scene graph
+                std::vector<uint8_t> animated(sceneGraph.size(), 0);
+                for (const Animation &animation : animations) {
+                    for (const AnimationChannel &channel : animation.channels) {
+                        animated[channel.node->id] = 1;
+                    }
+                }
+                for (size_t i = 0; i < sceneGraph.size(); i++) {
+                    if (sceneGraph.parents[i] >= 0 && animated[sceneGraph.parents[i]]) {
+                        animated[i] = 1;
+                    }
+                }
+
+                culling.staticEntries.clear();
+                culling.unboundedEntries.clear();
+                culling.proxies.assign(culling.entries.size(), DynamicBVH::nullNode);
+                culling.dynamicTree.clear();
+                culling.dynamicTree.setMargin(dimensions.radius * 0.01f);
+                std::vector<Aabb> staticBounds;
+                for (size_t i = 0; i < culling.entries.size(); i++) {
+                    const auto entry = static_cast<uint32_t>(i);
+                    if (!updateEntryBounds(i)) {
+                        culling.unboundedEntries.push_back(entry);
+                        continue;
+                    }
+                    const Aabb bounds = Aabb::fromCenterExtent({ culling.bounds.centerX[i], culling.bounds.centerY[i], culling.bounds.centerZ[i] },
+                                                               { culling.bounds.extentX[i], culling.bounds.extentY[i], culling.bounds.extentZ[i] });
+                    if (animated[culling.entries[i].first->id]) {
+                        culling.proxies[i] = culling.dynamicTree.insert(bounds, entry);
+                    } else {
+                        culling.staticEntries.push_back(entry);
+                        staticBounds.push_back(bounds);
+                    }
+                }
+                culling.staticTree.build(staticBounds.data(), static_cast<uint32_t>(staticBounds.size()));
+            }
+
+            void GLTFModel::updateBvh() {
+                for (size_t i = 0; i < culling.entries.size(); i++) {
+                    if (culling.proxies[i] == DynamicBVH::nullNode) {
+                        continue;
+                    }
+                    updateEntryBounds(i);
+                    culling.dynamicTree.move(culling.proxies[i], Aabb::fromCenterExtent(
+                            { culling.bounds.centerX[i], culling.bounds.centerY[i], culling.bounds.centerZ[i] },
+                            { culling.bounds.extentX[i], culling.bounds.extentY[i], culling.bounds.extentZ[i] }));
+                }
+            }
+
+            void GLTFModel::setCullingFrustum(const Frustum &frustum) {
+                culling.enabled = true;
+                culling.frustum = frustum;
+                if (!culling.hierarchical) {
+                    for (size_t i = 0; i < culling.entries.size(); i++) {
+                        updateEntryBounds(i);
+                    }
+                    culling.visibleCount = culling.frustum.cullBoxes(culling.bounds, culling.visible.data());
+                    return;
+                }
+                updateBvh();
+                std::fill(culling.visible.begin(), culling.visible.end(), 0);
+                culling.visibleCount = 0;
+                // Tree leaves can hold several entries, each one is tested on its own
+                auto visit = [this](uint32_t entry) {
+                    const glm::vec3 center(culling.bounds.centerX[entry], culling.bounds.centerY[entry], culling.bounds.centerZ[entry]);
+                    const glm::vec3 extent(culling.bounds.extentX[entry], culling.bounds.extentY[entry], culling.bounds.extentZ[entry]);
+                    if (!culling.visible[entry] && culling.frustum.intersectsBox(center, extent)) {
+                        culling.visible[entry] = 1;
+                        culling.visibleCount++;
+                    }
+                };
+                culling.staticTree.queryFrustum(culling.frustum, [&](uint32_t item) { visit(culling.staticEntries[item]); });
+                culling.dynamicTree.queryFrustum(culling.frustum, visit);
+                for (uint32_t entry : culling.unboundedEntries) {
+                    culling.visible[entry] = 1;
+                }
+                culling.visibleCount += culling.unboundedEntries.size();
+            }
+
+            void GLTFModel::queryFrustum(const Frustum &frustum, std::vector<uint32_t> &entries) const {
+                auto visit = [&](uint32_t entry) {
+                    const glm::vec3 center(culling.bounds.centerX[entry], culling.bounds.centerY[entry], culling.bounds.centerZ[entry]);
+                    const glm::vec3 extent(culling.bounds.extentX[entry], culling.bounds.extentY[entry], culling.bounds.extentZ[entry]);
+                    if (frustum.intersectsBox(center, extent)) {
+                        entries.push_back(entry);
+                    }
+                };
+                culling.staticTree.queryFrustum(frustum, [&](uint32_t item) { visit(culling.staticEntries[item]); });
+                culling.dynamicTree.queryFrustum(frustum, visit);
+                entries.insert(entries.end(), culling.unboundedEntries.begin(), culling.unboundedEntries.end());
+            }
+
+            void GLTFModel::querySphere(const glm::vec3 &center, float radius, std::vector<uint32_t> &entries) const {
+                auto visit = [&](uint32_t entry) {
+                    const glm::vec3 entryCenter(culling.bounds.centerX[entry], culling.bounds.centerY[entry], culling.bounds.centerZ[entry]);
+                    const glm::vec3 extent(culling.bounds.extentX[entry], culling.bounds.extentY[entry], culling.bounds.extentZ[entry]);
+                    if (Aabb::fromCenterExtent(entryCenter, extent).intersectsSphere(center, radius)) {
+                        entries.push_back(entry);
+                    }
+                };
+                culling.staticTree.querySphere(center, radius, [&](uint32_t item) { visit(culling.staticEntries[item]); });
+                culling.dynamicTree.querySphere(center, radius, visit);
+                entries.insert(entries.end(), culling.unboundedEntries.begin(), culling.unboundedEntries.end());
+            }
+
+            bool GLTFModel::raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, RayHit &hit) const {
+                const glm::vec3 inverseDirection = 1.0f / direction;
+                bool found = false;
+                auto test = [&](uint32_t entry, float distance) {
+                    const glm::vec3 center(culling.bounds.centerX[entry], culling.bounds.centerY[entry], culling.bounds.centerZ[entry]);
+                    const glm::vec3 extent(culling.bounds.extentX[entry], culling.bounds.extentY[entry], culling.bounds.extentZ[entry]);
+                    const float entryDistance = Aabb::fromCenterExtent(center, extent).intersectRay(origin, inverseDirection, distance);
+                    if (entryDistance < 0.0f) {
+                        return distance;
                     }
+                    hit = { entry, entryDistance };
+                    found = true;
+                    return entryDistance;
+                };
+                culling.staticTree.queryRay(origin, direction, maxDistance, [&](uint32_t item, float distance) {
+                    return test(culling.staticEntries[item], distance);
+                });
+                culling.dynamicTree.queryRay(origin, direction, found ? hit.distance : maxDistance, test);
+                return found;
+            }
+
+            void GLTFModel::setCullingCamera(const Camera &camera) {
+                setCullingFrustum(Frustum::fromCamera(camera));
+            }
+
+            bool GLTFModel::isVisible(const Primitive *primitive) const {
+                return !culling.enabled || primitive->boundsIndex >= culling.visible.size() || culling.visible[primitive->boundsIndex];
+            }
+
+            void GLTFModel::prepareSkinning() {
+                VkDevice logicalDevice = device->getLogicalDevice();
+                std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+                        Initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+                        Initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+                        Initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+                };
+                VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = Initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+                VK_CHECK_RESULT(vkCreateDescriptorSetLayout(logicalDevice, &descriptorLayoutCI, nullptr, &skinning.descriptorSetLayout))
+
+                VkPushConstantRange pushConstantRange = Initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(SkinningPass::Dispatch), 0);
+                VkPipelineLayoutCreateInfo pipelineLayoutCI = Initializers::pipelineLayoutCreateInfo(&skinning.descriptorSetLayout, 1);
+                pipelineLayoutCI.pushConstantRangeCount = 1;
+                pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+                VK_CHECK_RESULT(vkCreatePipelineLayout(logicalDevice, &pipelineLayoutCI, nullptr, &skinning.pipelineLayout))
+
+                VkComputePipelineCreateInfo pipelineCI = Initializers::computePipelineCreateInfo(skinning.pipelineLayout);
+                pipelineCI.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+                pipelineCI.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+                pipelineCI.stage.module = tools::loadShader(skinningShaderPath.c_str(), logicalDevice);
+                pipelineCI.stage.pName = "main";
+                assert(pipelineCI.stage.module != VK_NULL_HANDLE);
+                VK_CHECK_RESULT(vkCreateComputePipelines(logicalDevice, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &skinning.pipeline))
+                vkDestroyShaderModule(logicalDevice, pipelineCI.stage.module, nullptr);
+
+                VkDescriptorBufferInfo sourceInfo{ vertices.buffer, 0, VK_WHOLE_SIZE };
+                skinning.descriptorSets.resize(skinning.buffers.size());
+                for (size_t frame = 0; frame < skinning.buffers.size(); frame++) {
+                    VK_CHECK_RESULT(descriptorAllocator.allocate(skinning.descriptorSetLayout, &skinning.descriptorSets[frame]))
+                    VkDescriptorBufferInfo skinnedInfo{ skinning.buffers[frame], 0, VK_WHOLE_SIZE };
+                    std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+                            Initializers::writeDescriptorSet(skinning.descriptorSets[frame], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &sourceInfo),
+                            Initializers::writeDescriptorSet(skinning.descriptorSets[frame], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &skinnedInfo),
+                            Initializers::writeDescriptorSet(skinning.descriptorSets[frame], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &joints.buffers[frame].descriptor),
+                    };
+                    vkUpdateDescriptorSets(logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
                 }
             }
 
-            void GLTFModel::bindBuffers(VkCommandBuffer commandBuffer) {
+            void GLTFModel::recordSkinning(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+                if (skinning.pipeline == VK_NULL_HANDLE) {
+                    return;
+                }
+                // Earlier draws of this frame's buffer must be done reading it before it is overwritten
+                vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, skinning.pipeline);
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, skinning.pipelineLayout, 0, 1, &skinning.descriptorSets[frameIndex], 0, nullptr);
+                for (const SkinningPass::Dispatch &dispatch : skinning.dispatches) {
+                    vkCmdPushConstants(commandBuffer, skinning.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(SkinningPass::Dispatch), &dispatch);
+                    vkCmdDispatch(commandBuffer, (dispatch.vertexCount + 63) / 64, 1, 1);
+                }
+
+                VkBufferMemoryBarrier barrier = Initializers::bufferMemoryBarrier();
+                barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+                barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+                barrier.buffer = skinning.buffers[frameIndex];
+                barrier.offset = 0;
+                barrier.size = VK_WHOLE_SIZE;
+                vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+            }
+
+            VkBuffer GLTFModel::getVertexBuffer(uint32_t frameIndex) const {
+                return skinning.buffers.empty() ? vertices.buffer : skinning.buffers[frameIndex];
+            }
+
+            void GLTFModel::bindBuffers(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
                 const VkDeviceSize offsets[1] = {0};
-                vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
+                const VkBuffer vertexBuffer = getVertexBuffer(frameIndex);
+                vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, offsets);
                 vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
                 buffersBound = true;
             }
@@ -1376,6 +2005,9 @@ namespace Util {
             void GLTFModel::drawNode(Node *node, VkCommandBuffer commandBuffer, uint32_t renderFlags,
                                      VkPipelineLayout pipelineLayout, uint32_t bindImageSet) {
                 if (node->mesh) {
+                    if (renderFlags & RenderFlags::PushMeshMatrix) {
+                        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, Mesh::pushConstantSize, &node->mesh->uniformBlock);
+                    }
                     for (Primitive* primitive : node->mesh->primitives) {
                         bool skip = false;
                         const vkglTF::Material& material = primitive->material;
@@ -1388,24 +2020,33 @@ namespace Util {
                         if (renderFlags & RenderFlags::RenderAlphaBlendedNodes) {
                             skip = (material.alphaMode != Material::ALPHAMODE_BLEND);
                         }
-                        if (!skip) {
-                            if (renderFlags & RenderFlags::BindImages) {
+                        if (!skip && isVisible(primitive)) {
+                            if (renderFlags & RenderFlags::PushMaterialIndex) {
+                                vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                                                   materialIndexPushOffset, sizeof(uint32_t), &material.bindlessIndex);
+                            } else if (renderFlags & RenderFlags::BindImages) {
                                 vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &material.descriptorSet, 0, nullptr);
                             }
-                            vkCmdDrawIndexed(commandBuffer, primitive->indexCount, 1, primitive->firstIndex, 0, 0);
+                            const Primitive::Lod *lod = selectLod(node, primitive);
+                            if (lod) {
+                                vkCmdDrawIndexed(commandBuffer, lod->indexCount, 1, lod->firstIndex, 0, 0);
+                            } else {
+                                vkCmdDrawIndexed(commandBuffer, primitive->indexCount, 1, primitive->firstIndex, 0, 0);
+                            }
                         }
                     }
                 }
                 for (auto& child : node->children) {
-                    drawNode(child, commandBuffer, renderFlags);
+                    drawNode(child, commandBuffer, renderFlags, pipelineLayout, bindImageSet);
                 }
             }
 
             void GLTFModel::draw(VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout,
-                                 uint32_t bindImageSet) {
+                                 uint32_t bindImageSet, uint32_t frameIndex) {
                 if (!buffersBound) {
                     const VkDeviceSize offsets[1] = {0};
-                    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
+                    const VkBuffer vertexBuffer = getVertexBuffer(frameIndex);
+                    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, offsets);
                     vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
                 }
                 for (auto& node : nodes) {
@@ -1413,11 +2054,51 @@ namespace Util {
                 }
             }
 
+            void GLTFModel::drawNodeInstanced(const Node *node, VkCommandBuffer commandBuffer, uint32_t instanceCount, uint32_t renderFlags,
+                                              VkPipelineLayout pipelineLayout, uint32_t bindImageSet) {
+                if (node->mesh) {
+                    if (renderFlags & RenderFlags::PushMeshMatrix) {
+                        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, Mesh::pushConstantSize, &node->mesh->uniformBlock);
+                    }
+                    for (const Primitive *primitive : node->mesh->primitives) {
+                        const vkglTF::Material &material = primitive->material;
+                        if (((renderFlags & RenderFlags::RenderOpaqueNodes) && material.alphaMode != Material::ALPHAMODE_OPAQUE) ||
+                            ((renderFlags & RenderFlags::RenderAlphaMaskedNodes) && material.alphaMode != Material::ALPHAMODE_MASK) ||
+                            ((renderFlags & RenderFlags::RenderAlphaBlendedNodes) && material.alphaMode != Material::ALPHAMODE_BLEND)) {
+                            continue;
+                        }
+                        if (renderFlags & RenderFlags::BindImages) {
+                            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &material.descriptorSet, 0, nullptr);
+                        }
+                        // Level 0 of the LOD chain is the primitive's own index range
+                        vkCmdDrawIndexed(commandBuffer, primitive->indexCount, instanceCount, primitive->firstIndex, 0, 0);
+                    }
+                }
+                for (const Node *child : node->children) {
+                    drawNodeInstanced(child, commandBuffer, instanceCount, renderFlags, pipelineLayout, bindImageSet);
+                }
+            }
+
+            void GLTFModel::drawInstanced(VkCommandBuffer commandBuffer, VkBuffer instanceBuffer, uint32_t instanceCount, uint32_t renderFlags,
+                                          VkPipelineLayout pipelineLayout, uint32_t bindImageSet, uint32_t frameIndex) {
+                if (instanceCount == 0) {
+                    return;
+                }
+                const VkBuffer vertexBuffers[2] = { getVertexBuffer(frameIndex), instanceBuffer };
+                const VkDeviceSize offsets[2] = { 0, 0 };
+                vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+                vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+                for (const Node *node : nodes) {
+                    drawNodeInstanced(node, commandBuffer, instanceCount, renderFlags, pipelineLayout, bindImageSet);
+                }
+            }
+
             void GLTFModel::getNodeDimensions(Node *node, glm::vec3 &min, glm::vec3 &max) {
                 if (node->mesh) {
+                    const glm::mat4 &matrix = node->getMatrix();
                     for (Primitive *primitive : node->mesh->primitives) {
-                        glm::vec4 locMin = glm::vec4(primitive->dimensions.min, 1.0f) * node->getMatrix();
-                        glm::vec4 locMax = glm::vec4(primitive->dimensions.max, 1.0f) * node->getMatrix();
+                        glm::vec4 locMin = glm::vec4(primitive->dimensions.min, 1.0f) * matrix;
+                        glm::vec4 locMax = glm::vec4(primitive->dimensions.max, 1.0f) * matrix;
                         if (locMin.x < min.x) { min.x = locMin.x; }
                         if (locMin.y < min.y) { min.y = locMin.y; }
                         if (locMin.z < min.z) { min.z = locMin.z; }
@@ -1449,88 +2130,107 @@ namespace Util {
                 }
                 Animation &animation = animations[index];
 
-                bool updated = false;
-                for (auto& channel : animation.channels) {
-                    vkglTF::AnimationSampler &sampler = animation.samplers[channel.samplerIndex];
-                    if (sampler.inputs.size() > sampler.outputsVec4.size()) {
-                        continue;
+                if (animation.channels.empty()) {
+                    return;
+                }
+                channelValues.resize(animation.channels.size());
+                animation.evaluate(time, animation.cursors.data(), channelValues.data());
+                for (size_t i = 0; i < animation.channels.size(); i++) {
+                    const AnimationChannel &channel = animation.channels[i];
+                    const glm::vec4 &value = channelValues[i];
+                    switch (channel.path) {
+                        case vkglTF::AnimationChannel::PathType::TRANSLATION:
+                            channel.node->setTranslation(glm::vec3(value));
+                            break;
+                        case vkglTF::AnimationChannel::PathType::SCALE:
+                            channel.node->setScale(glm::vec3(value));
+                            break;
+                        case vkglTF::AnimationChannel::PathType::ROTATION:
+                            channel.node->setRotation(glm::quat(value.w, value.x, value.y, value.z));
+                            break;
                     }
+                }
+                // Joints can live in other subtrees, so all world matrices must be current before uploading
+                updateWorldMatrices();
+                updateChangedMeshes();
+            }
 
-                    for (auto i = 0; i < sampler.inputs.size() - 1; i++) {
-                        if ((time >= sampler.inputs[i]) && (time <= sampler.inputs[i + 1])) {
-                            float u = std::max(0.0f, time - sampler.inputs[i]) / (sampler.inputs[i + 1] - sampler.inputs[i]);
-                            if (u <= 1.0f) {
-                                switch (channel.path) {
-                                    case vkglTF::AnimationChannel::PathType::TRANSLATION: {
-                                        glm::vec4 trans = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u);
-                                        channel.node->translation = glm::vec3(trans);
-                                        break;
-                                    }
-                                    case vkglTF::AnimationChannel::PathType::SCALE: {
-                                        glm::vec4 trans = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u);
-                                        channel.node->scale = glm::vec3(trans);
-                                        break;
-                                    }
-                                    case vkglTF::AnimationChannel::PathType::ROTATION: {
-                                        glm::quat q1;
-                                        q1.x = sampler.outputsVec4[i].x;
-                                        q1.y = sampler.outputsVec4[i].y;
-                                        q1.z = sampler.outputsVec4[i].z;
-                                        q1.w = sampler.outputsVec4[i].w;
-                                        glm::quat q2;
-                                        q2.x = sampler.outputsVec4[i + 1].x;
-                                        q2.y = sampler.outputsVec4[i + 1].y;
-                                        q2.z = sampler.outputsVec4[i + 1].z;
-                                        q2.w = sampler.outputsVec4[i + 1].w;
-                                        channel.node->rotation = glm::normalize(glm::slerp(q1, q2, u));
-                                        break;
-                                    }
-                                }
-                                updated = true;
-                            }
-                        }
+            void GLTFModel::updateChangedMeshes() {
+                const uint32_t allFrames = framesInFlight >= 32 ? UINT32_MAX : (1u << framesInFlight) - 1;
+                for (Node *node : sceneGraph.nodes) {
+                    if (!node->mesh) {
+                        continue;
                     }
-                }
-                if (updated) {
-                    for (auto &node : nodes) {
+                    const bool nodeChanged = sceneGraph.changed[node->id];
+                    if (nodeChanged) {
                         node->update();
                     }
+                    if (!node->skin) {
+                        continue;
+                    }
+                    // Only joints that moved, or all of them if the mesh node itself moved
+                    const Mesh::UniformBlock &block = node->mesh->uniformBlock;
+                    const glm::mat4 inverseTransform = glm::inverse(node->getMatrix());
+                    for (uint32_t i = 0; i < block.jointCount; i++) {
+                        const Node *joint = node->skin->joints[i];
+                        if (nodeChanged || sceneGraph.changed[joint->id]) {
+                            joints.matrices[block.jointOffset + i] = inverseTransform * joint->getMatrix() * node->skin->inverseBindMatrices[i];
+                            joints.pendingFrames[block.jointOffset + i] = allFrames;
+                        }
+                    }
+                }
+                // A single palette buffer has no frame to wait for
+                if (framesInFlight == 1) {
+                    uploadJoints(0);
                 }
             }
 
-            Node *GLTFModel::findNode(Node *parent, uint32_t index) {
-                Node* nodeFound = nullptr;
-                if (parent->index == index) {
-                    return parent;
+            void GLTFModel::uploadJoints(uint32_t frameIndex) {
+                if (frameIndex >= joints.buffers.size()) {
+                    return;
                 }
-                for (auto& child : parent->children) {
-                    nodeFound = findNode(child, index);
-                    if (nodeFound) {
-                        break;
+                const uint32_t frameBit = 1u << frameIndex;
+                auto *mapped = static_cast<glm::mat4 *>(joints.buffers[frameIndex].mapped);
+                const size_t count = joints.matrices.size();
+                // Copy runs of consecutive pending matrices
+                for (size_t i = 0; i < count;) {
+                    if (!(joints.pendingFrames[i] & frameBit)) {
+                        i++;
+                        continue;
+                    }
+                    size_t end = i;
+                    while (end < count && (joints.pendingFrames[end] & frameBit)) {
+                        joints.pendingFrames[end] &= ~frameBit;
+                        end++;
                     }
+                    memcpy(mapped + i, &joints.matrices[i], (end - i) * sizeof(glm::mat4));
+                    i = end;
                 }
-                return nodeFound;
             }
 
-            Node *GLTFModel::nodeFromIndex(uint32_t index) {
-                Node* nodeFound = nullptr;
-                for (auto &node : nodes) {
-                    nodeFound = findNode(node, index);
-                    if (nodeFound) {
-                        break;
+            Node *GLTFModel::findNode(Node *parent, uint32_t index) {
+                // Look the node up directly and check that it lives below parent
+                Node *node = nodeFromIndex(index);
+                for (Node *ancestor = node; ancestor; ancestor = ancestor->parent) {
+                    if (ancestor == parent) {
+                        return node;
                     }
                 }
-                return nodeFound;
+                return nullptr;
+            }
+
+            Node *GLTFModel::nodeFromIndex(uint32_t index) {
+                return index < nodeLookup.size() ? nodeLookup[index] : nullptr;
+            }
+
+            Node *GLTFModel::nodeFromName(const std::string &name) {
+                auto it = nodeNameLookup.find(name);
+                return it != nodeNameLookup.end() ? it->second : nullptr;
             }
 
             void GLTFModel::prepareNodeDescriptor(vkglTF::Node *node, VkDescriptorSetLayout descriptorSetLayout) {
                 if (node->mesh) {
-                    VkDescriptorSetAllocateInfo descriptorSetAllocInfo{};
-                    descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-                    descriptorSetAllocInfo.descriptorPool = descriptorPool;
-                    descriptorSetAllocInfo.pSetLayouts = &descriptorSetLayout;
-                    descriptorSetAllocInfo.descriptorSetCount = 1;
-                    VK_CHECK_RESULT(vkAllocateDescriptorSets(device->getLogicalDevice(), &descriptorSetAllocInfo, &node->mesh->uniformBuffer.descriptorSet))
+                    VK_CHECK_RESULT(descriptorAllocator.allocate(descriptorSetLayout, &node->mesh->uniformBuffer.descriptorSet))
 
                     VkWriteDescriptorSet writeDescriptorSet{};
                     writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
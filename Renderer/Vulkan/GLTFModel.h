@@ -8,8 +8,12 @@
 #include <string>
 #include <fstream>
 #include <vector>
+#include <unordered_map>
 
 #include "../VulkanUtil.h"
+#include "../BVH.h"
+#include "DescriptorAllocator.h"
+#include "TextureCache.h"
 
 #include <ktx.h>
 #include <ktxvulkan.h>
@@ -25,6 +29,8 @@
 
 namespace Util {
     namespace Renderer {
+        class MipGenerator;
+
         namespace vkglTF {
             enum DescriptorBindingFlags {
                 ImageBaseColor = 0x00000001,
@@ -33,10 +39,14 @@ namespace Util {
 
             extern VkDescriptorSetLayout descriptorSetLayoutImage;
             extern VkDescriptorSetLayout descriptorSetLayoutUbo;
+            extern VkDescriptorSetLayout descriptorSetLayoutJoints;
             extern VkMemoryPropertyFlags memoryPropertyFlags;
             extern uint32_t descriptorBindingFlags;
 
             struct Node;
+            struct SceneGraph;
+            struct TextureData;
+            struct TranscodeTargets;
 
             /*
                 glTF texture loading class
@@ -57,8 +67,32 @@ namespace Util {
 
                 void destroy() const;
 
-                void fromglTfImage(tinygltf::Image &gltfimage, const std::string& path, Device *pDevice,
-                                   VkQueue copyQueue);
+                /** @return False if the image could not be decoded, the texture is left uncreated */
+                [[nodiscard]] bool fromglTfImage(tinygltf::Image &gltfimage, const std::string& path, Device *pDevice,
+                                                 VkQueue copyQueue);
+
+                /**
+                * Creates and uploads a decoded texture, waits for the copy queue
+                *
+                * @note data is prepared for pDevice first, see TextureData::prepareUpload
+                * @param mipGenerator Generates the missing levels if it supports the format, reset by the caller
+                */
+                void fromTextureData(TextureData &data, Device *pDevice, VkQueue copyQueue, MipGenerator *mipGenerator = nullptr);
+
+                /**
+                * Creates the image, view and sampler for data, the contents are undefined until recordUpload executed
+                *
+                * @note Pass the MipGenerator recordUpload will use, images it generates need storage usage
+                */
+                void create(const TextureData &data, Device *pDevice, const MipGenerator *mipGenerator = nullptr);
+
+                /** @brief Records the copy of data's pixels from offset in staging, the generated mip levels and the transition to shader reads */
+                void recordUpload(VkCommandBuffer commandBuffer, VkBuffer staging, VkDeviceSize offset, const TextureData &data,
+                                  MipGenerator *mipGenerator = nullptr);
+
+                /** @brief Decodes a glTF image, safe to call from worker threads, KTX2 images are transcoded to one of targets */
+                static bool decodeglTfImage(TextureData &data, const tinygltf::Image &gltfimage, const std::string &path,
+                                            const TranscodeTargets &targets);
             };
 
             /*
@@ -84,10 +118,12 @@ namespace Util {
                 vkglTF::Texture *diffuseTexture;
 
                 VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+                // Index in a BindlessMaterials set, UINT32_MAX while the material isn't part of one
+                uint32_t bindlessIndex = UINT32_MAX;
 
                 explicit Material(Device *_device);
 
-                void createDescriptorSet(VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout,
+                void createDescriptorSet(DescriptorAllocator &descriptorAllocator, VkDescriptorSetLayout descriptorSetLayout,
                                          uint32_t descriptorBindingFlags);
             };
 
@@ -109,6 +145,19 @@ namespace Util {
                     float radius;
                 } dimensions;
 
+                /*
+                    Simplified index ranges into the model's index buffer, sharing this primitive's vertices
+                    Level 0 is the full resolution range, the error of each level is the deviation from it in object space
+                */
+                struct Lod {
+                    uint32_t firstIndex;
+                    uint32_t indexCount;
+                    float error;
+                };
+                std::vector<Lod> lods;
+                // Entry of the model's culling bounds
+                uint32_t boundsIndex;
+
                 void setDimensions(glm::vec3 min, glm::vec3 max);
 
                 Primitive(uint32_t firstIndex, uint32_t indexCount, Material &_material);
@@ -131,12 +180,17 @@ namespace Util {
                     void *mapped;
                 } uniformBuffer;
 
+                // Joint matrices of skinned meshes live in the model's joint palette at [jointOffset, jointOffset + jointCount)
                 struct UniformBlock {
                     glm::mat4 matrix;
-                    glm::mat4 jointMatrix[64]{};
-                    float jointcount{0};
+                    uint32_t jointOffset{0};
+                    uint32_t jointCount{0};
+                    uint32_t padding[2]{};
                 } uniformBlock;
 
+                // Leading matrix and jointOffset of the uniform block, the push constants of shaders/skinnedmodel.vert
+                static constexpr uint32_t pushConstantSize = sizeof(glm::mat4) + sizeof(uint32_t);
+
                 Mesh(Device *device, glm::mat4 matrix);
 
                 ~Mesh();
@@ -159,24 +213,85 @@ namespace Util {
                 Node *parent;
                 uint32_t index;
                 std::vector<Node *> children;
-                glm::mat4 matrix;
                 std::string name;
                 Mesh *mesh;
                 Skin *skin;
                 int32_t skinIndex = -1;
-                glm::vec3 translation{};
-                glm::vec3 scale{1.0f};
-                glm::quat rotation{};
+                // Transforms are stored in the model's flattened scene graph at position id
+                SceneGraph *graph = nullptr;
+                uint32_t id = 0;
+
+                [[nodiscard]] const glm::vec3 &getTranslation() const;
+
+                [[nodiscard]] const glm::quat &getRotation() const;
+
+                [[nodiscard]] const glm::vec3 &getScale() const;
+
+                void setTranslation(const glm::vec3 &translation);
+
+                void setRotation(const glm::quat &rotation);
+
+                void setScale(const glm::vec3 &scale);
+
+                void setMatrix(const glm::mat4 &matrix);
 
                 [[nodiscard]] glm::mat4 localMatrix() const;
 
-                [[nodiscard]] glm::mat4 getMatrix() const;
+                /** @brief Returns the world matrix computed by the last SceneGraph::updateWorldMatrices() */
+                [[nodiscard]] const glm::mat4 &getMatrix() const;
+
+                void markDirty();
 
+                /** @brief Uploads the mesh matrix and joint matrices of this node, children are not visited */
                 void update();
 
                 ~Node();
             };
 
+            /*
+                Local transforms of all nodes of a model, indexed by scene graph id
+            */
+            struct Pose {
+                std::vector<glm::vec3> translations;
+                std::vector<glm::quat> rotations;
+                std::vector<glm::vec3> scales;
+            };
+
+            /*
+                Flattened scene graph storage
+                Nodes are stored in topological order (parents before children), so world matrices are
+                updated with one linear sweep instead of a recursive walk over the node tree
+            */
+            struct SceneGraph {
+                std::vector<int32_t> parents;
+                Pose local;
+                std::vector<glm::mat4> matrices;
+                std::vector<glm::mat4> worldMatrices;
+                std::vector<int32_t> meshIndices;
+                std::vector<int32_t> skinIndices;
+                std::vector<uint8_t> dirty;
+                // Nodes whose world matrix was recomputed by the last sweep
+                std::vector<uint8_t> changed;
+                std::vector<Node *> nodes;
+
+                /** @brief Appends a node, its parent (-1 for roots) must already be stored */
+                uint32_t add(Node *node, int32_t parent, int32_t meshIndex, int32_t skinIndex);
+
+                [[nodiscard]] size_t size() const { return nodes.size(); }
+
+                [[nodiscard]] glm::mat4 localMatrix(const Pose &pose, uint32_t id) const;
+
+                /**
+                * Recomputes the world matrices of dirty nodes and their descendants for any pose of this graph
+                *
+                * @param rootMatrix Transform applied above the root nodes
+                */
+                void updateWorldMatrices(const Pose &pose, const glm::mat4 &rootMatrix, std::vector<uint8_t> &dirtyFlags,
+                                         std::vector<uint8_t> &changedFlags, std::vector<glm::mat4> &world) const;
+
+                void updateWorldMatrices();
+            };
+
             /*
                 glTF animation channel
             */
@@ -197,8 +312,24 @@ namespace Util {
                     LINEAR, STEP, CUBICSPLINE
                 };
                 InterpolationType interpolation;
+                // Key times, followed by the key values packed as vec4 (rotations as xyzw quaternions)
+                // CUBICSPLINE stores three values per key: in-tangent, value, out-tangent
                 std::vector<float> inputs;
                 std::vector<glm::vec4> outputsVec4;
+
+                [[nodiscard]] uint32_t valueStride() const { return interpolation == CUBICSPLINE ? 3 : 1; }
+
+                [[nodiscard]] bool valid() const { return !inputs.empty() && outputsVec4.size() >= inputs.size() * valueStride(); }
+
+                /**
+                * Finds the key interval [inputs[i], inputs[i + 1]] containing time
+                *
+                * @param cursor Interval of the previous lookup, checked first together with its successor and updated
+                * @param u Receives the normalized position inside the interval, clamped to [0, 1]
+                *
+                * @return Index of the first key of the interval
+                */
+                uint32_t findKey(float time, uint32_t &cursor, float &u) const;
             };
 
             /*
@@ -210,6 +341,16 @@ namespace Util {
                 std::vector<AnimationChannel> channels;
                 float start = std::numeric_limits<float>::max();
                 float end = std::numeric_limits<float>::min();
+                // Key interval cursors of the default playback, one per channel
+                std::vector<uint32_t> cursors;
+
+                /**
+                * Samples every channel at the given time
+                *
+                * @param cursors One key interval cursor per channel, updated for the next call
+                * @param values Receives one value per channel, translation and scale in xyz, rotations as xyzw quaternions
+                */
+                void evaluate(float time, uint32_t *cursors, glm::vec4 *values) const;
             };
 
             /*
@@ -244,19 +385,47 @@ namespace Util {
                 getPipelineVertexInputState(const std::vector<VertexComponent>& components);
             };
 
+            /*
+                Per instance data of instanced draws, read as an instance rate vertex stream
+                The transform places the whole model, parameters are free for the shader (tint, animation phase, ...)
+            */
+            struct InstanceData {
+                glm::mat4 transform;
+                glm::vec4 parameters;
+                static VkVertexInputBindingDescription vertexInputBindingDescriptions[2];
+                static std::vector<VkVertexInputAttributeDescription> vertexInputAttributeDescriptions;
+                static VkPipelineVertexInputStateCreateInfo pipelineVertexInputStateCreateInfo;
+
+                static VkVertexInputBindingDescription inputBindingDescription(uint32_t binding);
+
+                /** @brief The transform takes four consecutive locations starting at firstLocation, parameters the one after */
+                static std::vector<VkVertexInputAttributeDescription> inputAttributeDescriptions(uint32_t binding, uint32_t firstLocation);
+
+                /** @brief Vertex components at binding 0 followed by the instance data at binding 1 */
+                static VkPipelineVertexInputStateCreateInfo *
+                getPipelineVertexInputState(const std::vector<VertexComponent>& components);
+            };
+
             enum FileLoadingFlags {
                 None = 0x00000000,
                 PreTransformVertices = 0x00000001,
                 PreMultiplyVertexColors = 0x00000002,
                 FlipY = 0x00000004,
-                DontLoadImages = 0x00000008
+                DontLoadImages = 0x00000008,
+                OptimizeMeshes = 0x00000010,
+                GenerateLods = 0x00000020,
+                ComputeSkinning = 0x00000040
             };
 
             enum RenderFlags {
                 BindImages = 0x00000001,
                 RenderOpaqueNodes = 0x00000002,
                 RenderAlphaMaskedNodes = 0x00000004,
-                RenderAlphaBlendedNodes = 0x00000008
+                RenderAlphaBlendedNodes = 0x00000008,
+                // Pushes Material::bindlessIndex at GLTFModel::materialIndexPushOffset instead of binding material sets
+                PushMaterialIndex = 0x00000010,
+                // Pushes the mesh's world matrix and joint palette offset to the vertex stage at offset 0, see Mesh::pushConstantSize
+                PushMeshMatrix = 0x00000020
             };
 
             class GLTFModel {
@@ -267,9 +436,27 @@ namespace Util {
 
                 void createEmptyTexture(VkQueue transferQueue);
 
+                // Scratch storage for sampled channel values
+                std::vector<glm::vec4> channelValues;
+
+                void optimizeMeshes(std::vector<uint32_t> &indexBuffer, std::vector<Vertex> &vertexBuffer);
+
+                void generateLods(std::vector<uint32_t> &indexBuffer, const std::vector<Vertex> &vertexBuffer, bool optimize);
+
+                void prepareSkinning();
+
+                void prepareCulling(bool preTransformed, bool flipY);
+
+                void drawNodeInstanced(const Node *node, VkCommandBuffer commandBuffer, uint32_t instanceCount, uint32_t renderFlags,
+                                       VkPipelineLayout pipelineLayout, uint32_t bindImageSet);
+
+                /** @brief Writes the world space bounds of a culling entry, returns false for entries that are never culled */
+                bool updateEntryBounds(size_t entry);
+
             public:
                 Device *device;
-                VkDescriptorPool descriptorPool;
+                // Node, joint, skinning and material sets, pools are added as the model's sets need them
+                DescriptorAllocator descriptorAllocator;
 
                 struct Vertices {
                     int count;
@@ -284,10 +471,54 @@ namespace Util {
 
                 std::vector<Node *> nodes;
                 std::vector<Node *> linearNodes;
+                SceneGraph sceneGraph;
+                // Number of joint palette buffers, set before loadFromFile when several frames are in flight (at most 32)
+                uint32_t framesInFlight = 1;
+                /*
+                    Joint matrices of all skinned meshes in one storage buffer per frame in flight
+                */
+                struct JointPalette {
+                    std::vector<glm::mat4> matrices;
+                    // Bit f is set while the buffer of frame f is missing the current value
+                    std::vector<uint32_t> pendingFrames;
+                    std::vector<Buffers> buffers;
+                    std::vector<VkDescriptorSet> descriptorSets;
+                } joints;
+
+                /*
+                    Compute skinning pre-pass, enabled with FileLoadingFlags::ComputeSkinning
+                    Skinned primitives are skinned once per frame into a copy of the vertex buffer, so every later pass
+                    (depth, shadow, color, each eye) draws them with an unskinned pipeline and the node matrix
+                */
+                struct SkinningPass {
+                    struct Dispatch {
+                        uint32_t firstVertex;
+                        uint32_t vertexCount;
+                        uint32_t jointOffset;
+                    };
+                    std::vector<Dispatch> dispatches;
+                    // Skinned vertex buffers, one per frame in flight
+                    std::vector<VkBuffer> buffers;
+                    std::vector<VkDeviceMemory> memories;
+                    std::vector<VkDescriptorSet> descriptorSets;
+                    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+                    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+                    VkPipeline pipeline = VK_NULL_HANDLE;
+                } skinning;
+                std::string skinningShaderPath = "Renderer/shader-spv/skinning-comp.spv";
+
+                // Node transforms as loaded from the file, animation blending falls back to it for unanimated weight
+                Pose bindPose;
+                // glTF node index to loaded node, nullptr for nodes outside the loaded scene
+                std::vector<Node *> nodeLookup;
+                // First loaded node carrying each name
+                std::unordered_map<std::string, Node *> nodeNameLookup;
 
                 std::vector<Skin *> skins;
 
                 std::vector<Texture> textures;
+                // References into TextureCache::global() keeping textures alive, one per image
+                std::vector<TextureCache::Handle> textureHandles;
                 std::vector<Material> materials;
                 std::vector<Animation> animations;
 
@@ -299,8 +530,50 @@ namespace Util {
                     float radius;
                 } dimensions;
 
+                /*
+                    Screen space error driven LOD selection, only used for primitives with generated LODs
+                */
+                struct LodSelection {
+                    bool enabled = false;
+                    glm::mat4 view{1.0f};
+                    // Pixels covered by one world unit at a view distance of one unit
+                    float projectionScale = 1.0f;
+                    // Largest allowed projected error in pixels
+                    float pixelThreshold = 1.0f;
+                } lodSelection;
+
+                /*
+                    View frustum culling of primitives against their world space bounds
+                    Skinned primitives and primitives without bounds are never culled, skinned bounds don't follow the animated pose
+                */
+                struct Culling {
+                    bool enabled = false;
+                    Frustum frustum;
+                    BoundsArray bounds;
+                    std::vector<uint8_t> visible;
+                    // Node and primitive of each bounds entry
+                    std::vector<std::pair<const Node *, const Primitive *>> entries;
+                    // Vertices changed after the bounds were read, applied on top of the node matrix
+                    glm::mat4 vertexTransform{1.0f};
+                    bool preTransformed = false;
+                    size_t visibleCount = 0;
+
+                    // Hierarchical culling, primitives below animated nodes live in the dynamic tree and the rest in the static one
+                    bool hierarchical = true;
+                    BVH staticTree;
+                    DynamicBVH dynamicTree;
+                    // Entry of each static tree item
+                    std::vector<uint32_t> staticEntries;
+                    // Dynamic tree proxy of each entry, DynamicBVH::nullNode for entries in the static tree or without bounds
+                    std::vector<int32_t> proxies;
+                    std::vector<uint32_t> unboundedEntries;
+                } culling;
+
                 bool metallicRoughnessWorkflow = true;
                 bool buffersBound = false;
+                // Push constant offset of the material index written under RenderFlags::PushMaterialIndex, visible to vertex and fragment stages
+                // Defaults past the mesh matrix block so both flags can be combined, bindless.frag declares the same offset
+                uint32_t materialIndexPushOffset = Mesh::pushConstantSize;
                 std::string path;
 
                 GLTFModel();
@@ -322,13 +595,78 @@ namespace Util {
                 void loadFromFile(const std::string& filename, Device *device, VkQueue transferQueue,
                                   uint32_t fileLoadingFlags = vkglTF::FileLoadingFlags::None, float scale = 1.0f);
 
-                void bindBuffers(VkCommandBuffer commandBuffer);
+                /** @brief Binds the index buffer and the vertex buffer, the frame's skinned copy when compute skinning is enabled */
+                void bindBuffers(VkCommandBuffer commandBuffer, uint32_t frameIndex = 0);
+
+                [[nodiscard]] VkBuffer getVertexBuffer(uint32_t frameIndex = 0) const;
+
+                /**
+                * Records the skinning dispatches of a frame, followed by a barrier for vertex input
+                *
+                * @note Must be recorded outside of a render pass, after the frame's joints were uploaded
+                */
+                void recordSkinning(VkCommandBuffer commandBuffer, uint32_t frameIndex = 0);
 
                 void drawNode(Node *node, VkCommandBuffer commandBuffer, uint32_t renderFlags = 0,
                               VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
 
                 void draw(VkCommandBuffer commandBuffer, uint32_t renderFlags = 0,
-                          VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
+                          VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1, uint32_t frameIndex = 0);
+
+                /**
+                * Draws every primitive once for all instances in an InstanceData buffer
+                *
+                * @note With RenderFlags::PushMeshMatrix the mesh's matrix is pushed like drawNode does and the shader applies
+                * the instance transform on top. Primitives are neither culled nor LOD selected per instance
+                */
+                void drawInstanced(VkCommandBuffer commandBuffer, VkBuffer instanceBuffer, uint32_t instanceCount, uint32_t renderFlags = 0,
+                                   VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1, uint32_t frameIndex = 0);
+
+                void setLodCamera(const Camera &camera, float viewportHeight, float pixelThreshold = 1.0f);
+
+                /**
+                * Enables culling against a frustum and tests the current world space bounds of all primitives
+                *
+                * @note Call again after the scene graph moved, Frustum::combine gives one frustum for both stereo views
+                */
+                void setCullingFrustum(const Frustum &frustum);
+
+                void setCullingCamera(const Camera &camera);
+
+                /**
+                * Rebuilds the culling trees from the current node transforms
+                *
+                * @note Only nodes targeted by animations are expected to move, call this after moving other nodes by hand
+                */
+                void buildBvh();
+
+                /** @brief Moves the bounds of animated primitives in the dynamic tree to their current node transforms */
+                void updateBvh();
+
+                /** @brief Appends the culling entries whose bounds intersect the frustum, entries without bounds always match */
+                void queryFrustum(const Frustum &frustum, std::vector<uint32_t> &entries) const;
+
+                /** @brief Appends the culling entries whose bounds intersect the sphere, entries without bounds always match */
+                void querySphere(const glm::vec3 &center, float radius, std::vector<uint32_t> &entries) const;
+
+                struct RayHit {
+                    uint32_t entry;
+                    float distance;
+                };
+
+                /**
+                * Finds the closest primitive bounds hit by a ray, for picking
+                *
+                * @note Tests bounds only, skinned primitives can't be hit
+                */
+                bool raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, RayHit &hit) const;
+
+                [[nodiscard]] bool isVisible(const Primitive *primitive) const;
+
+                /** @brief Transform from a culling entry's primitive dimensions to world space */
+                [[nodiscard]] glm::mat4 getEntryMatrix(size_t entry) const;
+
+                [[nodiscard]] const Primitive::Lod *selectLod(const Node *node, const Primitive *primitive) const;
 
                 void getNodeDimensions(Node *node, glm::vec3 &min, glm::vec3 &max);
 
@@ -336,10 +674,20 @@ namespace Util {
 
                 void updateAnimation(uint32_t index, float time);
 
+                void updateWorldMatrices();
+
+                /** @brief Updates the uniforms and joint matrices of meshes whose node or skin joints moved in the last world matrix update */
+                void updateChangedMeshes();
+
+                /** @brief Copies the joint matrices that changed since the frame's last upload into its palette buffer */
+                void uploadJoints(uint32_t frameIndex);
+
                 Node *findNode(Node *parent, uint32_t index);
 
                 Node *nodeFromIndex(uint32_t index);
 
+                Node *nodeFromName(const std::string &name);
+
                 void prepareNodeDescriptor(vkglTF::Node *node, VkDescriptorSetLayout descriptorSetLayout);
 
             };
@@ -0,0 +1,282 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#include "GPUDrivenRenderer.h"
+#include "Initializers.h"
+
+namespace Util {
+    namespace Renderer {
+        namespace vkglTF {
+            namespace {
+                void createDeviceLocalBuffer(Device *device, VkQueue transferQueue, VkBufferUsageFlags usage, Buffers *buffer, VkDeviceSize size, void *data) {
+                    Buffers staging;
+                    VK_CHECK_RESULT(device->createBuffer(
+                            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                            &staging,
+                            size,
+                            data))
+                    VK_CHECK_RESULT(device->createBuffer(
+                            usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                            buffer,
+                            size))
+                    device->copyBuffer(&staging, buffer, transferQueue);
+                    staging.destroy();
+                }
+            }
+
+            GPUDrivenRenderer::GPUDrivenRenderer(GLTFModel &_model, uint32_t frameCount)
+                : model(_model)
+                , device(_model.device)
+                , frames(frameCount) { }
+
+            GPUDrivenRenderer::~GPUDrivenRenderer() {
+                if (!device) {
+                    return;
+                }
+                for (Frame &frame : frames) {
+                    if (frame.matrices.mapped) {
+                        frame.matrices.unmap();
+                    }
+                    frame.matrices.destroy();
+                    frame.commands.destroy();
+                    frame.counts.destroy();
+                }
+                records.destroy();
+                materials.destroy();
+                if (pipeline != VK_NULL_HANDLE) {
+                    vkDestroyPipeline(device->getLogicalDevice(), pipeline, nullptr);
+                }
+                if (pipelineLayout != VK_NULL_HANDLE) {
+                    vkDestroyPipelineLayout(device->getLogicalDevice(), pipelineLayout, nullptr);
+                }
+                if (descriptorSetLayout != VK_NULL_HANDLE) {
+                    vkDestroyDescriptorSetLayout(device->getLogicalDevice(), descriptorSetLayout, nullptr);
+                }
+                if (descriptorPool != VK_NULL_HANDLE) {
+                    vkDestroyDescriptorPool(device->getLogicalDevice(), descriptorPool, nullptr);
+                }
+            }
+
+            void GPUDrivenRenderer::prepare(VkQueue transferQueue, bool drawIndirectCount) {
+                device = model.device;
+                VkDevice logicalDevice = device->getLogicalDevice();
+                const auto &culling = model.culling;
+                // The last matrix slot stays identity, used by pre-transformed vertices
+                const auto identityMatrix = static_cast<uint32_t>(model.sceneGraph.size());
+
+                // Records grouped by alpha mode so every bucket is one contiguous command range
+                std::vector<DrawRecord> buckets[bucketCount];
+                for (size_t i = 0; i < culling.entries.size(); i++) {
+                    const Node *node = culling.entries[i].first;
+                    const Primitive *primitive = culling.entries[i].second;
+                    DrawRecord record{};
+                    const bool bounded = !node->skin && primitive->dimensions.min.x <= primitive->dimensions.max.x;
+                    if (culling.preTransformed) {
+                        // Culling bounds of pre-transformed models are already in world space
+                        record.center = glm::vec4(culling.bounds.centerX[i], culling.bounds.centerY[i], culling.bounds.centerZ[i], 0.0f);
+                        record.extent = glm::vec4(culling.bounds.extentX[i], culling.bounds.extentY[i], culling.bounds.extentZ[i], bounded ? 0.0f : -1.0f);
+                        record.matrix = identityMatrix;
+                    } else {
+                        record.center = glm::vec4(glm::vec3(culling.vertexTransform * glm::vec4(primitive->dimensions.center, 1.0f)), 0.0f);
+                        record.extent = glm::vec4(primitive->dimensions.size * 0.5f, bounded ? 0.0f : -1.0f);
+                        record.matrix = node->id;
+                    }
+                    // LOD selection stays on the CPU path, indirect draws use the full detail range
+                    record.firstIndex = primitive->lods.empty() ? primitive->firstIndex : primitive->lods.front().firstIndex;
+                    record.indexCount = primitive->lods.empty() ? primitive->indexCount : primitive->lods.front().indexCount;
+                    record.material = static_cast<uint32_t>(&primitive->material - model.materials.data());
+                    record.bucket = static_cast<uint32_t>(primitive->material.alphaMode);
+                    buckets[record.bucket].push_back(record);
+                }
+                std::vector<DrawRecord> drawRecords;
+                for (uint32_t bucket = 0; bucket < bucketCount; bucket++) {
+                    bucketStarts[bucket] = static_cast<uint32_t>(drawRecords.size());
+                    bucketSizes[bucket] = static_cast<uint32_t>(buckets[bucket].size());
+                    drawRecords.insert(drawRecords.end(), buckets[bucket].begin(), buckets[bucket].end());
+                }
+                recordCount = static_cast<uint32_t>(drawRecords.size());
+                if (recordCount == 0) {
+                    return;
+                }
+
+                std::vector<MaterialRecord> materialRecords;
+                for (const Material &material : model.materials) {
+                    materialRecords.push_back({ material.baseColorFactor, material.metallicFactor, material.roughnessFactor,
+                                                material.alphaCutoff, static_cast<uint32_t>(material.alphaMode) });
+                }
+                if (materialRecords.empty()) {
+                    materialRecords.push_back({ glm::vec4(1.0f), 1.0f, 1.0f, 1.0f, 0 });
+                }
+
+                createDeviceLocalBuffer(device, transferQueue, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &records,
+                                        drawRecords.size() * sizeof(DrawRecord), drawRecords.data());
+                createDeviceLocalBuffer(device, transferQueue, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &materials,
+                                        materialRecords.size() * sizeof(MaterialRecord), materialRecords.data());
+
+                std::vector<glm::mat4> initialMatrices = model.sceneGraph.worldMatrices;
+                initialMatrices.emplace_back(1.0f);
+                for (Frame &frame : frames) {
+                    VK_CHECK_RESULT(device->createBuffer(
+                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                            &frame.matrices,
+                            initialMatrices.size() * sizeof(glm::mat4),
+                            initialMatrices.data()))
+                    VK_CHECK_RESULT(frame.matrices.map())
+                    VK_CHECK_RESULT(device->createBuffer(
+                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                            &frame.commands,
+                            recordCount * sizeof(VkDrawIndexedIndirectCommand)))
+                    VK_CHECK_RESULT(device->createBuffer(
+                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                            &frame.counts,
+                            bucketCount * sizeof(uint32_t)))
+                }
+
+                // Draw counts need VK_KHR_draw_indirect_count or Vulkan 1.2 drawIndirectCount, otherwise the fixed count path is used
+                if (drawIndirectCount) {
+                    drawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(vkGetDeviceProcAddr(logicalDevice, "vkCmdDrawIndexedIndirectCountKHR"));
+                    if (!drawIndexedIndirectCount) {
+                        drawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(vkGetDeviceProcAddr(logicalDevice, "vkCmdDrawIndexedIndirectCount"));
+                    }
+                }
+                if (!device->getEnabledFeatures().drawIndirectFirstInstance) {
+                    fprintf(stderr, "GPUDrivenRenderer: drawIndirectFirstInstance is not enabled, draws can't find their records\n");
+                }
+
+                // Draw data set, shared by the culling pass and the graphics pipelines
+                std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+                        Initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT, 0),
+                        Initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT, 1),
+                        Initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 2),
+                        Initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+                        Initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+                };
+                VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = Initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+                VK_CHECK_RESULT(vkCreateDescriptorSetLayout(logicalDevice, &descriptorLayoutCI, nullptr, &descriptorSetLayout))
+
+                const auto frameCount = static_cast<uint32_t>(frames.size());
+                VkDescriptorPoolSize poolSize = Initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5 * frameCount);
+                VkDescriptorPoolCreateInfo descriptorPoolCI{};
+                descriptorPoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+                descriptorPoolCI.poolSizeCount = 1;
+                descriptorPoolCI.pPoolSizes = &poolSize;
+                descriptorPoolCI.maxSets = frameCount;
+                VK_CHECK_RESULT(vkCreateDescriptorPool(logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool))
+
+                for (Frame &frame : frames) {
+                    VkDescriptorSetAllocateInfo descriptorSetAllocInfo = Initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+                    VK_CHECK_RESULT(vkAllocateDescriptorSets(logicalDevice, &descriptorSetAllocInfo, &frame.descriptorSet))
+                    std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+                            Initializers::writeDescriptorSet(frame.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &records.descriptor),
+                            Initializers::writeDescriptorSet(frame.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &frame.matrices.descriptor),
+                            Initializers::writeDescriptorSet(frame.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &materials.descriptor),
+                            Initializers::writeDescriptorSet(frame.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &frame.commands.descriptor),
+                            Initializers::writeDescriptorSet(frame.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &frame.counts.descriptor),
+                    };
+                    vkUpdateDescriptorSets(logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+                }
+
+                VkPushConstantRange pushConstantRange = Initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstants), 0);
+                VkPipelineLayoutCreateInfo pipelineLayoutCI = Initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+                pipelineLayoutCI.pushConstantRangeCount = 1;
+                pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+                VK_CHECK_RESULT(vkCreatePipelineLayout(logicalDevice, &pipelineLayoutCI, nullptr, &pipelineLayout))
+
+                VkComputePipelineCreateInfo pipelineCI = Initializers::computePipelineCreateInfo(pipelineLayout);
+                pipelineCI.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+                pipelineCI.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+                pipelineCI.stage.module = tools::loadShader(cullShaderPath.c_str(), logicalDevice);
+                pipelineCI.stage.pName = "main";
+                assert(pipelineCI.stage.module != VK_NULL_HANDLE);
+                VK_CHECK_RESULT(vkCreateComputePipelines(logicalDevice, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &pipeline))
+                vkDestroyShaderModule(logicalDevice, pipelineCI.stage.module, nullptr);
+            }
+
+            void GPUDrivenRenderer::recordCulling(VkCommandBuffer commandBuffer, uint32_t frameIndex, const Frustum &frustum) {
+                if (recordCount == 0) {
+                    return;
+                }
+                Frame &frame = frames[frameIndex];
+                memcpy(frame.matrices.mapped, model.sceneGraph.worldMatrices.data(), model.sceneGraph.size() * sizeof(glm::mat4));
+
+                // Earlier indirect draws from this frame's buffers must be done before they are rewritten
+                vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                     0, 0, nullptr, 0, nullptr, 0, nullptr);
+                const bool compact = usesDrawCount();
+                if (compact) {
+                    vkCmdFillBuffer(commandBuffer, frame.counts.buffer, 0, VK_WHOLE_SIZE, 0);
+                    VkBufferMemoryBarrier resetBarrier = Initializers::bufferMemoryBarrier();
+                    resetBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                    resetBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+                    resetBarrier.buffer = frame.counts.buffer;
+                    resetBarrier.offset = 0;
+                    resetBarrier.size = VK_WHOLE_SIZE;
+                    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &resetBarrier, 0, nullptr);
+                }
+
+                PushConstants pushConstants{};
+                for (int i = 0; i < 6; i++) {
+                    pushConstants.planes[i] = frustum.planes[i];
+                }
+                pushConstants.recordCount = recordCount;
+                pushConstants.compact = compact ? 1 : 0;
+                for (uint32_t bucket = 0; bucket < bucketCount; bucket++) {
+                    pushConstants.bucketStarts[bucket] = bucketStarts[bucket];
+                }
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &frame.descriptorSet, 0, nullptr);
+                vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+                vkCmdDispatch(commandBuffer, (recordCount + 63) / 64, 1, 1);
+
+                VkBufferMemoryBarrier barriers[2] = { Initializers::bufferMemoryBarrier(), Initializers::bufferMemoryBarrier() };
+                barriers[0].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+                barriers[0].dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+                barriers[0].buffer = frame.commands.buffer;
+                barriers[0].offset = 0;
+                barriers[0].size = VK_WHOLE_SIZE;
+                barriers[1] = barriers[0];
+                barriers[1].buffer = frame.counts.buffer;
+                vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 0, nullptr,
+                                     compact ? 2 : 1, barriers, 0, nullptr);
+            }
+
+            void GPUDrivenRenderer::draw(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkPipelineLayout graphicsPipelineLayout, uint32_t set,
+                                         uint32_t renderFlags) {
+                if (recordCount == 0) {
+                    return;
+                }
+                Frame &frame = frames[frameIndex];
+                model.bindBuffers(commandBuffer, frameIndex);
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipelineLayout, set, 1, &frame.descriptorSet, 0, nullptr);
+
+                const uint32_t bucketFlags[bucketCount] = { RenderFlags::RenderOpaqueNodes, RenderFlags::RenderAlphaMaskedNodes, RenderFlags::RenderAlphaBlendedNodes };
+                const uint32_t selectFlags = RenderFlags::RenderOpaqueNodes | RenderFlags::RenderAlphaMaskedNodes | RenderFlags::RenderAlphaBlendedNodes;
+                const bool multiDraw = device->getEnabledFeatures().multiDrawIndirect;
+                const auto stride = static_cast<uint32_t>(sizeof(VkDrawIndexedIndirectCommand));
+                for (uint32_t bucket = 0; bucket < bucketCount; bucket++) {
+                    if (bucketSizes[bucket] == 0 || ((renderFlags & selectFlags) && !(renderFlags & bucketFlags[bucket]))) {
+                        continue;
+                    }
+                    const VkDeviceSize offset = bucketStarts[bucket] * sizeof(VkDrawIndexedIndirectCommand);
+                    if (drawIndexedIndirectCount) {
+                        drawIndexedIndirectCount(commandBuffer, frame.commands.buffer, offset, frame.counts.buffer, bucket * sizeof(uint32_t),
+                                                 bucketSizes[bucket], stride);
+                    } else if (multiDraw) {
+                        vkCmdDrawIndexedIndirect(commandBuffer, frame.commands.buffer, offset, bucketSizes[bucket], stride);
+                    } else {
+                        // Without multiDrawIndirect every command needs its own call, culled ones still draw zero instances
+                        for (uint32_t i = 0; i < bucketSizes[bucket]; i++) {
+                            vkCmdDrawIndexedIndirect(commandBuffer, frame.commands.buffer, offset + i * stride, 1, stride);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,117 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef LIGHTFIELDFORWARDRENDERER_GPUDRIVENRENDERER_H
+#define LIGHTFIELDFORWARDRENDERER_GPUDRIVENRENDERER_H
+
+#include <vector>
+
+#include "GLTFModel.h"
+
+namespace Util {
+    namespace Renderer {
+        namespace vkglTF {
+            /*
+                GPU driven drawing of a model
+                Every primitive is a draw record in a storage buffer, a compute pass frustum culls them and writes
+                indexed indirect commands that are drawn with one multi draw per alpha mode
+                The draw data set (records, node matrices, materials) is shared by the culling pass and the graphics
+                pipelines, see Shaders/indirect.vert for the expected layout
+            */
+            class GPUDrivenRenderer {
+            public:
+                // Matches DrawRecord in the shaders
+                struct DrawRecord {
+                    glm::vec4 center;
+                    // w < 0 marks records that are never culled
+                    glm::vec4 extent;
+                    uint32_t firstIndex;
+                    uint32_t indexCount;
+                    uint32_t matrix;
+                    uint32_t material;
+                    uint32_t bucket;
+                    uint32_t padding[3];
+                };
+
+                // Matches MaterialRecord in the shaders
+                struct MaterialRecord {
+                    glm::vec4 baseColorFactor;
+                    float metallicFactor;
+                    float roughnessFactor;
+                    float alphaCutoff;
+                    uint32_t alphaMode;
+                };
+
+                // One bucket per Material::AlphaMode, drawn by the matching RenderFlags
+                static constexpr uint32_t bucketCount = 3;
+
+                std::string cullShaderPath = "Renderer/shader-spv/drawcull-comp.spv";
+
+                GPUDrivenRenderer(GLTFModel &model, uint32_t frameCount);
+
+                ~GPUDrivenRenderer();
+
+                /**
+                * Builds the draw records and creates the buffers and culling pipeline, the model must be loaded
+                *
+                * @param drawIndirectCount Whether the application enabled VK_KHR_draw_indirect_count or the Vulkan 1.2
+                * drawIndirectCount feature, the entry points resolve on 1.2 devices even when it is disabled
+                */
+                void prepare(VkQueue transferQueue, bool drawIndirectCount = false);
+
+                [[nodiscard]] VkDescriptorSetLayout getDescriptorSetLayout() const { return descriptorSetLayout; }
+
+                /** @brief True when draw counts are read from a buffer, otherwise culled commands are drawn with zero instances */
+                [[nodiscard]] bool usesDrawCount() const { return drawIndexedIndirectCount != nullptr; }
+
+                /**
+                * Uploads the node matrices of a frame and records the culling dispatch followed by a barrier for indirect reads
+                *
+                * @note Must be recorded outside of a render pass
+                */
+                void recordCulling(VkCommandBuffer commandBuffer, uint32_t frameIndex, const Frustum &frustum);
+
+                /**
+                * Binds the model buffers and the draw data set, then draws the buckets selected by renderFlags
+                *
+                * @param set Index of the draw data set in pipelineLayout
+                * @param renderFlags RenderOpaqueNodes, RenderAlphaMaskedNodes and RenderAlphaBlendedNodes select buckets, none draws all
+                */
+                void draw(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkPipelineLayout pipelineLayout, uint32_t set = 1, uint32_t renderFlags = 0);
+
+            private:
+                struct PushConstants {
+                    glm::vec4 planes[6];
+                    uint32_t recordCount;
+                    uint32_t compact;
+                    uint32_t bucketStarts[bucketCount];
+                };
+
+                struct Frame {
+                    Buffers matrices;
+                    Buffers commands;
+                    Buffers counts;
+                    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+                };
+
+                GLTFModel &model;
+                Device *device;
+                std::vector<Frame> frames;
+                Buffers records;
+                Buffers materials;
+                uint32_t recordCount = 0;
+                uint32_t bucketStarts[bucketCount] = {};
+                uint32_t bucketSizes[bucketCount] = {};
+
+                VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+                VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+                VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+                VkPipeline pipeline = VK_NULL_HANDLE;
+                PFN_vkCmdDrawIndexedIndirectCountKHR drawIndexedIndirectCount = nullptr;
+            };
+        }
+    }
+}
+
+#endif //LIGHTFIELDFORWARDRENDERER_GPUDRIVENRENDERER_H
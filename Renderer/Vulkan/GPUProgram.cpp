@@ -3,6 +3,8 @@
 //
 
 #include <cassert>
+#include <cstdio>
+#include <cstring>
 #include <vector>
 #include <fstream>
 #ifdef _WIN32
@@ -43,13 +45,20 @@ DescriptorInfo::DescriptorInfo(VkBuffer buffer_) {
     buffer.range = VK_WHOLE_SIZE;
 }
 
+DescriptorInfo::DescriptorInfo(VkBufferView bufferView_) {
+    bufferView = bufferView_;
+}
+
 std::vector<char> ReadShaderFile(const std::string & fileName) {
     std::vector<char> returnMe;
     char buff[FILENAME_MAX];
     GetCurDir( buff, FILENAME_MAX );
     std::string workDir(buff);
     workDir += "/" + fileName;
-    std::fstream file(workDir, std::fstream::in | std::fstream::ate);
+    std::fstream file(workDir, std::fstream::in | std::fstream::binary | std::fstream::ate);
+    if (!file.is_open()) {
+        return returnMe;
+    }
     uint64_t length = file.tellg();
     file.seekg(0);
     returnMe.resize(length);
@@ -60,13 +69,11 @@ std::vector<char> ReadShaderFile(const std::string & fileName) {
 
 bool GPUProgram::loadShader(GPUProgram &shader, VkDevice device, const char *path) {
     std::vector<char> data = ReadShaderFile(path);
+    if (data.empty() || data.size() % 4 != 0) {
+        fprintf(stderr, "Could not load shader file \"%s\"\n", path);
+        return false;
+    }
     VkShaderModule shaderModule;
-    VkShaderModuleCreateInfo moduleCreateInfo{};
-    moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    moduleCreateInfo.codeSize = data.size();
-    moduleCreateInfo.pCode = (uint32_t*)&*data.begin();
-
-    VK_CHECK_RESULT(vkCreateShaderModule(device, &moduleCreateInfo, nullptr, &shaderModule))
 
     VkShaderModuleCreateInfo createInfo = { VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
     createInfo.codeSize = data.size() * sizeof(char); // note: this needs to be a number of bytes!
@@ -74,7 +81,6 @@ bool GPUProgram::loadShader(GPUProgram &shader, VkDevice device, const char *pat
 
     VK_CHECK_RESULT(vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule))
 
-    assert(data.size() % 4 == 0);
     parseShader(shader, reinterpret_cast<const uint32_t*>(&*data.begin()), data.size() / 4);
 
     shader.module = shaderModule;
@@ -85,12 +91,17 @@ bool GPUProgram::loadShader(GPUProgram &shader, VkDevice device, const char *pat
 // https://www.khronos.org/registry/spir-v/specs/1.2/SPIRV.html
 struct Id
 {
-    Id() : opcode(0), typeId(0), storageClass(0), binding(0), set(0) {}
+    Id() : opcode(0), typeId(0), storageClass(0), binding(0), set(0), bufferBlock(false), dim(0), sampled(0) {}
     uint32_t opcode;
     uint32_t typeId;
     uint32_t storageClass;
     uint32_t binding;
     uint32_t set;
+    // Structs in the Uniform storage class are storage buffers when decorated BufferBlock
+    bool bufferBlock;
+    // Image dimensionality and whether it is sampled (1) or a storage image (2)
+    uint32_t dim;
+    uint32_t sampled;
 };
 
 static VkShaderStageFlagBits getShaderStage(spv::ExecutionModel executionModel)
@@ -183,10 +194,26 @@ void GPUProgram::parseShader(GPUProgram& shader, const uint32_t* code, uint32_t
                         assert(wordCount == 4);
                         ids[id].binding = insn[3];
                         break;
+                    case spv::DecorationBufferBlock:
+                        ids[id].bufferBlock = true;
+                        break;
                 }
             } break;
-            case spv::OpTypeStruct:
             case spv::OpTypeImage:
+            {
+                assert(wordCount >= 9);
+
+                uint32_t id = insn[1];
+                assert(id < idBound);
+
+                assert(ids[id].opcode == 0);
+                ids[id].opcode = opcode;
+                ids[id].dim = insn[3];
+                ids[id].sampled = insn[7];
+            } break;
+            case spv::OpTypeArray:
+            case spv::OpTypeRuntimeArray:
+            case spv::OpTypeStruct:
             case spv::OpTypeSampler:
             case spv::OpTypeSampledImage:
             {
@@ -239,16 +266,22 @@ void GPUProgram::parseShader(GPUProgram& shader, const uint32_t* code, uint32_t
 
             assert((shader.resourceMask & (1u << id.binding)) == 0);
 
-            uint32_t typeKind = ids[ids[id.typeId].typeId].opcode;
+            const Id& type = ids[ids[id.typeId].typeId];
 
-            switch (typeKind)
+            switch (type.opcode)
             {
                 case spv::OpTypeStruct:
-                    shader.resourceTypes[id.binding] = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                    shader.resourceTypes[id.binding] = id.storageClass == spv::StorageClassUniform && !type.bufferBlock
+                                                       ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
                     shader.resourceMask |= 1u << id.binding;
                     break;
                 case spv::OpTypeImage:
-                    shader.resourceTypes[id.binding] = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+                    if (type.dim == spv::DimSubpassData)
+                        shader.resourceTypes[id.binding] = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+                    else if (type.dim == spv::DimBuffer)
+                        shader.resourceTypes[id.binding] = type.sampled == 1 ? VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER;
+                    else
+                        shader.resourceTypes[id.binding] = type.sampled == 1 ? VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
                     shader.resourceMask |= 1u << id.binding;
                     break;
                 case spv::OpTypeSampler:
@@ -259,6 +292,10 @@ void GPUProgram::parseShader(GPUProgram& shader, const uint32_t* code, uint32_t
                     shader.resourceTypes[id.binding] = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
                     shader.resourceMask |= 1u << id.binding;
                     break;
+                case spv::OpTypeArray:
+                case spv::OpTypeRuntimeArray:
+                    assert(!"Descriptor arrays are not supported by program reflection");
+                    break;
                 default:
                     assert(!"Unknown resource type");
             }
@@ -280,7 +317,7 @@ VkSpecializationInfo GPUProgram::fillSpecializationInfo(std::vector<VkSpecializa
 
     VkSpecializationInfo result = {};
     result.mapEntryCount = uint32_t(entries.size());
-    result.pMapEntries = &*entries.begin();
+    result.pMapEntries = entries.data();
     result.dataSize = constants.size() * sizeof(int);
     result.pData = constants.begin();
 
@@ -438,7 +475,7 @@ static VkDescriptorSetLayout createSetLayout(VkDevice device, GPUProgram::Shader
     VkDescriptorSetLayoutCreateInfo setCreateInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
     setCreateInfo.flags = pushDescriptorsSupported ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR : 0;
     setCreateInfo.bindingCount = uint32_t(setBindings.size());
-    setCreateInfo.pBindings = &*setBindings.begin();
+    setCreateInfo.pBindings = setBindings.data();
 
     VkDescriptorSetLayout setLayout = nullptr;
     VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &setCreateInfo, nullptr, &setLayout))
@@ -493,7 +530,7 @@ static VkDescriptorUpdateTemplate createUpdateTemplate(VkDevice device, VkPipeli
     VkDescriptorUpdateTemplateCreateInfo createInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO };
 
     createInfo.descriptorUpdateEntryCount = uint32_t(entries.size());
-    createInfo.pDescriptorUpdateEntries = &*entries.begin();
+    createInfo.pDescriptorUpdateEntries = entries.data();
 
     createInfo.templateType = pushDescriptorsSupported ? VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_PUSH_DESCRIPTORS_KHR : VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
     createInfo.descriptorSetLayout = pushDescriptorsSupported ? nullptr : setLayout;
@@ -524,21 +561,65 @@ GPUProgram::createProgram(VkDevice device, VkPipelineBindPoint bindPoint, Shader
     program.layout = createPipelineLayout(device, program.setLayout, pushConstantStages, pushConstantSize);
     assert(program.layout);
 
-    program.updateTemplate = createUpdateTemplate(device, bindPoint, program.layout, program.setLayout, shaders, pushDescriptorsSupported);
-    assert(program.updateTemplate);
+    VkDescriptorType resourceTypes[32] = {};
+    // Templates need at least one entry, programs without resources have nothing to update
+    if (gatherResources(shaders, resourceTypes) != 0)
+    {
+        program.updateTemplate = createUpdateTemplate(device, bindPoint, program.layout, program.setLayout, shaders, pushDescriptorsSupported);
+        assert(program.updateTemplate);
+    }
 
     program.pushConstantStages = pushConstantStages;
 
+    if (pushDescriptorsSupported)
+    {
+        program.pushDescriptorSetWithTemplate = reinterpret_cast<PFN_vkCmdPushDescriptorSetWithTemplateKHR>(
+                vkGetDeviceProcAddr(device, "vkCmdPushDescriptorSetWithTemplateKHR"));
+        if (!program.pushDescriptorSetWithTemplate)
+            fprintf(stderr, "GPUProgram: VK_KHR_push_descriptor is not enabled on the device\n");
+    }
+
     return program;
 }
 
 void GPUProgram::destroyProgram(VkDevice device, const Program &program) {
-    vkDestroyDescriptorUpdateTemplate(device, program.updateTemplate, nullptr);
+    if (program.updateTemplate)
+        vkDestroyDescriptorUpdateTemplate(device, program.updateTemplate, nullptr);
     vkDestroyPipelineLayout(device, program.layout, nullptr);
     vkDestroyDescriptorSetLayout(device, program.setLayout, nullptr);
 }
 
+void GPUProgram::pushDescriptors(VkCommandBuffer commandBuffer, const Program &program, const DescriptorInfo *descriptors) {
+    assert(program.pushDescriptorSetWithTemplate);
+    if (program.updateTemplate)
+        program.pushDescriptorSetWithTemplate(commandBuffer, program.updateTemplate, program.layout, 0, descriptors);
+}
+
+void GPUProgram::writeDescriptors(VkDevice device, VkDescriptorSet descriptorSet, const Program &program,
+                                  const DescriptorInfo *descriptors) {
+    assert(!program.pushDescriptorSetWithTemplate);
+    if (program.updateTemplate)
+        vkUpdateDescriptorSetWithTemplate(device, descriptorSet, program.updateTemplate, descriptors);
+}
+
+bool GPUProgram::pushDescriptorsSupported(VkPhysicalDevice physicalDevice) {
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+    for (const VkExtensionProperties& extension : extensions)
+        if (strcmp(extension.extensionName, VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME) == 0)
+            return true;
+    return false;
+}
+
 GPUProgram::GPUProgram()
-: entryPoint("main")
+: module(VK_NULL_HANDLE)
+, stage(VK_SHADER_STAGE_VERTEX_BIT)
+, entryPoint("main")
+, resourceTypes()
+, resourceMask(0)
+, localSize(0.0f)
+, usesPushConstants(false)
 {
 }
@@ -7,6 +7,8 @@
 
 #include <vulkan/vulkan.h>
 #include <initializer_list>
+#include <string>
+#include <vector>
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
@@ -17,12 +19,16 @@ struct Program {
     VkDescriptorSetLayout setLayout;
     VkDescriptorUpdateTemplate updateTemplate;
     VkShaderStageFlags pushConstantStages;
+    // Loaded when the program was created for push descriptors, set 0 is then pushed instead of allocated
+    PFN_vkCmdPushDescriptorSetWithTemplateKHR pushDescriptorSetWithTemplate;
 };
 
 struct DescriptorInfo {
     union {
         VkDescriptorImageInfo image;
         VkDescriptorBufferInfo buffer;
+        // Uniform and storage texel buffers, the update template reads the view from the start of the entry
+        VkBufferView bufferView;
     };
 
     DescriptorInfo() = default;
@@ -30,6 +36,7 @@ struct DescriptorInfo {
     DescriptorInfo(VkSampler sampler, VkImageView imageView, VkImageLayout imageLayout);
     DescriptorInfo(VkBuffer buffer_, VkDeviceSize offset, VkDeviceSize range);
     explicit DescriptorInfo(VkBuffer buffer_);
+    explicit DescriptorInfo(VkBufferView bufferView_);
 };
 
 struct GPUProgram
@@ -48,6 +55,9 @@ struct GPUProgram
 
     static bool loadShader(GPUProgram& shader, VkDevice device, const char* path);
 
+    /** @brief Whether VK_KHR_push_descriptor is available, the application still has to enable it on the device */
+    static bool pushDescriptorsSupported(VkPhysicalDevice physicalDevice);
+
     using Shaders = std::initializer_list<const GPUProgram*>;
     using Constants = std::initializer_list<int>;
 
@@ -55,8 +65,19 @@ struct GPUProgram
     VkPipeline createGraphicsPipeline(VkDevice device, VkPipelineCache pipelineCache, VkRenderPass renderPass, Shaders shaders, VkPipelineLayout layout, Constants constants = {});
     VkPipeline createComputePipeline(VkDevice device, VkPipelineCache pipelineCache, const GPUProgram& shader, VkPipelineLayout layout, Constants constants = {});
 
+    /**
+    * Creates the set layout, pipeline layout and descriptor update template of the resources reflected from the shaders
+    *
+    * @note All resources live in set 0 at binding < 32 and aren't arrays, descriptors are passed as DescriptorInfo[binding]
+    */
     static Program createProgram(VkDevice device, VkPipelineBindPoint bindPoint, Shaders shaders, size_t pushConstantSize, bool pushDescriptorsSupported);
-    void destroyProgram(VkDevice device, const Program& program);
+    static void destroyProgram(VkDevice device, const Program& program);
+
+    /** @brief Pushes set 0 of a program created with push descriptors, one call without any descriptor set allocation */
+    static void pushDescriptors(VkCommandBuffer commandBuffer, const Program& program, const DescriptorInfo* descriptors);
+
+    /** @brief Writes all descriptors of a set allocated from program.setLayout with the program's update template */
+    static void writeDescriptors(VkDevice device, VkDescriptorSet descriptorSet, const Program& program, const DescriptorInfo* descriptors);
 
     static inline uint32_t getGroupCount(uint32_t threadCount, uint32_t localSize)
     {
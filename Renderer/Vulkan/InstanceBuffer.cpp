@@ -0,0 +1,60 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#include "InstanceBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Util {
+    namespace Renderer {
+        namespace vkglTF {
+            InstanceBuffer::InstanceBuffer(Device *_device, uint32_t frameCount)
+                : device(_device)
+                , frames(frameCount) { }
+
+            InstanceBuffer::~InstanceBuffer() {
+                for (Frame &frame : frames) {
+                    if (frame.buffer.mapped) {
+                        frame.buffer.unmap();
+                    }
+                    frame.buffer.destroy();
+                }
+            }
+
+            bool InstanceBuffer::update(uint32_t frameIndex, const InstanceData *instances, uint32_t count) {
+                Frame &frame = frames[frameIndex];
+                const VkDeviceSize required = std::max(count, 1u) * sizeof(InstanceData);
+                bool recreated = false;
+                if (frame.capacity < required) {
+                    if (frame.buffer.mapped) {
+                        frame.buffer.unmap();
+                    }
+                    frame.buffer.destroy();
+                    frame.buffer = Buffers{};
+                    // Headroom so a slowly growing crowd doesn't reallocate every frame
+                    frame.capacity = required + required / 2;
+                    VK_CHECK_RESULT(device->createBuffer(
+                            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                            &frame.buffer,
+                            frame.capacity))
+                    VK_CHECK_RESULT(frame.buffer.map())
+                    recreated = true;
+                }
+                if (count > 0) {
+                    memcpy(frame.buffer.mapped, instances, count * sizeof(InstanceData));
+                }
+                frame.count = count;
+                return recreated;
+            }
+
+            void InstanceBuffer::draw(GLTFModel &model, VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t renderFlags,
+                                      VkPipelineLayout pipelineLayout, uint32_t bindImageSet) const {
+                const Frame &frame = frames[frameIndex];
+                model.drawInstanced(commandBuffer, frame.buffer.buffer, frame.count, renderFlags, pipelineLayout, bindImageSet, frameIndex);
+            }
+        }
+    }
+}
@@ -0,0 +1,58 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef LIGHTFIELDFORWARDRENDERER_INSTANCEBUFFER_H
+#define LIGHTFIELDFORWARDRENDERER_INSTANCEBUFFER_H
+
+#include <vector>
+
+#include "GLTFModel.h"
+
+namespace Util {
+    namespace Renderer {
+        namespace vkglTF {
+            /*
+                Per frame InstanceData for GLTFModel::drawInstanced
+                The host visible buffers are usable both as the instance rate vertex stream and as a storage buffer
+            */
+            class InstanceBuffer {
+            public:
+                InstanceBuffer(Device *device, uint32_t frameCount);
+
+                ~InstanceBuffer();
+
+                /**
+                * Copies the instances of a frame, growing its buffer when needed
+                *
+                * @param frameIndex Frame in flight whose buffer is written, the GPU must be done reading it
+                *
+                * @return True if the frame buffer was recreated, descriptors referencing it must then be updated
+                */
+                bool update(uint32_t frameIndex, const InstanceData *instances, uint32_t count);
+
+                [[nodiscard]] VkBuffer getBuffer(uint32_t frameIndex) const { return frames[frameIndex].buffer.buffer; }
+
+                [[nodiscard]] Buffers &getFrameBuffer(uint32_t frameIndex) { return frames[frameIndex].buffer; }
+
+                [[nodiscard]] uint32_t getCount(uint32_t frameIndex) const { return frames[frameIndex].count; }
+
+                /** @brief Draws every instance written for the frame, see GLTFModel::drawInstanced for the remaining parameters */
+                void draw(GLTFModel &model, VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t renderFlags = 0,
+                          VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1) const;
+
+            private:
+                struct Frame {
+                    Buffers buffer;
+                    VkDeviceSize capacity = 0;
+                    uint32_t count = 0;
+                };
+
+                Device *device;
+                std::vector<Frame> frames;
+            };
+        }
+    }
+}
+
+#endif //LIGHTFIELDFORWARDRENDERER_INSTANCEBUFFER_H
@@ -0,0 +1,628 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace Util {
+    namespace Renderer {
+        namespace MeshOptimizer {
+            namespace {
+                // Tuning constants from Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+                const float CacheDecayPower = 1.5f;
+                const float LastTriScore = 0.75f;
+                const float ValenceBoostScale = 2.0f;
+                const float ValenceBoostPower = 0.5f;
+
+                float vertexScore(int32_t cachePosition, uint32_t remainingValence, uint32_t cacheSize) {
+                    if (remainingValence == 0) {
+                        // No triangle needs this vertex anymore
+                        return -1.0f;
+                    }
+                    float score = 0.0f;
+                    if (cachePosition >= 0) {
+                        if (cachePosition < 3) {
+                            // Used by the last triangle, a fixed score discourages reusing the same triangle edge over and over
+                            score = LastTriScore;
+                        } else if (static_cast<uint32_t>(cachePosition) < cacheSize) {
+                            const float scaler = 1.0f / static_cast<float>(cacheSize - 3);
+                            score = 1.0f - static_cast<float>(cachePosition - 3) * scaler;
+                            score = powf(score, CacheDecayPower);
+                        }
+                    }
+                    // Bonus for vertices with few remaining triangles, so lone triangles get drawn early
+                    score += ValenceBoostScale * powf(static_cast<float>(remainingValence), -ValenceBoostPower);
+                    return score;
+                }
+
+                struct Vec3 {
+                    float x, y, z;
+                };
+
+                Vec3 loadPosition(const float *positions, size_t positionStride, uint32_t index) {
+                    const float *p = reinterpret_cast<const float *>(reinterpret_cast<const unsigned char *>(positions) + positionStride * index);
+                    return { p[0], p[1], p[2] };
+                }
+            }
+
+            void optimizeVertexCache(uint32_t *indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize) {
+                assert(indexCount % 3 == 0);
+                assert(cacheSize > 3);
+                const size_t triangleCount = indexCount / 3;
+                if (triangleCount == 0 || vertexCount == 0) {
+                    return;
+                }
+
+                // Triangle adjacency per vertex
+                std::vector<uint32_t> valence(vertexCount, 0);
+                for (size_t i = 0; i < indexCount; i++) {
+                    assert(indices[i] < vertexCount);
+                    valence[indices[i]]++;
+                }
+                std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+                for (size_t v = 0; v < vertexCount; v++) {
+                    adjacencyOffsets[v + 1] = adjacencyOffsets[v] + valence[v];
+                }
+                std::vector<uint32_t> adjacency(indexCount);
+                {
+                    std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+                    for (size_t t = 0; t < triangleCount; t++) {
+                        for (size_t k = 0; k < 3; k++) {
+                            adjacency[fill[indices[t * 3 + k]]++] = static_cast<uint32_t>(t);
+                        }
+                    }
+                }
+                // valence is reused as the number of triangles still waiting for each vertex
+
+                std::vector<int32_t> cachePosition(vertexCount, -1);
+                std::vector<float> vertexScores(vertexCount);
+                for (size_t v = 0; v < vertexCount; v++) {
+                    vertexScores[v] = vertexScore(-1, valence[v], cacheSize);
+                }
+
+                std::vector<float> triangleScores(triangleCount);
+                std::vector<bool> emitted(triangleCount, false);
+                for (size_t t = 0; t < triangleCount; t++) {
+                    triangleScores[t] = vertexScores[indices[t * 3 + 0]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+                }
+
+                std::vector<uint32_t> source(indices, indices + indexCount);
+                std::vector<uint32_t> cache;
+                std::vector<uint32_t> newCache;
+                cache.reserve(cacheSize + 3);
+                newCache.reserve(cacheSize + 3);
+
+                size_t outputTriangle = 0;
+                size_t scanCursor = 0;
+                int64_t bestTriangle = -1;
+
+                while (outputTriangle < triangleCount) {
+                    if (bestTriangle < 0) {
+                        // Nothing useful is left in the cache, restart from the first triangle not drawn yet
+                        float bestScore = -1.0f;
+                        while (scanCursor < triangleCount && emitted[scanCursor]) {
+                            scanCursor++;
+                        }
+                        for (size_t t = scanCursor; t < triangleCount && t < scanCursor + 64; t++) {
+                            if (!emitted[t] && triangleScores[t] > bestScore) {
+                                bestScore = triangleScores[t];
+                                bestTriangle = static_cast<int64_t>(t);
+                            }
+                        }
+                        assert(bestTriangle >= 0);
+                    }
+
+                    const auto triangle = static_cast<size_t>(bestTriangle);
+                    const uint32_t *triangleIndices = &source[triangle * 3];
+                    memcpy(&indices[outputTriangle * 3], triangleIndices, 3 * sizeof(uint32_t));
+                    outputTriangle++;
+                    emitted[triangle] = true;
+                    triangleScores[triangle] = -1.0f;
+
+                    // Remove the triangle from the adjacency of its vertices
+                    for (size_t k = 0; k < 3; k++) {
+                        const uint32_t v = triangleIndices[k];
+                        uint32_t *begin = &adjacency[adjacencyOffsets[v]];
+                        uint32_t *end = begin + valence[v];
+                        uint32_t *it = std::find(begin, end, static_cast<uint32_t>(triangle));
+                        assert(it != end);
+                        std::swap(*it, *(end - 1));
+                        valence[v]--;
+                    }
+
+                    // Most recently used vertices move to the front of the cache
+                    newCache.assign(triangleIndices, triangleIndices + 3);
+                    for (uint32_t v : cache) {
+                        if (v != triangleIndices[0] && v != triangleIndices[1] && v != triangleIndices[2]) {
+                            newCache.push_back(v);
+                        }
+                    }
+                    for (size_t i = 0; i < newCache.size(); i++) {
+                        cachePosition[newCache[i]] = i < cacheSize ? static_cast<int32_t>(i) : -1;
+                    }
+
+                    // Rescore everything touched by the cache update and pick the next triangle among them
+                    bestTriangle = -1;
+                    float bestScore = -1.0f;
+                    for (uint32_t v : newCache) {
+                        const float score = vertexScore(cachePosition[v], valence[v], cacheSize);
+                        const float delta = score - vertexScores[v];
+                        vertexScores[v] = score;
+                        for (uint32_t a = 0; a < valence[v]; a++) {
+                            const uint32_t t = adjacency[adjacencyOffsets[v] + a];
+                            triangleScores[t] += delta;
+                            if (triangleScores[t] > bestScore) {
+                                bestScore = triangleScores[t];
+                                bestTriangle = t;
+                            }
+                        }
+                    }
+
+                    if (newCache.size() > cacheSize) {
+                        newCache.resize(cacheSize);
+                    }
+                    cache.swap(newCache);
+                }
+            }
+
+            void optimizeOverdraw(uint32_t *indices, size_t indexCount, const float *positions, size_t vertexCount,
+                                  size_t positionStride, float threshold, uint32_t cacheSize) {
+                assert(indexCount % 3 == 0);
+                const size_t triangleCount = indexCount / 3;
+                if (triangleCount == 0 || vertexCount == 0) {
+                    return;
+                }
+
+                // Hard boundaries: triangles where the cache optimizer had to start over (all three vertices miss)
+                std::vector<uint32_t> clusters;
+                {
+                    std::vector<uint32_t> timestamps(vertexCount, 0);
+                    uint32_t timestamp = cacheSize + 1;
+                    for (size_t t = 0; t < triangleCount; t++) {
+                        uint32_t misses = 0;
+                        for (size_t k = 0; k < 3; k++) {
+                            const uint32_t v = indices[t * 3 + k];
+                            if (timestamp - timestamps[v] > cacheSize) {
+                                timestamps[v] = timestamp++;
+                                misses++;
+                            }
+                        }
+                        if (t == 0 || misses == 3) {
+                            clusters.push_back(static_cast<uint32_t>(t));
+                        }
+                    }
+                }
+
+                // Soft boundaries: split hard clusters further wherever the cache efficiency so far stays within threshold
+                std::vector<uint32_t> softClusters;
+                {
+                    std::vector<uint32_t> timestamps(vertexCount, 0);
+                    uint32_t timestamp = 0;
+                    for (size_t c = 0; c < clusters.size(); c++) {
+                        const size_t begin = clusters[c];
+                        const size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+
+                        timestamp += cacheSize + 1;
+                        uint32_t clusterMisses = 0;
+                        for (size_t t = begin; t < end; t++) {
+                            for (size_t k = 0; k < 3; k++) {
+                                const uint32_t v = indices[t * 3 + k];
+                                if (timestamp - timestamps[v] > cacheSize) {
+                                    timestamps[v] = timestamp++;
+                                    clusterMisses++;
+                                }
+                            }
+                        }
+                        const float clusterThreshold = threshold * static_cast<float>(clusterMisses) / static_cast<float>(end - begin);
+
+                        softClusters.push_back(static_cast<uint32_t>(begin));
+                        timestamp += cacheSize + 1;
+                        uint32_t runMisses = 0;
+                        size_t runStart = begin;
+                        for (size_t t = begin; t < end; t++) {
+                            for (size_t k = 0; k < 3; k++) {
+                                const uint32_t v = indices[t * 3 + k];
+                                if (timestamp - timestamps[v] > cacheSize) {
+                                    timestamps[v] = timestamp++;
+                                    runMisses++;
+                                }
+                            }
+                            const size_t runSize = t - runStart + 1;
+                            if (t + 1 < end && static_cast<float>(runMisses) <= clusterThreshold * static_cast<float>(runSize)) {
+                                softClusters.push_back(static_cast<uint32_t>(t + 1));
+                                timestamp += cacheSize + 1;
+                                runMisses = 0;
+                                runStart = t + 1;
+                            }
+                        }
+                    }
+                }
+
+                // Mesh centroid
+                Vec3 meshCentroid{0.0f, 0.0f, 0.0f};
+                for (size_t i = 0; i < indexCount; i++) {
+                    const Vec3 p = loadPosition(positions, positionStride, indices[i]);
+                    meshCentroid.x += p.x;
+                    meshCentroid.y += p.y;
+                    meshCentroid.z += p.z;
+                }
+                meshCentroid.x /= static_cast<float>(indexCount);
+                meshCentroid.y /= static_cast<float>(indexCount);
+                meshCentroid.z /= static_cast<float>(indexCount);
+
+                // Clusters facing away from the mesh center are likely to occlude the rest, so draw them first
+                std::vector<float> sortKeys(softClusters.size());
+                for (size_t c = 0; c < softClusters.size(); c++) {
+                    const size_t begin = softClusters[c];
+                    const size_t end = c + 1 < softClusters.size() ? softClusters[c + 1] : triangleCount;
+
+                    Vec3 centroid{0.0f, 0.0f, 0.0f};
+                    Vec3 normal{0.0f, 0.0f, 0.0f};
+                    float area = 0.0f;
+                    for (size_t t = begin; t < end; t++) {
+                        const Vec3 p0 = loadPosition(positions, positionStride, indices[t * 3 + 0]);
+                        const Vec3 p1 = loadPosition(positions, positionStride, indices[t * 3 + 1]);
+                        const Vec3 p2 = loadPosition(positions, positionStride, indices[t * 3 + 2]);
+                        const Vec3 e1{p1.x - p0.x, p1.y - p0.y, p1.z - p0.z};
+                        const Vec3 e2{p2.x - p0.x, p2.y - p0.y, p2.z - p0.z};
+                        const Vec3 n{e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z, e1.x * e2.y - e1.y * e2.x};
+                        const float a = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+                        centroid.x += (p0.x + p1.x + p2.x) / 3.0f * a;
+                        centroid.y += (p0.y + p1.y + p2.y) / 3.0f * a;
+                        centroid.z += (p0.z + p1.z + p2.z) / 3.0f * a;
+                        normal.x += n.x;
+                        normal.y += n.y;
+                        normal.z += n.z;
+                        area += a;
+                    }
+                    if (area > 0.0f) {
+                        centroid.x /= area;
+                        centroid.y /= area;
+                        centroid.z /= area;
+                    }
+                    const float normalLength = sqrtf(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+                    if (normalLength > 0.0f) {
+                        normal.x /= normalLength;
+                        normal.y /= normalLength;
+                        normal.z /= normalLength;
+                    }
+                    sortKeys[c] = (centroid.x - meshCentroid.x) * normal.x + (centroid.y - meshCentroid.y) * normal.y + (centroid.z - meshCentroid.z) * normal.z;
+                }
+
+                std::vector<uint32_t> order(softClusters.size());
+                for (size_t c = 0; c < order.size(); c++) {
+                    order[c] = static_cast<uint32_t>(c);
+                }
+                std::stable_sort(order.begin(), order.end(), [&sortKeys](uint32_t a, uint32_t b) {
+                    return sortKeys[a] > sortKeys[b];
+                });
+
+                std::vector<uint32_t> source(indices, indices + indexCount);
+                size_t offset = 0;
+                for (uint32_t c : order) {
+                    const size_t begin = softClusters[c];
+                    const size_t end = c + 1 < softClusters.size() ? softClusters[c + 1] : triangleCount;
+                    memcpy(&indices[offset], &source[begin * 3], (end - begin) * 3 * sizeof(uint32_t));
+                    offset += (end - begin) * 3;
+                }
+                assert(offset == indexCount);
+            }
+
+            size_t buildVertexFetchRemap(std::vector<uint32_t> &remap, const uint32_t *indices, size_t indexCount, size_t vertexCount) {
+                remap.assign(vertexCount, UINT32_MAX);
+                uint32_t next = 0;
+                for (size_t i = 0; i < indexCount; i++) {
+                    assert(indices[i] < vertexCount);
+                    if (remap[indices[i]] == UINT32_MAX) {
+                        remap[indices[i]] = next++;
+                    }
+                }
+                const size_t referenced = next;
+                // Keep unreferenced vertices so that the vertex range of the primitive is unchanged
+                for (size_t v = 0; v < vertexCount; v++) {
+                    if (remap[v] == UINT32_MAX) {
+                        remap[v] = next++;
+                    }
+                }
+                return referenced;
+            }
+
+            void remapIndices(uint32_t *indices, size_t indexCount, const std::vector<uint32_t> &remap) {
+                for (size_t i = 0; i < indexCount; i++) {
+                    indices[i] = remap[indices[i]];
+                }
+            }
+
+            namespace {
+                /** @brief Symmetric 4x4 error quadric (upper triangle) with the accumulated area weight */
+                struct Quadric {
+                    double a00 = 0.0, a01 = 0.0, a02 = 0.0, a03 = 0.0;
+                    double a11 = 0.0, a12 = 0.0, a13 = 0.0;
+                    double a22 = 0.0, a23 = 0.0;
+                    double a33 = 0.0;
+                    double weight = 0.0;
+
+                    void addPlane(double a, double b, double c, double d, double w) {
+                        a00 += w * a * a; a01 += w * a * b; a02 += w * a * c; a03 += w * a * d;
+                        a11 += w * b * b; a12 += w * b * c; a13 += w * b * d;
+                        a22 += w * c * c; a23 += w * c * d;
+                        a33 += w * d * d;
+                        weight += w;
+                    }
+
+                    void add(const Quadric &q) {
+                        a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+                        a11 += q.a11; a12 += q.a12; a13 += q.a13;
+                        a22 += q.a22; a23 += q.a23;
+                        a33 += q.a33;
+                        weight += q.weight;
+                    }
+
+                    // Sum of the weighted squared plane distances of p
+                    double evaluate(const Vec3 &p) const {
+                        const double x = p.x, y = p.y, z = p.z;
+                        return a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z + 2.0 * a03 * x
+                               + a11 * y * y + 2.0 * a12 * y * z + 2.0 * a13 * y
+                               + a22 * z * z + 2.0 * a23 * z
+                               + a33;
+                    }
+                };
+
+                struct Collapse {
+                    uint32_t from;
+                    uint32_t to;
+                    float error;
+                };
+
+                Vec3 sub(const Vec3 &a, const Vec3 &b) {
+                    return { a.x - b.x, a.y - b.y, a.z - b.z };
+                }
+
+                Vec3 cross(const Vec3 &a, const Vec3 &b) {
+                    return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+                }
+
+                float dot(const Vec3 &a, const Vec3 &b) {
+                    return a.x * b.x + a.y * b.y + a.z * b.z;
+                }
+            }
+
+            size_t simplify(uint32_t *destination, const uint32_t *indices, size_t indexCount, const float *positions,
+                            size_t vertexCount, size_t positionStride, size_t targetIndexCount, float targetError,
+                            float *resultError) {
+                assert(indexCount % 3 == 0);
+                std::vector<uint32_t> current(indices, indices + indexCount);
+                double maxError = 0.0;
+
+                std::vector<Vec3> points(vertexCount);
+                for (size_t v = 0; v < vertexCount; v++) {
+                    points[v] = loadPosition(positions, positionStride, static_cast<uint32_t>(v));
+                }
+
+                // Weld vertices sharing a position, split vertices along UV/normal seams must move together or not at all
+                std::vector<uint32_t> weld(vertexCount);
+                std::vector<uint8_t> locked(vertexCount, 0);
+                {
+                    std::vector<uint32_t> order(vertexCount);
+                    for (size_t v = 0; v < vertexCount; v++) {
+                        order[v] = static_cast<uint32_t>(v);
+                    }
+                    auto less = [&](uint32_t a, uint32_t b) {
+                        const Vec3 &pa = points[a], &pb = points[b];
+                        if (pa.x != pb.x) return pa.x < pb.x;
+                        if (pa.y != pb.y) return pa.y < pb.y;
+                        return pa.z < pb.z;
+                    };
+                    std::sort(order.begin(), order.end(), less);
+                    for (size_t i = 0; i < vertexCount;) {
+                        size_t j = i + 1;
+                        while (j < vertexCount && !less(order[i], order[j])) {
+                            j++;
+                        }
+                        for (size_t k = i; k < j; k++) {
+                            weld[order[k]] = order[i];
+                            locked[order[k]] = j - i > 1;
+                        }
+                        i = j;
+                    }
+                }
+
+                // Lock open borders and non-manifold edges: every directed edge needs exactly one opposite twin
+                {
+                    std::vector<uint64_t> edges;
+                    edges.reserve(indexCount);
+                    for (size_t i = 0; i < indexCount; i += 3) {
+                        for (int e = 0; e < 3; e++) {
+                            const uint64_t a = weld[current[i + e]], b = weld[current[i + (e + 1) % 3]];
+                            edges.push_back(a << 32 | b);
+                        }
+                    }
+                    std::sort(edges.begin(), edges.end());
+                    std::vector<uint8_t> borderWeld(vertexCount, 0);
+                    for (size_t i = 0; i < edges.size();) {
+                        size_t j = i + 1;
+                        while (j < edges.size() && edges[j] == edges[i]) {
+                            j++;
+                        }
+                        const uint64_t a = edges[i] >> 32, b = edges[i] & 0xffffffffull;
+                        const uint64_t twin = b << 32 | a;
+                        auto range = std::equal_range(edges.begin(), edges.end(), twin);
+                        if (j - i != 1 || range.second - range.first != 1) {
+                            borderWeld[a] = borderWeld[b] = 1;
+                        }
+                        i = j;
+                    }
+                    for (size_t v = 0; v < vertexCount; v++) {
+                        locked[v] |= borderWeld[weld[v]];
+                    }
+                }
+
+                // Area weighted plane quadrics, accumulated per welded position
+                std::vector<Quadric> quadrics(vertexCount);
+                for (size_t i = 0; i < indexCount; i += 3) {
+                    const Vec3 &p0 = points[current[i]], &p1 = points[current[i + 1]], &p2 = points[current[i + 2]];
+                    Vec3 n = cross(sub(p1, p0), sub(p2, p0));
+                    const float length = sqrtf(dot(n, n));
+                    if (length == 0.0f) {
+                        continue;
+                    }
+                    n = { n.x / length, n.y / length, n.z / length };
+                    const double d = -dot(n, p0);
+                    const double area = 0.5 * length;
+                    for (int k = 0; k < 3; k++) {
+                        quadrics[weld[current[i + k]]].addPlane(n.x, n.y, n.z, d, area);
+                    }
+                }
+
+                auto collapseError = [&](uint32_t from, uint32_t to) {
+                    Quadric q = quadrics[weld[from]];
+                    q.add(quadrics[weld[to]]);
+                    // Mean squared distance to the merged planes
+                    return q.weight > 0.0 ? static_cast<float>(std::max(q.evaluate(points[to]) / q.weight, 0.0)) : 0.0f;
+                };
+
+                const float errorLimit = targetError * targetError;
+                std::vector<uint32_t> remap(vertexCount);
+                std::vector<uint8_t> touched(vertexCount);
+                std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+                std::vector<uint32_t> adjacency;
+                std::vector<Collapse> collapses;
+
+                while (current.size() > targetIndexCount) {
+                    const size_t triangleCount = current.size() / 3;
+
+                    // Vertex to triangle adjacency of the current index list
+                    std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+                    for (uint32_t index : current) {
+                        adjacencyOffsets[index + 1]++;
+                    }
+                    for (size_t v = 0; v < vertexCount; v++) {
+                        adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+                    }
+                    adjacency.resize(current.size());
+                    {
+                        std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+                        for (size_t i = 0; i < current.size(); i++) {
+                            adjacency[fill[current[i]]++] = static_cast<uint32_t>(i / 3);
+                        }
+                    }
+
+                    // Cheapest direction of every edge that has a movable end
+                    collapses.clear();
+                    for (size_t t = 0; t < triangleCount; t++) {
+                        for (int e = 0; e < 3; e++) {
+                            const uint32_t a = current[t * 3 + e], b = current[t * 3 + (e + 1) % 3];
+                            // Each interior edge is seen twice, only take it from one side
+                            if (weld[a] > weld[b] || (locked[a] && locked[b])) {
+                                continue;
+                            }
+                            const float ab = locked[a] ? INFINITY : collapseError(a, b);
+                            const float ba = locked[b] ? INFINITY : collapseError(b, a);
+                            collapses.push_back(ab <= ba ? Collapse{ a, b, ab } : Collapse{ b, a, ba });
+                        }
+                    }
+                    if (collapses.empty()) {
+                        break;
+                    }
+                    std::sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b) {
+                        return a.error < b.error;
+                    });
+
+                    for (size_t v = 0; v < vertexCount; v++) {
+                        remap[v] = static_cast<uint32_t>(v);
+                    }
+                    std::fill(touched.begin(), touched.end(), 0);
+                    const size_t trianglesToRemove = (current.size() - targetIndexCount) / 3 + 1;
+                    size_t removed = 0;
+                    size_t applied = 0;
+
+                    for (const Collapse &collapse : collapses) {
+                        if (collapse.error > errorLimit || removed >= trianglesToRemove) {
+                            break;
+                        }
+                        const uint32_t from = collapse.from, to = collapse.to;
+                        if (touched[weld[from]] || touched[weld[to]]) {
+                            continue;
+                        }
+                        // Reject collapses that fold a triangle of the fan over
+                        bool flips = false;
+                        size_t fanRemoved = 0;
+                        for (uint32_t k = adjacencyOffsets[from]; k < adjacencyOffsets[from + 1] && !flips; k++) {
+                            const uint32_t *tri = &current[adjacency[k] * 3];
+                            if (weld[tri[0]] == weld[to] || weld[tri[1]] == weld[to] || weld[tri[2]] == weld[to]) {
+                                fanRemoved++;
+                                continue;
+                            }
+                            Vec3 before[3], after[3];
+                            for (int c = 0; c < 3; c++) {
+                                before[c] = points[tri[c]];
+                                after[c] = tri[c] == from ? points[to] : points[tri[c]];
+                            }
+                            const Vec3 n0 = cross(sub(before[1], before[0]), sub(before[2], before[0]));
+                            const Vec3 n1 = cross(sub(after[1], after[0]), sub(after[2], after[0]));
+                            flips = dot(n0, n1) <= 0.25f * sqrtf(dot(n0, n0) * dot(n1, n1));
+                        }
+                        if (flips) {
+                            continue;
+                        }
+
+                        remap[from] = to;
+                        quadrics[weld[to]].add(quadrics[weld[from]]);
+                        // Freeze the whole fan for this pass, the flip test above assumed its vertices stay in place
+                        for (uint32_t k = adjacencyOffsets[from]; k < adjacencyOffsets[from + 1]; k++) {
+                            const uint32_t *tri = &current[adjacency[k] * 3];
+                            touched[weld[tri[0]]] = touched[weld[tri[1]]] = touched[weld[tri[2]]] = 1;
+                        }
+                        maxError = std::max(maxError, static_cast<double>(collapse.error));
+                        removed += fanRemoved;
+                        applied++;
+                    }
+                    if (applied == 0) {
+                        break;
+                    }
+
+                    // Rebuild the index list without the triangles that became degenerate
+                    size_t write = 0;
+                    for (size_t i = 0; i < current.size(); i += 3) {
+                        const uint32_t a = remap[current[i]], b = remap[current[i + 1]], c = remap[current[i + 2]];
+                        if (weld[a] == weld[b] || weld[b] == weld[c] || weld[a] == weld[c]) {
+                            continue;
+                        }
+                        current[write++] = a;
+                        current[write++] = b;
+                        current[write++] = c;
+                    }
+                    current.resize(write);
+                }
+
+                std::copy(current.begin(), current.end(), destination);
+                if (resultError) {
+                    *resultError = static_cast<float>(sqrt(maxError));
+                }
+                return current.size();
+            }
+
+            float analyzeVertexCache(const uint32_t *indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize) {
+                if (indexCount < 3) {
+                    return 0.0f;
+                }
+                std::vector<uint32_t> timestamps(vertexCount, 0);
+                uint32_t timestamp = cacheSize + 1;
+                size_t misses = 0;
+                for (size_t i = 0; i < indexCount; i++) {
+                    const uint32_t v = indices[i];
+                    if (timestamp - timestamps[v] > cacheSize) {
+                        timestamps[v] = timestamp++;
+                        misses++;
+                    }
+                }
+                return static_cast<float>(misses) / static_cast<float>(indexCount / 3);
+            }
+        }
+    }
+}
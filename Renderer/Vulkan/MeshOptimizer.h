@@ -0,0 +1,76 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef LIGHTFIELDFORWARDRENDERER_MESHOPTIMIZER_H
+#define LIGHTFIELDFORWARDRENDERER_MESHOPTIMIZER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace Util {
+    namespace Renderer {
+        namespace MeshOptimizer {
+            /*
+                Load time index/vertex reordering for indexed triangle lists.
+                All indices passed to these functions are local to the vertex range they describe (0 .. vertexCount-1).
+            */
+
+            /** @brief Reorders triangles for post-transform vertex cache locality (Forsyth's linear-speed algorithm) */
+            void optimizeVertexCache(uint32_t *indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = 32);
+
+            /**
+            * Reorders clusters of cache optimized triangles so the outer surface tends to be drawn first, reducing overdraw
+            *
+            * @param indices Index list already optimized by optimizeVertexCache
+            * @param positions Pointer to the first vertex position (3 floats)
+            * @param positionStride Byte distance between two consecutive positions
+            * @param threshold Allowed ACMR degradation factor when splitting into clusters (1.05 keeps nearly all of the cache gains)
+            */
+            void optimizeOverdraw(uint32_t *indices, size_t indexCount, const float *positions, size_t vertexCount,
+                                  size_t positionStride, float threshold = 1.05f, uint32_t cacheSize = 32);
+
+            /**
+            * Builds a remap table that orders vertices by first use in the index list, for linear vertex fetch
+            *
+            * @return Number of referenced vertices; unreferenced vertices are moved behind them
+            */
+            size_t buildVertexFetchRemap(std::vector<uint32_t> &remap, const uint32_t *indices, size_t indexCount, size_t vertexCount);
+
+            /** @brief Applies a remap table produced by buildVertexFetchRemap to an index list */
+            void remapIndices(uint32_t *indices, size_t indexCount, const std::vector<uint32_t> &remap);
+
+            /** @brief Applies a remap table produced by buildVertexFetchRemap to an array of vertices of any type */
+            template<typename T>
+            void remapVertices(T *vertices, size_t vertexCount, const std::vector<uint32_t> &remap) {
+                std::vector<T> source(vertices, vertices + vertexCount);
+                for (size_t i = 0; i < vertexCount; i++) {
+                    vertices[remap[i]] = source[i];
+                }
+            }
+
+            /**
+            * Quadric error metric edge collapse simplification
+            *
+            * Collapses edges onto existing vertices, so the result indexes the same vertex data as the input.
+            * Vertices on open borders and on attribute seams (same position, different attributes) are never moved.
+            *
+            * @param destination Receives the simplified index list (may alias indices)
+            * @param targetIndexCount Simplification stops once the index count drops to this value
+            * @param targetError Simplification stops before exceeding this error, in the units of the positions
+            * @param resultError (Optional) Receives the largest error introduced, in the units of the positions
+            *
+            * @return Index count of the simplified list
+            */
+            size_t simplify(uint32_t *destination, const uint32_t *indices, size_t indexCount, const float *positions,
+                            size_t vertexCount, size_t positionStride, size_t targetIndexCount, float targetError,
+                            float *resultError = nullptr);
+
+            /** @brief Average number of vertex shader invocations per triangle for a FIFO cache of the given size */
+            float analyzeVertexCache(const uint32_t *indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = 32);
+        }
+    }
+}
+
+#endif //LIGHTFIELDFORWARDRENDERER_MESHOPTIMIZER_H
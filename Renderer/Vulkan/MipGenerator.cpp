@@ -0,0 +1,169 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#include "MipGenerator.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+
+#include "CommonHelper.h"
+#include "Device.h"
+#include "Initializers.h"
+
+namespace Util {
+    namespace Renderer {
+        namespace {
+            constexpr uint32_t groupSize = 16;
+            // Source and destination bindings of one dispatch
+            constexpr uint32_t bindingCount = MipGenerator::levelsPerDispatch + 1;
+        }
+
+        MipGenerator::MipGenerator(Device *_device, const std::string &shaderPath)
+            : device(_device) {
+            VkDevice logicalDevice = device->getLogicalDevice();
+            std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings;
+            for (uint32_t binding = 0; binding < bindingCount; binding++) {
+                setLayoutBindings.push_back(Initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, binding));
+            }
+            VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = Initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+            VK_CHECK_RESULT(vkCreateDescriptorSetLayout(logicalDevice, &descriptorLayoutCI, nullptr, &descriptorSetLayout))
+            descriptorAllocator.init(logicalDevice, 64, { { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, static_cast<float>(bindingCount) } });
+
+            VkPushConstantRange pushConstantRange = Initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstants), 0);
+            VkPipelineLayoutCreateInfo pipelineLayoutCI = Initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+            pipelineLayoutCI.pushConstantRangeCount = 1;
+            pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+            VK_CHECK_RESULT(vkCreatePipelineLayout(logicalDevice, &pipelineLayoutCI, nullptr, &pipelineLayout))
+
+            if (!std::filesystem::exists(shaderPath)) {
+                // supports stays false, every chain is blitted
+                fprintf(stderr, "MipGenerator: could not load %s, mip levels are generated with blits\n", shaderPath.c_str());
+                return;
+            }
+            VkComputePipelineCreateInfo pipelineCI = Initializers::computePipelineCreateInfo(pipelineLayout);
+            pipelineCI.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            pipelineCI.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+            pipelineCI.stage.module = tools::loadShader(shaderPath.c_str(), logicalDevice);
+            pipelineCI.stage.pName = "main";
+            VK_CHECK_RESULT(vkCreateComputePipelines(logicalDevice, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &pipeline))
+            vkDestroyShaderModule(logicalDevice, pipelineCI.stage.module, nullptr);
+        }
+
+        MipGenerator::~MipGenerator() {
+            reset();
+            descriptorAllocator.destroy();
+            VkDevice logicalDevice = device->getLogicalDevice();
+            if (pipeline != VK_NULL_HANDLE) {
+                vkDestroyPipeline(logicalDevice, pipeline, nullptr);
+            }
+            vkDestroyPipelineLayout(logicalDevice, pipelineLayout, nullptr);
+            vkDestroyDescriptorSetLayout(logicalDevice, descriptorSetLayout, nullptr);
+        }
+
+        VkFormat MipGenerator::storageFormat(VkFormat format) {
+            return format == VK_FORMAT_R8G8B8A8_SRGB ? VK_FORMAT_R8G8B8A8_UNORM : format;
+        }
+
+        bool MipGenerator::supports(VkFormat format) const {
+            if (pipeline == VK_NULL_HANDLE || (format != VK_FORMAT_R8G8B8A8_UNORM && format != VK_FORMAT_R8G8B8A8_SRGB)) {
+                return false;
+            }
+            VkFormatProperties formatProperties;
+            vkGetPhysicalDeviceFormatProperties(device->getPhysicalDevice(), storageFormat(format), &formatProperties);
+            return (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) != 0;
+        }
+
+        void MipGenerator::record(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, uint32_t width, uint32_t height,
+                                  uint32_t firstLevel, uint32_t levelCount, bool srgb) {
+            VkDevice logicalDevice = device->getLogicalDevice();
+            const VkFormat viewFormat = storageFormat(format);
+
+            // Uploaded levels become sources, the rest storage targets
+            VkImageMemoryBarrier barriers[2];
+            barriers[0] = Initializers::imageMemoryBarrier();
+            barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barriers[0].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            barriers[0].image = image;
+            barriers[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, firstLevel, 0, 1 };
+            barriers[1] = barriers[0];
+            barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barriers[1].srcAccessMask = 0;
+            barriers[1].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            barriers[1].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, firstLevel, levelCount - firstLevel, 0, 1 };
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 2, barriers);
+
+            // One view per level from the last uploaded one on
+            const size_t firstView = views.size();
+            for (uint32_t level = firstLevel - 1; level < levelCount; level++) {
+                VkImageViewCreateInfo viewInfo = Initializers::imageViewCreateInfo();
+                viewInfo.image = image;
+                viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+                viewInfo.format = viewFormat;
+                viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+                VkImageView view;
+                VK_CHECK_RESULT(vkCreateImageView(logicalDevice, &viewInfo, nullptr, &view))
+                views.push_back(view);
+            }
+            auto levelView = [&](uint32_t level) { return views[firstView + level - (firstLevel - 1)]; };
+
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+            for (uint32_t level = firstLevel; level < levelCount; level += levelsPerDispatch) {
+                const uint32_t count = std::min(levelsPerDispatch, levelCount - level);
+                if (level > firstLevel) {
+                    // The previous dispatch wrote this one's source
+                    VkMemoryBarrier memoryBarrier = Initializers::memoryBarrier();
+                    memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+                    memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+                }
+
+                VkDescriptorSet descriptorSet;
+                VK_CHECK_RESULT(descriptorAllocator.allocate(descriptorSetLayout, &descriptorSet))
+                VkDescriptorImageInfo imageInfos[bindingCount];
+                imageInfos[0] = Initializers::descriptorImageInfo(VK_NULL_HANDLE, levelView(level - 1), VK_IMAGE_LAYOUT_GENERAL);
+                for (uint32_t i = 0; i < levelsPerDispatch; i++) {
+                    // Unused bindings repeat the last level, the shader never writes them
+                    imageInfos[i + 1] = Initializers::descriptorImageInfo(VK_NULL_HANDLE, levelView(level + std::min(i, count - 1)), VK_IMAGE_LAYOUT_GENERAL);
+                }
+                VkWriteDescriptorSet writeDescriptorSets[bindingCount];
+                for (uint32_t binding = 0; binding < bindingCount; binding++) {
+                    writeDescriptorSets[binding] = Initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, binding, &imageInfos[binding]);
+                }
+                vkUpdateDescriptorSets(logicalDevice, bindingCount, writeDescriptorSets, 0, nullptr);
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+
+                PushConstants pushConstants{};
+                pushConstants.sourceSize[0] = static_cast<int32_t>(std::max(1u, width >> (level - 1)));
+                pushConstants.sourceSize[1] = static_cast<int32_t>(std::max(1u, height >> (level - 1)));
+                pushConstants.levelCount = count;
+                pushConstants.srgb = srgb || viewFormat != format ? 1 : 0;
+                vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+
+                const uint32_t levelWidth = std::max(1u, width >> level);
+                const uint32_t levelHeight = std::max(1u, height >> level);
+                vkCmdDispatch(commandBuffer, (levelWidth + groupSize - 1) / groupSize, (levelHeight + groupSize - 1) / groupSize, 1);
+            }
+
+            VkImageMemoryBarrier readBarrier = Initializers::imageMemoryBarrier();
+            readBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+            readBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            readBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            readBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            readBarrier.image = image;
+            readBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1 };
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &readBarrier);
+        }
+
+        void MipGenerator::reset() {
+            for (VkImageView view : views) {
+                vkDestroyImageView(device->getLogicalDevice(), view, nullptr);
+            }
+            views.clear();
+            descriptorAllocator.reset();
+        }
+    }
+}
@@ -0,0 +1,73 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef LIGHTFIELDFORWARDRENDERER_MIPGENERATOR_H
+#define LIGHTFIELDFORWARDRENDERER_MIPGENERATOR_H
+
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "DescriptorAllocator.h"
+
+class Device;
+
+namespace Util {
+    namespace Renderer {
+        /*
+            Generates mip chains with a compute shader, up to four levels per dispatch, see Shaders/mipgen.comp
+            Handles 8 bit RGBA images, sRGB formats are written through UNORM views and every sRGB chain is filtered in
+            linear space
+            Level views and descriptor sets of recorded work live until reset
+        */
+        class MipGenerator {
+        public:
+            static constexpr uint32_t levelsPerDispatch = 4;
+
+            explicit MipGenerator(Device *device, const std::string &shaderPath = "Renderer/shader-spv/mipgen-comp.spv");
+
+            ~MipGenerator();
+
+            MipGenerator(const MipGenerator &) = delete;
+
+            MipGenerator &operator=(const MipGenerator &) = delete;
+
+            /** @brief True when images of format can be generated here, callers fall back to blits otherwise */
+            [[nodiscard]] bool supports(VkFormat format) const;
+
+            /** @brief Format the levels are written as, images whose format differs need VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT */
+            static VkFormat storageFormat(VkFormat format);
+
+            /**
+            * Records the generation of levels [firstLevel, levelCount) from level firstLevel - 1
+            *
+            * @note Levels below firstLevel must be in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL after their upload, the rest
+            * undefined, all of them end up in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+            * @param srgb Contents are sRGB encoded, implied by sRGB formats
+            */
+            void record(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, uint32_t width, uint32_t height,
+                        uint32_t firstLevel, uint32_t levelCount, bool srgb);
+
+            /** @brief Frees the views and descriptor sets of everything recorded so far, the work must have completed */
+            void reset();
+
+        private:
+            struct PushConstants {
+                int32_t sourceSize[2];
+                uint32_t levelCount;
+                uint32_t srgb;
+            };
+
+            Device *device;
+            VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+            VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+            VkPipeline pipeline = VK_NULL_HANDLE;
+            DescriptorAllocator descriptorAllocator;
+            std::vector<VkImageView> views;
+        };
+    }
+}
+
+#endif //LIGHTFIELDFORWARDRENDERER_MIPGENERATOR_H
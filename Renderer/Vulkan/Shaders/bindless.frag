@@ -0,0 +1,60 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Fragment shader for BindlessMaterials, the material index is pushed per draw with RenderFlags::PushMaterialIndex
+
+struct MaterialRecord {
+    vec4 baseColorFactor;
+    float metallicFactor;
+    float roughnessFactor;
+    float alphaCutoff;
+    uint alphaMode;
+    uint baseColorTexture;
+    uint metallicRoughnessTexture;
+    uint normalTexture;
+    uint occlusionTexture;
+    uint emissiveTexture;
+    uint padding[3];
+};
+
+layout (std430, set = 1, binding = 0) readonly buffer Materials {
+    MaterialRecord materials[];
+};
+
+layout (set = 1, binding = 1) uniform sampler2D textures[];
+
+// Must match GLTFModel::materialIndexPushOffset, which defaults to Mesh::pushConstantSize (mat4 + uint)
+layout (push_constant) uniform PushConstants {
+    layout (offset = 68) uint materialIndex;
+} primitive;
+
+layout (location = 0) in vec3 inNormal;
+layout (location = 1) in vec3 inColor;
+layout (location = 2) in vec2 inUV;
+layout (location = 3) in vec3 inViewVec;
+layout (location = 4) in vec3 inLightVec;
+
+layout (location = 0) out vec4 outFragColor;
+
+const uint ALPHAMODE_MASK = 1;
+const uint NO_TEXTURE = 0xFFFFFFFFu;
+
+void main()
+{
+    MaterialRecord material = materials[primitive.materialIndex];
+    vec4 color = material.baseColorFactor * vec4(inColor, 1.0);
+    if (material.baseColorTexture != NO_TEXTURE) {
+        color *= texture(textures[nonuniformEXT(material.baseColorTexture)], inUV);
+    }
+    if (material.alphaMode == ALPHAMODE_MASK && color.a < material.alphaCutoff) {
+        discard;
+    }
+
+    vec3 N = normalize(inNormal);
+    vec3 L = normalize(inLightVec);
+    vec3 V = normalize(inViewVec);
+    vec3 R = reflect(-L, N);
+    vec3 diffuse = max(dot(N, L), 0.5) * color.rgb;
+    vec3 specular = pow(max(dot(R, V), 0.0), 16.0) * vec3(0.75) * (1.0 - material.roughnessFactor);
+    outFragColor = vec4(diffuse + specular, color.a);
+}
@@ -0,0 +1,43 @@
+#version 450
+
+// Fragment shader for GPUDrivenRenderer draws, material factors are fetched with the draw's material index
+
+struct MaterialRecord {
+    vec4 baseColorFactor;
+    float metallicFactor;
+    float roughnessFactor;
+    float alphaCutoff;
+    uint alphaMode;
+};
+
+layout (std430, set = 1, binding = 2) readonly buffer Materials {
+    MaterialRecord materials[];
+};
+
+layout (location = 0) in vec3 inNormal;
+layout (location = 1) in vec3 inColor;
+layout (location = 2) in vec2 inUV;
+layout (location = 3) in vec3 inViewVec;
+layout (location = 4) in vec3 inLightVec;
+layout (location = 5) flat in uint inMaterial;
+
+layout (location = 0) out vec4 outFragColor;
+
+const uint ALPHAMODE_MASK = 1;
+
+void main()
+{
+    MaterialRecord material = materials[inMaterial];
+    vec4 color = material.baseColorFactor * vec4(inColor, 1.0);
+    if (material.alphaMode == ALPHAMODE_MASK && color.a < material.alphaCutoff) {
+        discard;
+    }
+
+    vec3 N = normalize(inNormal);
+    vec3 L = normalize(inLightVec);
+    vec3 V = normalize(inViewVec);
+    vec3 R = reflect(-L, N);
+    vec3 diffuse = max(dot(N, L), 0.5) * color.rgb;
+    vec3 specular = pow(max(dot(R, V), 0.0), 16.0) * vec3(0.75) * (1.0 - material.roughnessFactor);
+    outFragColor = vec4(diffuse + specular, color.a);
+}
@@ -0,0 +1,60 @@
+#version 450
+
+// Vertex shader for GPUDrivenRenderer draws, the model matrix and material come from the draw record
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec2 inUV;
+layout (location = 3) in vec3 inColor;
+
+layout (set = 0, binding = 0) uniform UBOScene
+{
+    mat4 projection;
+    mat4 view;
+    vec4 lightPos;
+} uboScene;
+
+struct DrawRecord {
+    vec4 center;
+    vec4 extent;
+    uint firstIndex;
+    uint indexCount;
+    uint matrix;
+    uint material;
+    uint bucket;
+    uint padding[3];
+};
+
+layout (std430, set = 1, binding = 0) readonly buffer DrawRecords {
+    DrawRecord records[];
+};
+
+layout (std430, set = 1, binding = 1) readonly buffer NodeMatrices {
+    mat4 matrices[];
+};
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec3 outColor;
+layout (location = 2) out vec2 outUV;
+layout (location = 3) out vec3 outViewVec;
+layout (location = 4) out vec3 outLightVec;
+layout (location = 5) flat out uint outMaterial;
+
+void main()
+{
+    // firstInstance of each indirect command is the index of its draw record
+    DrawRecord record = records[gl_InstanceIndex];
+    mat4 model = matrices[record.matrix];
+
+    outColor = inColor;
+    outUV = inUV;
+    outMaterial = record.material;
+
+    vec4 pos = uboScene.view * model * vec4(inPos, 1.0);
+    gl_Position = uboScene.projection * pos;
+    outNormal = mat3(uboScene.view * model) * inNormal;
+
+    vec3 lPos = mat3(uboScene.view) * uboScene.lightPos.xyz;
+    outLightVec = lPos - pos.xyz;
+    outViewVec = -pos.xyz;
+}
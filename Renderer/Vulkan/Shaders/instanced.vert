@@ -0,0 +1,49 @@
+#version 450
+
+// Vertex shader for GLTFModel::drawInstanced, the instance transform is applied on top of the node matrix
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec2 inUV;
+layout (location = 3) in vec3 inColor;
+
+// InstanceData, bound at binding 1 with instance input rate
+layout (location = 4) in mat4 instanceTransform;
+layout (location = 8) in vec4 instanceParameters;
+
+layout (set = 0, binding = 0) uniform UBOScene
+{
+    mat4 projection;
+    mat4 view;
+    vec4 lightPos;
+} uboScene;
+
+// Pushed under RenderFlags::PushMeshMatrix, the range covers Mesh::pushConstantSize bytes
+layout (push_constant) uniform PushConstants {
+    mat4 model;
+    uint jointOffset;
+} primitive;
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec3 outColor;
+layout (location = 2) out vec2 outUV;
+layout (location = 3) out vec3 outViewVec;
+layout (location = 4) out vec3 outLightVec;
+layout (location = 5) out vec4 outParameters;
+
+void main()
+{
+    mat4 model = instanceTransform * primitive.model;
+
+    outColor = inColor;
+    outUV = inUV;
+    outParameters = instanceParameters;
+
+    vec4 pos = uboScene.view * model * vec4(inPos, 1.0);
+    gl_Position = uboScene.projection * pos;
+    outNormal = mat3(uboScene.view * model) * inNormal;
+
+    vec3 lPos = mat3(uboScene.view) * uboScene.lightPos.xyz;
+    outLightVec = lPos - pos.xyz;
+    outViewVec = -pos.xyz;
+}
@@ -0,0 +1,29 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+// Fragment shader taking the base color from a VirtualTexture bound to set 1
+// Draws must record VirtualTexture::update before and VirtualTexture::recordFeedbackBarrier after them
+
+#define VIRTUAL_TEXTURE_SET 1
+#include "virtualtexture.glsl"
+
+layout (location = 0) in vec3 inNormal;
+layout (location = 1) in vec3 inColor;
+layout (location = 2) in vec2 inUV;
+layout (location = 3) in vec3 inViewVec;
+layout (location = 4) in vec3 inLightVec;
+
+layout (location = 0) out vec4 outFragColor;
+
+void main()
+{
+    vec4 color = sampleVirtual(inUV) * vec4(inColor, 1.0);
+
+    vec3 N = normalize(inNormal);
+    vec3 L = normalize(inLightVec);
+    vec3 V = normalize(inViewVec);
+    vec3 R = reflect(-L, N);
+    vec3 diffuse = max(dot(N, L), 0.5) * color.rgb;
+    vec3 specular = pow(max(dot(R, V), 0.0), 16.0) * vec3(0.75);
+    outFragColor = vec4(diffuse + specular, color.a);
+}
@@ -0,0 +1,77 @@
+// Sampling side of VirtualTexture, included by fragment shaders with GL_GOOGLE_include_directive
+// Define VIRTUAL_TEXTURE_SET before the include to bind the set elsewhere than set 1
+// Call sampleVirtual from uniform control flow, it takes derivatives to pick the level
+// Define VIRTUAL_TEXTURE_NO_FEEDBACK when VirtualTexture::hasFeedback is false, fragment stores then aren't allowed
+
+#ifndef VIRTUAL_TEXTURE_SET
+#define VIRTUAL_TEXTURE_SET 1
+#endif
+
+const uint VT_NOT_RESIDENT = 0xFFFFFFFFu;
+
+// Atlas of cache slots or the sparse resident image itself
+layout (set = VIRTUAL_TEXTURE_SET, binding = 0) uniform sampler2D virtualPhysical;
+
+// Matches VirtualTexture::PageTableHeader followed by one entry per page, level by level
+layout (std430, set = VIRTUAL_TEXTURE_SET, binding = 1) readonly buffer VirtualPageTable {
+    uvec2 virtualSize;
+    uint pageSize;
+    uint border;
+    uint levelCount;
+    uint slotsPerRow;
+    uint sparse;
+    uint frame;
+    // Pages in x and y and the first entry of every level
+    uvec4 levels[16];
+    uint entries[];
+} virtualPageTable;
+
+#ifndef VIRTUAL_TEXTURE_NO_FEEDBACK
+layout (std430, set = VIRTUAL_TEXTURE_SET, binding = 2) writeonly buffer VirtualFeedback {
+    uint requests[];
+} virtualFeedback;
+#endif
+
+uint virtualPage(uint level, vec2 uv, out vec2 pageTexel) {
+    uvec4 info = virtualPageTable.levels[level];
+    vec2 texel = uv * vec2(max(virtualPageTable.virtualSize >> level, uvec2(1)));
+    uvec2 page = min(uvec2(texel) / virtualPageTable.pageSize, info.xy - 1u);
+    pageTexel = texel - vec2(page * virtualPageTable.pageSize);
+    return info.z + page.y * info.x + page.x;
+}
+
+vec4 sampleVirtual(vec2 uv) {
+    vec2 texel = uv * vec2(virtualPageTable.virtualSize);
+    vec2 dx = dFdx(texel);
+    vec2 dy = dFdy(texel);
+    float lod = clamp(0.5 * log2(max(dot(dx, dx), dot(dy, dy))), 0.0, float(virtualPageTable.levelCount - 1u));
+    uint level = uint(lod);
+    // Repeat addressing, filtering doesn't wrap across the seam
+    uv = fract(uv);
+
+    vec2 pageTexel;
+    uint page = virtualPage(level, uv, pageTexel);
+#ifndef VIRTUAL_TEXTURE_NO_FEEDBACK
+    // One pixel of every 4x4 block reports the page it wants, rotating with the frame
+    uvec2 pixel = uvec2(gl_FragCoord.xy) & 3u;
+    if (pixel.x + pixel.y * 4u == (virtualPageTable.frame & 15u)) {
+        virtualFeedback.requests[page] = 1u;
+    }
+#endif
+
+    // Missing pages fall back to their coarser ancestors, the coarsest level is always resident
+    uint entry = virtualPageTable.entries[page];
+    while (entry == VT_NOT_RESIDENT && level + 1u < virtualPageTable.levelCount) {
+        level++;
+        page = virtualPage(level, uv, pageTexel);
+        entry = virtualPageTable.entries[page];
+    }
+
+    if (virtualPageTable.sparse != 0u) {
+        return textureLod(virtualPhysical, uv, float(level));
+    }
+    uint slotSize = virtualPageTable.pageSize + 2u * virtualPageTable.border;
+    uvec2 slot = uvec2(entry % virtualPageTable.slotsPerRow, entry / virtualPageTable.slotsPerRow);
+    vec2 atlasTexel = vec2(slot * slotSize + virtualPageTable.border) + pageTexel;
+    return textureLod(virtualPhysical, atlasTexel / float(virtualPageTable.slotsPerRow * slotSize), 0.0);
+}
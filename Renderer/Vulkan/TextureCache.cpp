@@ -0,0 +1,186 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#include "TextureCache.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <string_view>
+
+#include "TextureLoader.h"
+
+namespace Util {
+    namespace Renderer {
+        namespace vkglTF {
+            struct TextureCache::Entry {
+                std::string key;
+                Texture texture;
+                VkDeviceSize size;
+                uint32_t references;
+                // Position in unused while references is zero
+                std::list<Entry *>::iterator unusedPosition;
+            };
+
+            TextureCache::Handle::Handle(const Handle &other)
+                : cache(other.cache)
+                , entry(other.entry) {
+                if (entry) {
+                    cache->acquire(entry);
+                }
+            }
+
+            TextureCache::Handle::Handle(Handle &&other) noexcept
+                : cache(other.cache)
+                , entry(other.entry) {
+                other.cache = nullptr;
+                other.entry = nullptr;
+            }
+
+            TextureCache::Handle &TextureCache::Handle::operator=(Handle other) noexcept {
+                std::swap(cache, other.cache);
+                std::swap(entry, other.entry);
+                return *this;
+            }
+
+            TextureCache::Handle::~Handle() {
+                reset();
+            }
+
+            const Texture &TextureCache::Handle::texture() const {
+                return entry->texture;
+            }
+
+            void TextureCache::Handle::reset() {
+                if (entry) {
+                    cache->release(entry);
+                }
+                cache = nullptr;
+                entry = nullptr;
+            }
+
+            TextureCache::TextureCache(VkDeviceSize _budget)
+                : budget(_budget) { }
+
+            TextureCache::~TextureCache() = default;
+
+            TextureCache &TextureCache::global() {
+                static TextureCache cache;
+                return cache;
+            }
+
+            std::string TextureCache::fileKey(const std::string &filename) {
+                std::error_code error;
+                const std::filesystem::path path = std::filesystem::weakly_canonical(filename, error);
+                return "file:" + (error ? filename : path.string());
+            }
+
+            std::string TextureCache::contentKey(const uint8_t *bytes, size_t size) {
+                const size_t hash = std::hash<std::string_view>()(std::string_view(reinterpret_cast<const char *>(bytes), size));
+                char key[48];
+                snprintf(key, sizeof(key), "content:%016llx:%zu", static_cast<unsigned long long>(hash), size);
+                return key;
+            }
+
+            TextureCache::Handle TextureCache::find(const std::string &key) {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto found = entries.find(key);
+                if (found == entries.end()) {
+                    return {};
+                }
+                Entry *entry = found->second.get();
+                if (entry->references++ == 0) {
+                    unused.erase(entry->unusedPosition);
+                }
+                return { this, entry };
+            }
+
+            TextureCache::Handle TextureCache::insert(const std::string &key, const Texture &texture) {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto found = entries.find(key);
+                if (found != entries.end()) {
+                    Entry *entry = found->second.get();
+                    if (entry->texture.image != texture.image) {
+                        texture.destroy();
+                    }
+                    if (entry->references++ == 0) {
+                        unused.erase(entry->unusedPosition);
+                    }
+                    return { this, entry };
+                }
+
+                VkMemoryRequirements memReqs;
+                vkGetImageMemoryRequirements(texture.device->getLogicalDevice(), texture.image, &memReqs);
+                auto entry = std::make_unique<Entry>(Entry{ key, texture, memReqs.size, 1, unused.end() });
+                Entry *inserted = entry.get();
+                entries.emplace(key, std::move(entry));
+                residentBytes += memReqs.size;
+                evict(budget);
+                return { this, inserted };
+            }
+
+            TextureCache::Handle TextureCache::loadFile(const std::string &filename, Device *device, VkQueue copyQueue) {
+                const std::string key = fileKey(filename);
+                Handle handle = find(key);
+                if (handle) {
+                    return handle;
+                }
+                TextureData data;
+                if (!data.loadFile(filename, TranscodeTargets::select(device))) {
+                    fprintf(stderr, "Could not load texture %s\n", filename.c_str());
+                    return {};
+                }
+                Texture texture{};
+                texture.fromTextureData(data, device, copyQueue);
+                return insert(key, texture);
+            }
+
+            void TextureCache::setBudget(VkDeviceSize _budget) {
+                std::lock_guard<std::mutex> lock(mutex);
+                budget = _budget;
+                evict(budget);
+            }
+
+            VkDeviceSize TextureCache::getResidentBytes() const {
+                std::lock_guard<std::mutex> lock(mutex);
+                return residentBytes;
+            }
+
+            size_t TextureCache::size() const {
+                std::lock_guard<std::mutex> lock(mutex);
+                return entries.size();
+            }
+
+            void TextureCache::clear() {
+                std::lock_guard<std::mutex> lock(mutex);
+                evict(0);
+            }
+
+            void TextureCache::acquire(Entry *entry) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (entry->references++ == 0) {
+                    unused.erase(entry->unusedPosition);
+                }
+            }
+
+            void TextureCache::release(Entry *entry) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--entry->references == 0) {
+                    entry->unusedPosition = unused.insert(unused.end(), entry);
+                    evict(budget);
+                }
+            }
+
+            void TextureCache::evict(VkDeviceSize limit) {
+                while (residentBytes > limit && !unused.empty()) {
+                    Entry *entry = unused.front();
+                    unused.pop_front();
+                    residentBytes -= entry->size;
+                    entry->texture.destroy();
+                    const std::string key = entry->key;
+                    entries.erase(key);
+                }
+            }
+        }
+    }
+}
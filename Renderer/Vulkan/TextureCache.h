@@ -0,0 +1,119 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef LIGHTFIELDFORWARDRENDERER_TEXTURECACHE_H
+#define LIGHTFIELDFORWARDRENDERER_TEXTURECACHE_H
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <vulkan/vulkan.h>
+
+class Device;
+
+namespace Util {
+    namespace Renderer {
+        namespace vkglTF {
+            struct Texture;
+
+            /*
+                Resident textures shared by key, a file path or a hash of the encoded contents
+                Handles count references, textures nobody references stay cached and are destroyed least recently
+                used first once the cached textures exceed the budget
+            */
+            class TextureCache {
+                struct Entry;
+
+            public:
+                class Handle {
+                public:
+                    Handle() = default;
+
+                    Handle(const Handle &other);
+
+                    Handle(Handle &&other) noexcept;
+
+                    Handle &operator=(Handle other) noexcept;
+
+                    ~Handle();
+
+                    explicit operator bool() const { return entry != nullptr; }
+
+                    [[nodiscard]] const Texture &texture() const;
+
+                    void reset();
+
+                private:
+                    friend class TextureCache;
+
+                    Handle(TextureCache *_cache, Entry *_entry) : cache(_cache), entry(_entry) { }
+
+                    TextureCache *cache = nullptr;
+                    Entry *entry = nullptr;
+                };
+
+                explicit TextureCache(VkDeviceSize budget = VkDeviceSize(1024) * 1024 * 1024);
+
+                /** @brief Textures still cached are leaked, clear must run while the device is alive */
+                ~TextureCache();
+
+                TextureCache(const TextureCache &) = delete;
+
+                TextureCache &operator=(const TextureCache &) = delete;
+
+                /** @brief Process wide cache, VulkanUtil clears it before destroying the device */
+                static TextureCache &global();
+
+                static std::string fileKey(const std::string &filename);
+
+                static std::string contentKey(const uint8_t *bytes, size_t size);
+
+                /** @brief Returns an empty handle when nothing is cached under key */
+                Handle find(const std::string &key);
+
+                /**
+                * Takes ownership of a resident texture
+                *
+                * @note If another loader cached key first, texture is destroyed and the cached one is returned
+                */
+                Handle insert(const std::string &key, const Texture &texture);
+
+                /** @brief Loads a KTX, KTX2, png or jpg file synchronously unless it is cached */
+                Handle loadFile(const std::string &filename, Device *device, VkQueue copyQueue);
+
+                /** @brief Bytes cached textures may use before unreferenced ones are evicted, referenced textures are never evicted */
+                void setBudget(VkDeviceSize _budget);
+
+                [[nodiscard]] VkDeviceSize getBudget() const { return budget; }
+
+                [[nodiscard]] VkDeviceSize getResidentBytes() const;
+
+                [[nodiscard]] size_t size() const;
+
+                /** @brief Destroys every unreferenced texture */
+                void clear();
+
+            private:
+                mutable std::mutex mutex;
+                std::unordered_map<std::string, std::unique_ptr<Entry>> entries;
+                // Unreferenced entries, least recently released first
+                std::list<Entry *> unused;
+                VkDeviceSize budget;
+                VkDeviceSize residentBytes = 0;
+
+                void acquire(Entry *entry);
+
+                void release(Entry *entry);
+
+                void evict(VkDeviceSize limit);
+            };
+        }
+    }
+}
+
+#endif //LIGHTFIELDFORWARDRENDERER_TEXTURECACHE_H
@@ -0,0 +1,454 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#include "TextureLoader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "stb_image.h"
+
+#include "MipGenerator.h"
+
+// SSSE3 is not part of the x86-64 baseline we build for, the expansion checks for it at runtime
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <tmmintrin.h>
+#define TEXTURE_LOADER_SSSE3 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TEXTURE_LOADER_SSSE3_TARGET
+#else
+#define TEXTURE_LOADER_SSSE3_TARGET __attribute__((target("ssse3")))
+#endif
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define TEXTURE_LOADER_NEON 1
+#endif
+
+namespace Util {
+    namespace Renderer {
+        namespace vkglTF {
+            namespace {
+                // Covers the bufferOffset alignment of every format we upload but R8G8B8, see uploadAlignment
+                constexpr VkDeviceSize stagingAlignment = 16;
+
+                // bufferOffset has to be a multiple of the texel size as well
+                VkDeviceSize uploadAlignment(const TextureData &data) {
+                    return data.format == VK_FORMAT_R8G8B8_UNORM ? 3 * stagingAlignment : stagingAlignment;
+                }
+
+#if defined(TEXTURE_LOADER_SSSE3)
+                bool hasSsse3() {
+#if defined(_MSC_VER)
+                    int info[4];
+                    __cpuid(info, 1);
+                    return (info[2] & (1 << 9)) != 0;
+#else
+                    return __builtin_cpu_supports("ssse3");
+#endif
+                }
+
+                // Expands whole groups of 16 pixels and returns how many were written
+                TEXTURE_LOADER_SSSE3_TARGET size_t expandRgbToRgbaSsse3(const uint8_t *rgb, uint8_t *rgba, size_t pixelCount) {
+                    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+                    const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+                    size_t i = 0;
+                    // The three loads cover the 48 bytes of 16 pixels exactly
+                    for (; i + 16 <= pixelCount; i += 16) {
+                        const auto *source = reinterpret_cast<const __m128i *>(rgb + i * 3);
+                        auto *destination = reinterpret_cast<__m128i *>(rgba + i * 4);
+                        const __m128i a = _mm_loadu_si128(source);
+                        const __m128i b = _mm_loadu_si128(source + 1);
+                        const __m128i c = _mm_loadu_si128(source + 2);
+                        _mm_storeu_si128(destination, _mm_or_si128(_mm_shuffle_epi8(a, shuffle), alpha));
+                        _mm_storeu_si128(destination + 1, _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(b, a, 12), shuffle), alpha));
+                        _mm_storeu_si128(destination + 2, _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(c, b, 8), shuffle), alpha));
+                        _mm_storeu_si128(destination + 3, _mm_or_si128(_mm_shuffle_epi8(_mm_srli_si128(c, 4), shuffle), alpha));
+                    }
+                    return i;
+                }
+#endif
+
+                // Staging memory is usually write combined, so the destination is only ever written front to back
+                void expandRgbToRgba(const uint8_t *rgb, uint8_t *rgba, size_t pixelCount) {
+                    size_t i = 0;
+#if defined(TEXTURE_LOADER_SSSE3)
+                    static const bool ssse3 = hasSsse3();
+                    if (ssse3) {
+                        i = expandRgbToRgbaSsse3(rgb, rgba, pixelCount);
+                    }
+#elif defined(TEXTURE_LOADER_NEON)
+                    for (; i + 16 <= pixelCount; i += 16) {
+                        const uint8x16x3_t source = vld3q_u8(rgb + i * 3);
+                        uint8x16x4_t destination;
+                        destination.val[0] = source.val[0];
+                        destination.val[1] = source.val[1];
+                        destination.val[2] = source.val[2];
+                        destination.val[3] = vdupq_n_u8(0xFF);
+                        vst4q_u8(rgba + i * 4, destination);
+                    }
+#endif
+                    for (; i < pixelCount; i++) {
+                        rgba[i * 4] = rgb[i * 3];
+                        rgba[i * 4 + 1] = rgb[i * 3 + 1];
+                        rgba[i * 4 + 2] = rgb[i * 3 + 2];
+                        rgba[i * 4 + 3] = 0xFF;
+                    }
+                }
+
+                uint32_t fullMipLevels(uint32_t width, uint32_t height) {
+                    return static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+                }
+
+                bool hasExtension(const std::string &filename, const char *extension) {
+                    const size_t dot = filename.find_last_of('.');
+                    return dot != std::string::npos && filename.compare(dot + 1, std::string::npos, extension) == 0;
+                }
+
+                bool sampledFormat(Device *device, VkFormat format) {
+                    VkFormatProperties formatProperties;
+                    vkGetPhysicalDeviceFormatProperties(device->getPhysicalDevice(), format, &formatProperties);
+                    return (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+                }
+
+                // Uncompressed glTF images are sampled as UNORM too, so both paths look the same in our shaders
+                VkFormat linearFormat(VkFormat format) {
+                    switch (format) {
+                        case VK_FORMAT_R8G8B8A8_SRGB: return VK_FORMAT_R8G8B8A8_UNORM;
+                        case VK_FORMAT_BC1_RGB_SRGB_BLOCK: return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+                        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+                        case VK_FORMAT_BC3_SRGB_BLOCK: return VK_FORMAT_BC3_UNORM_BLOCK;
+                        case VK_FORMAT_BC7_SRGB_BLOCK: return VK_FORMAT_BC7_UNORM_BLOCK;
+                        case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK: return VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK;
+                        case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK: return VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK;
+                        case VK_FORMAT_ASTC_4x4_SRGB_BLOCK: return VK_FORMAT_ASTC_4x4_UNORM_BLOCK;
+                        default: return format;
+                    }
+                }
+
+                KTX_error_code transcodeBasis(ktxTexture2 *texture, ktx_transcode_fmt_e target) {
+                    // libktx sets up the transcoder tables on first use without a lock, let one transcode run alone
+                    static std::mutex initializeMutex;
+                    static std::atomic<bool> initialized{ false };
+                    if (initialized) {
+                        return ktxTexture2_TranscodeBasis(texture, target, 0);
+                    }
+                    std::lock_guard<std::mutex> lock(initializeMutex);
+                    const KTX_error_code result = ktxTexture2_TranscodeBasis(texture, target, 0);
+                    initialized = true;
+                    return result;
+                }
+            }
+
+            TranscodeTargets TranscodeTargets::select(Device *device) {
+                const VkPhysicalDeviceFeatures features = device->getEnabledFeatures();
+                TranscodeTargets targets;
+                if (features.textureCompressionBC && sampledFormat(device, VK_FORMAT_BC7_UNORM_BLOCK)) {
+                    targets.color = KTX_TTF_BC7_RGBA;
+                    targets.colorAlpha = KTX_TTF_BC7_RGBA;
+                } else if (features.textureCompressionBC && sampledFormat(device, VK_FORMAT_BC1_RGB_UNORM_BLOCK) &&
+                           sampledFormat(device, VK_FORMAT_BC3_UNORM_BLOCK)) {
+                    targets.color = KTX_TTF_BC1_RGB;
+                    targets.colorAlpha = KTX_TTF_BC3_RGBA;
+                } else if (features.textureCompressionASTC_LDR && sampledFormat(device, VK_FORMAT_ASTC_4x4_UNORM_BLOCK)) {
+                    targets.color = KTX_TTF_ASTC_4x4_RGBA;
+                    targets.colorAlpha = KTX_TTF_ASTC_4x4_RGBA;
+                } else if (features.textureCompressionETC2 && sampledFormat(device, VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK) &&
+                           sampledFormat(device, VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK)) {
+                    // ETC1 data is valid ETC2 RGB
+                    targets.color = KTX_TTF_ETC1_RGB;
+                    targets.colorAlpha = KTX_TTF_ETC2_RGBA;
+                }
+                return targets;
+            }
+
+            bool TextureData::decodeImage(const uint8_t *bytes, size_t size) {
+                int w, h, components;
+                if (!stbi_info_from_memory(bytes, static_cast<int>(size), &w, &h, &components)) {
+                    return false;
+                }
+                // Grey and grey alpha images are widened by stb, RGB is kept until prepareUpload knows whether the device samples it
+                const int requested = components == 3 ? 3 : 4;
+                stbi_uc *decodedPixels = stbi_load_from_memory(bytes, static_cast<int>(size), &w, &h, &components, requested);
+                if (!decodedPixels) {
+                    return false;
+                }
+                const bool result = fromPixels(decodedPixels, static_cast<uint32_t>(w), static_cast<uint32_t>(h), requested);
+                stbi_image_free(decodedPixels);
+                return result;
+            }
+
+            bool TextureData::fromPixels(const uint8_t *data, uint32_t _width, uint32_t _height, uint32_t components) {
+                if (_width == 0 || _height == 0 || (components != 3 && components != 4)) {
+                    return false;
+                }
+                // Many devices can't use R8G8B8, prepareUpload decides once the device is known
+                format = components == 4 ? VK_FORMAT_R8G8B8A8_UNORM : VK_FORMAT_R8G8B8_UNORM;
+                width = _width;
+                height = _height;
+                mipLevels = fullMipLevels(width, height);
+                generateMipmaps = mipLevels > 1;
+                expandRgb = false;
+                levelOffsets = { 0 };
+                pixels.assign(data, data + static_cast<size_t>(width) * height * components);
+                return true;
+            }
+
+            void TextureData::prepareUpload(Device *device, const MipGenerator *mipGenerator) {
+                if (format != VK_FORMAT_R8G8B8_UNORM) {
+                    return;
+                }
+                const bool generatesLevels = generateMipmaps && levelOffsets.size() < mipLevels;
+                // Blits average sRGB values as they are, color images rather take the compute path through RGBA
+                const bool linearFiltering = srgb && generatesLevels && mipGenerator && mipGenerator->supports(VK_FORMAT_R8G8B8A8_UNORM);
+                VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT |
+                                                VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+                if (generatesLevels) {
+                    required |= VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+                }
+                VkFormatProperties formatProperties;
+                vkGetPhysicalDeviceFormatProperties(device->getPhysicalDevice(), format, &formatProperties);
+                if (!linearFiltering && (formatProperties.optimalTilingFeatures & required) == required) {
+                    return;
+                }
+                format = VK_FORMAT_R8G8B8A8_UNORM;
+                expandRgb = true;
+                // Levels are tightly packed, so every offset grows by the same ratio
+                for (VkDeviceSize &offset : levelOffsets) {
+                    offset = offset / 3 * 4;
+                }
+            }
+
+            VkDeviceSize TextureData::stagingSize() const {
+                return expandRgb ? pixels.size() / 3 * 4 : pixels.size();
+            }
+
+            void TextureData::writeStaging(uint8_t *destination) const {
+                if (expandRgb) {
+                    expandRgbToRgba(pixels.data(), destination, pixels.size() / 3);
+                } else {
+                    memcpy(destination, pixels.data(), pixels.size());
+                }
+            }
+
+            bool TextureData::loadKtx(const std::string &filename, const TranscodeTargets &targets) {
+                ktxTexture *ktxTexture;
+                if (ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture) != KTX_SUCCESS) {
+                    return false;
+                }
+                const bool result = fromKtx(ktxTexture, targets);
+                ktxTexture_Destroy(ktxTexture);
+                return result;
+            }
+
+            bool TextureData::loadKtx(const uint8_t *bytes, size_t size, const TranscodeTargets &targets) {
+                ktxTexture *ktxTexture;
+                if (ktxTexture_CreateFromMemory(bytes, size, KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture) != KTX_SUCCESS) {
+                    return false;
+                }
+                const bool result = fromKtx(ktxTexture, targets);
+                ktxTexture_Destroy(ktxTexture);
+                return result;
+            }
+
+            bool TextureData::fromKtx(ktxTexture *ktxTexture, const TranscodeTargets &targets) {
+                if (ktxTexture->classId == ktxTexture2_c && ktxTexture2_NeedsTranscoding(reinterpret_cast<ktxTexture2 *>(ktxTexture))) {
+                    auto *texture2 = reinterpret_cast<ktxTexture2 *>(ktxTexture);
+                    const ktx_transcode_fmt_e target = ktxTexture2_GetNumComponents(texture2) == 4 ? targets.colorAlpha : targets.color;
+                    if (transcodeBasis(texture2, target) != KTX_SUCCESS) {
+                        return false;
+                    }
+                }
+                width = ktxTexture->baseWidth;
+                height = ktxTexture->baseHeight;
+                mipLevels = ktxTexture->numLevels;
+                generateMipmaps = false;
+                format = linearFormat(ktxTexture_GetVkFormat(ktxTexture));
+                if (format == VK_FORMAT_UNDEFINED) {
+                    // KTX1 files without a Vulkan equivalent of their GL format, these used to be read as RGBA8 anyway
+                    format = VK_FORMAT_R8G8B8A8_UNORM;
+                }
+
+                const ktx_uint8_t *ktxTextureData = ktxTexture_GetData(ktxTexture);
+                pixels.assign(ktxTextureData, ktxTextureData + ktxTexture_GetDataSize(ktxTexture));
+                levelOffsets.resize(mipLevels);
+                for (uint32_t i = 0; i < mipLevels; i++) {
+                    ktx_size_t offset;
+                    if (ktxTexture_GetImageOffset(ktxTexture, i, 0, 0, &offset) != KTX_SUCCESS) {
+                        return false;
+                    }
+                    levelOffsets[i] = offset;
+                }
+                return true;
+            }
+
+            bool TextureData::loadFile(const std::string &filename, const TranscodeTargets &targets) {
+                if (hasExtension(filename, "ktx") || hasExtension(filename, "ktx2")) {
+                    return loadKtx(filename, targets);
+                }
+                std::ifstream is(filename, std::ios::binary | std::ios::in | std::ios::ate);
+                if (!is.is_open()) {
+                    return false;
+                }
+                const auto size = static_cast<size_t>(is.tellg());
+                std::vector<uint8_t> bytes(size);
+                is.seekg(0, std::ios::beg);
+                is.read(reinterpret_cast<char *>(bytes.data()), static_cast<std::streamsize>(size));
+                return is.good() && decodeImage(bytes.data(), size);
+            }
+
+            TextureLoader::TextureLoader(Device *_device, VkQueue _transferQueue, ThreadPool &_pool)
+                : device(_device)
+                , transferQueue(_transferQueue)
+                , pool(_pool)
+                , transcodeTargets(TranscodeTargets::select(_device)) { }
+
+            TextureLoader::~TextureLoader() {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [this]() { return decoding == 0; });
+                for (Handle &request : decoded) {
+                    request->state = State::Failed;
+                    request->promise.set_value(false);
+                }
+            }
+
+            TextureLoader::Handle TextureLoader::load(DecodeFunction decode, std::string name) {
+                Handle request = std::make_shared<Request>();
+                request->name = std::move(name);
+                request->resident = request->promise.get_future().share();
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    decoding++;
+                }
+                pool.submit([this, request, decode = std::move(decode)]() {
+                    const bool decodedData = decode(request->data);
+                    if (!decodedData) {
+                        fprintf(stderr, "Could not load texture %s\n", request->name.c_str());
+                    }
+                    request->state = decodedData ? State::Decoded : State::Failed;
+                    // Notify under the lock, the destructor may run as soon as decoding reaches zero
+                    std::lock_guard<std::mutex> lock(mutex);
+                    decoded.push_back(request);
+                    decoding--;
+                    condition.notify_all();
+                });
+                return request;
+            }
+
+            TextureLoader::Handle TextureLoader::loadFile(const std::string &filename) {
+                return load([filename, targets = transcodeTargets](TextureData &data) {
+                    return data.loadFile(filename, targets);
+                }, filename);
+            }
+
+            TextureLoader::Handle TextureLoader::loadEncoded(std::vector<uint8_t> bytes, std::string name) {
+                return load([bytes = std::move(bytes)](TextureData &data) {
+                    return data.decodeImage(bytes.data(), bytes.size());
+                }, std::move(name));
+            }
+
+            size_t TextureLoader::pending() const {
+                std::lock_guard<std::mutex> lock(mutex);
+                return decoding + decoded.size();
+            }
+
+            size_t TextureLoader::update(VkDeviceSize stagingBudget) {
+                std::vector<Handle> batch;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    VkDeviceSize stagingSize = 0;
+                    while (!decoded.empty()) {
+                        const Handle &request = decoded.front();
+                        VkDeviceSize size = 0;
+                        if (request->state == State::Decoded) {
+                            // The generator decides whether color RGB is expanded, which takes more staging memory than its pixels
+                            if (!mipGenerator && request->data.generateMipmaps) {
+                                mipGenerator = std::make_unique<MipGenerator>(device);
+                            }
+                            request->data.prepareUpload(device, mipGenerator.get());
+                            size = request->data.stagingSize();
+                        }
+                        if (!batch.empty() && size > 0 && stagingSize + size > stagingBudget) {
+                            break;
+                        }
+                        stagingSize += size;
+                        batch.push_back(request);
+                        decoded.pop_front();
+                    }
+                }
+                return batch.empty() ? 0 : uploadBatch(batch);
+            }
+
+            size_t TextureLoader::uploadBatch(std::vector<Handle> &batch) {
+                if (!mipGenerator && std::any_of(batch.begin(), batch.end(), [](const Handle &request) {
+                        return request->state == State::Decoded && request->data.generateMipmaps;
+                    })) {
+                    mipGenerator = std::make_unique<MipGenerator>(device);
+                }
+                VkDeviceSize stagingSize = 0;
+                for (const Handle &request : batch) {
+                    if (request->state == State::Decoded) {
+                        request->data.prepareUpload(device, mipGenerator.get());
+                        const VkDeviceSize alignment = uploadAlignment(request->data);
+                        stagingSize = (stagingSize + alignment - 1) / alignment * alignment;
+                        stagingSize += request->data.stagingSize();
+                    }
+                }
+
+                if (stagingSize > 0) {
+                    Buffers staging;
+                    VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                         &staging, stagingSize))
+                    VK_CHECK_RESULT(staging.map())
+                    VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+                    VkDeviceSize offset = 0;
+                    for (const Handle &request : batch) {
+                        if (request->state != State::Decoded) {
+                            continue;
+                        }
+                        const TextureData &data = request->data;
+                        const VkDeviceSize alignment = uploadAlignment(data);
+                        offset = (offset + alignment - 1) / alignment * alignment;
+                        data.writeStaging(static_cast<uint8_t *>(staging.mapped) + offset);
+                        request->texture.create(data, device, mipGenerator.get());
+                        request->texture.recordUpload(copyCmd, staging.buffer, offset, data, mipGenerator.get());
+                        offset += data.stagingSize();
+                    }
+                    // One submission and one wait for the whole batch
+                    device->flushCommandBuffer(copyCmd, transferQueue, true);
+                    if (mipGenerator) {
+                        mipGenerator->reset();
+                    }
+                    staging.unmap();
+                    staging.destroy();
+                }
+
+                for (const Handle &request : batch) {
+                    const bool resident = request->state == State::Decoded;
+                    request->data = TextureData{};
+                    request->state = resident ? State::Resident : State::Failed;
+                    request->promise.set_value(resident);
+                }
+                return batch.size();
+            }
+
+            void TextureLoader::finish() {
+                while (true) {
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        condition.wait(lock, [this]() { return !decoded.empty() || decoding == 0; });
+                        if (decoded.empty()) {
+                            return;
+                        }
+                    }
+                    update();
+                }
+            }
+        }
+    }
+}
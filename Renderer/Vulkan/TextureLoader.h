@@ -0,0 +1,172 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef LIGHTFIELDFORWARDRENDERER_TEXTURELOADER_H
+#define LIGHTFIELDFORWARDRENDERER_TEXTURELOADER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "GLTFModel.h"
+#include "../ThreadPool.h"
+
+namespace Util {
+    namespace Renderer {
+        namespace vkglTF {
+            /*
+                Block formats Basis Universal KTX2 textures are transcoded to, picked from the formats the device can sample
+                BC7 is preferred, then BC1/BC3, ASTC 4x4 and ETC2, uncompressed RGBA when none of them is enabled
+            */
+            struct TranscodeTargets {
+                ktx_transcode_fmt_e color = KTX_TTF_RGBA32;
+                ktx_transcode_fmt_e colorAlpha = KTX_TTF_RGBA32;
+
+                /** @brief Only considers compression features enabled on the device */
+                static TranscodeTargets select(Device *device);
+            };
+
+            /*
+                CPU side texture, decoded on a worker and consumed by Texture::create and Texture::recordUpload
+                Stored levels are tightly packed at levelOffsets, generateMipmaps builds the rest of the chain on the GPU
+            */
+            struct TextureData {
+                VkFormat format = VK_FORMAT_UNDEFINED;
+                uint32_t width = 0;
+                uint32_t height = 0;
+                // Levels of the image, the first levelOffsets.size() of them are stored in pixels
+                uint32_t mipLevels = 1;
+                bool generateMipmaps = false;
+                // Contents are sRGB encoded, generated levels are filtered in linear space
+                bool srgb = false;
+                // pixels hold RGB that is expanded to opaque RGBA while it is written to staging memory, see prepareUpload
+                bool expandRgb = false;
+                std::vector<uint8_t> pixels;
+                std::vector<VkDeviceSize> levelOffsets;
+
+                /** @brief Decodes a png, jpg, bmp, tga or hdr file held in memory to R8G8B8A8 or R8G8B8 with a full generated mip chain */
+                bool decodeImage(const uint8_t *bytes, size_t size);
+
+                /** @brief Takes pixels decoded elsewhere, components is 3 or 4, RGB stays R8G8B8 until prepareUpload */
+                bool fromPixels(const uint8_t *data, uint32_t _width, uint32_t _height, uint32_t components);
+
+                /**
+                * Picks the format uploaded to device, R8G8B8 images fall back to R8G8B8A8 unless the device can sample,
+                * copy to and blit them, must run before Texture::create
+                *
+                * @param mipGenerator Generator the upload will use, sRGB images it can filter are expanded to R8G8B8A8 for it
+                */
+                void prepareUpload(Device *device, const MipGenerator *mipGenerator = nullptr);
+
+                /** @brief Bytes writeStaging writes, levelOffsets index into them */
+                [[nodiscard]] VkDeviceSize stagingSize() const;
+
+                /** @brief Writes the stored levels to mapped staging memory in a single pass, expanding RGB on the way */
+                void writeStaging(uint8_t *destination) const;
+
+                /** @brief Loads all levels of a KTX or KTX2 file, Basis Universal payloads are transcoded to one of targets */
+                bool loadKtx(const std::string &filename, const TranscodeTargets &targets = {});
+
+                bool loadKtx(const uint8_t *bytes, size_t size, const TranscodeTargets &targets = {});
+
+                /** @brief Takes the levels of layer 0 and face 0, transcoding them first when needed */
+                bool fromKtx(ktxTexture *texture, const TranscodeTargets &targets);
+
+                /** @brief Loads KTX and KTX2 files with loadKtx and everything else with decodeImage */
+                bool loadFile(const std::string &filename, const TranscodeTargets &targets = {});
+            };
+
+            /*
+                Loads textures without blocking the calling thread
+                Workers of a ThreadPool read and decode into TextureData, the thread owning the transfer queue uploads
+                finished decodes in batches through one staging buffer and one command buffer per call to update
+                The loader never owns the GPU resources, whoever takes a resident texture destroys it
+            */
+            class TextureLoader {
+            public:
+                enum class State {
+                    Decoding, Decoded, Resident, Failed
+                };
+
+                struct Request {
+                    std::string name;
+                    vkglTF::Texture texture{};
+                    std::atomic<State> state{ State::Decoding };
+                    // Resolves to true once the texture is resident and false when loading failed
+                    std::shared_future<bool> resident;
+
+                    [[nodiscard]] bool isResident() const { return state == State::Resident; }
+
+                private:
+                    friend class TextureLoader;
+                    TextureData data;
+                    std::promise<bool> promise;
+                };
+
+                using Handle = std::shared_ptr<Request>;
+
+                /** @brief Decode function run on a worker, fills the TextureData and returns false on failure */
+                using DecodeFunction = std::function<bool(TextureData &)>;
+
+                TextureLoader(Device *device, VkQueue transferQueue, ThreadPool &pool = ThreadPool::global());
+
+                /** @brief Waits for outstanding decodes, decoded textures that were never uploaded are dropped */
+                ~TextureLoader();
+
+                TextureLoader(const TextureLoader &) = delete;
+
+                TextureLoader &operator=(const TextureLoader &) = delete;
+
+                Handle load(DecodeFunction decode, std::string name);
+
+                Handle loadFile(const std::string &filename);
+
+                /** @brief Decodes an encoded image held in memory, see TextureData::decodeImage */
+                Handle loadEncoded(std::vector<uint8_t> bytes, std::string name);
+
+                /**
+                * Uploads decodes that finished since the last call and resolves their handles, must run on the thread
+                * that owns the transfer queue
+                *
+                * @param stagingBudget Staging bytes used by one batch, at least one texture is uploaded regardless
+                *
+                * @return Number of handles resolved
+                */
+                size_t update(VkDeviceSize stagingBudget = 64 * 1024 * 1024);
+
+                /** @brief Blocks until every queued texture is resident or failed, uploading as decodes finish */
+                void finish();
+
+                /** @brief Textures queued and not resolved yet */
+                [[nodiscard]] size_t pending() const;
+
+                [[nodiscard]] const TranscodeTargets &getTranscodeTargets() const { return transcodeTargets; }
+
+            private:
+                Device *device;
+                VkQueue transferQueue;
+                ThreadPool &pool;
+                TranscodeTargets transcodeTargets;
+                // Created by the first batch that generates mip levels
+                std::unique_ptr<MipGenerator> mipGenerator;
+
+                mutable std::mutex mutex;
+                std::condition_variable condition;
+                std::deque<Handle> decoded;
+                // Requests queued on the pool and not handed to decoded yet
+                size_t decoding = 0;
+
+                size_t uploadBatch(std::vector<Handle> &batch);
+            };
+        }
+    }
+}
+
+#endif //LIGHTFIELDFORWARDRENDERER_TEXTURELOADER_H
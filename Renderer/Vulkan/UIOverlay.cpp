@@ -36,7 +36,6 @@ UIOverlay::UIOverlay()
     , indexBuffer()
     , vertexCount(0)
     , indexCount(0)
-    , descriptorPool()
     , descriptorSet()
     , descriptorSetLayout()
     , pipelineLayout()
@@ -76,12 +75,10 @@ UIOverlay::UIOverlay()
 void UIOverlay::prepareResources() {
     assert(appPtr != nullptr);
     // Initialise descriptor pool and render pass for ImGui.
-    // Descriptor pool
-    std::vector<VkDescriptorPoolSize> poolSizes = {
-            Initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1)
-    };
-    VkDescriptorPoolCreateInfo descriptorPoolInfo = Initializers::descriptorPoolCreateInfo(poolSizes, 2);
-    VK_CHECK_RESULT(vkCreateDescriptorPool(device->getLogicalDevice(), &descriptorPoolInfo, nullptr, &descriptorPool))
+    // Descriptor allocator, the font set and one set per image button texture
+    descriptorAllocator.init(device->getLogicalDevice(), 8, {
+            { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1.0f }
+    });
 
     VkAttachmentDescription attachment = {};
     attachment.format = appPtr->swapChain.colorFormat;
@@ -296,8 +293,7 @@ void UIOverlay::prepareResources() {
     VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->getLogicalDevice(), &descriptorLayout, nullptr, &descriptorSetLayout))
 
     // Descriptor set
-    VkDescriptorSetAllocateInfo allocInfo = Initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
-    VK_CHECK_RESULT(vkAllocateDescriptorSets(device->getLogicalDevice(), &allocInfo, &descriptorSet))
+    VK_CHECK_RESULT(descriptorAllocator.allocate(descriptorSetLayout, &descriptorSet))
     VkDescriptorImageInfo fontDescriptor = Initializers::descriptorImageInfo(
             sampler,
             fontView,
@@ -578,7 +574,8 @@ void UIOverlay::freeResources() {
     vkFreeMemory(device->getLogicalDevice(), fontMemory, nullptr);
     vkDestroySampler(device->getLogicalDevice(), sampler, nullptr);
     vkDestroyDescriptorSetLayout(device->getLogicalDevice(), descriptorSetLayout, nullptr);
-    vkDestroyDescriptorPool(device->getLogicalDevice(), descriptorPool, nullptr);
+    descriptorAllocator.destroy();
+    imageDescriptorSets.clear();
     vkDestroyPipelineLayout(device->getLogicalDevice(), pipelineLayout, nullptr);
     vkDestroyPipeline(device->getLogicalDevice(), pipeline, nullptr);
     if(!uiCmdBuffers.empty()) {
@@ -657,8 +654,15 @@ bool UIOverlay::ImageButton(Texture2D* buttonTexture, const char *formatstr, ...
     string.resize(lengthNeeded + 1);
     vsnprintf(&*string.begin(), lengthNeeded + 1, formatstr, args);
     va_end(args);
-    ImTextureID textureId = ImGui::AddTexture(device->getLogicalDevice(), descriptorSetLayout, descriptorPool,
-            buttonTexture->sampler, buttonTexture->view, buttonTexture->imageLayout);
+    // A set per call would exhaust any pool within a few frames, so each image keeps its set
+    VkDescriptorSet &imageSet = imageDescriptorSets[buttonTexture->view];
+    if (imageSet == VK_NULL_HANDLE) {
+        VK_CHECK_RESULT(descriptorAllocator.allocate(descriptorSetLayout, &imageSet))
+        VkDescriptorImageInfo imageDescriptor = Initializers::descriptorImageInfo(buttonTexture->sampler, buttonTexture->view, buttonTexture->imageLayout);
+        VkWriteDescriptorSet writeDescriptorSet = Initializers::writeDescriptorSet(imageSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptor);
+        vkUpdateDescriptorSets(device->getLogicalDevice(), 1, &writeDescriptorSet, 0, nullptr);
+    }
+    auto textureId = (ImTextureID)imageSet;
     bool res = ImGui::ImageButtonWithText(textureId, &*string.begin());
     if(res) { updated = true; }
     return res;
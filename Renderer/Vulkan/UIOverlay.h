@@ -7,11 +7,13 @@
 
 
 #include <string>
+#include <unordered_map>
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include "Device.h"
 #include "Buffers.h"
+#include "DescriptorAllocator.h"
 
 class Texture2D;
 
@@ -35,7 +37,9 @@ namespace Util {
             uint32_t scaleFactor;
             std::vector<VkPipelineShaderStageCreateInfo> shaders;
 
-            VkDescriptorPool descriptorPool;
+            DescriptorAllocator descriptorAllocator;
+            // Sets of the images shown by ImageButton, created on first use
+            std::unordered_map<VkImageView, VkDescriptorSet> imageDescriptorSets;
             VkDescriptorSetLayout descriptorSetLayout;
             VkDescriptorSet descriptorSet;
             VkPipelineLayout pipelineLayout;
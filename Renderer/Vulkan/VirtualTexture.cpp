@@ -0,0 +1,785 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#include "VirtualTexture.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+#include "stb_image.h"
+
+#include "CommonHelper.h"
+#include "Device.h"
+#include "Initializers.h"
+
+namespace Util {
+    namespace Renderer {
+        namespace {
+            constexpr VkFormat pageFormat = VK_FORMAT_R8G8B8A8_UNORM;
+            constexpr VkImageUsageFlags pageUsage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+            // Slot of pinned pages in the mip tail of a sparse image, the tail has memory of its own
+            constexpr uint32_t mipTailSlot = VirtualTexture::notResident - 1;
+            // Reads in flight per upload an update may make
+            constexpr uint32_t readsPerUpload = 4;
+        }
+
+        bool VirtualTexture::isSparseSupported(Device *device) {
+            const VkPhysicalDeviceFeatures features = device->getEnabledFeatures();
+            if (!features.sparseBinding || !features.sparseResidencyImage2D) {
+                return false;
+            }
+            uint32_t queueFamilyCount = 0;
+            vkGetPhysicalDeviceQueueFamilyProperties(device->getPhysicalDevice(), &queueFamilyCount, nullptr);
+            std::vector<VkQueueFamilyProperties> queueFamilyProperties(queueFamilyCount);
+            vkGetPhysicalDeviceQueueFamilyProperties(device->getPhysicalDevice(), &queueFamilyCount, queueFamilyProperties.data());
+            const uint32_t graphics = device->getQueueFamilyIndex(VK_QUEUE_GRAPHICS_BIT);
+            return (queueFamilyProperties[graphics].queueFlags & VK_QUEUE_SPARSE_BINDING_BIT) != 0;
+        }
+
+        void VirtualTexture::enableFeatures(VkPhysicalDevice physicalDevice, VkPhysicalDeviceFeatures &features) {
+            VkPhysicalDeviceFeatures supported;
+            vkGetPhysicalDeviceFeatures(physicalDevice, &supported);
+            if (supported.fragmentStoresAndAtomics) {
+                features.fragmentStoresAndAtomics = VK_TRUE;
+            }
+            if (supported.sparseBinding && supported.sparseResidencyImage2D) {
+                features.sparseBinding = VK_TRUE;
+                features.sparseResidencyImage2D = VK_TRUE;
+            }
+        }
+
+        VirtualTexture::PageReader VirtualTexture::tileDirectory(const std::string &directory, uint32_t tileBorder, const std::string &extension) {
+            return [directory, tileBorder, extension](uint32_t level, uint32_t x, uint32_t y, uint32_t pageSize, uint32_t border, uint8_t *texels) {
+                if (border > tileBorder) {
+                    return false;
+                }
+                const std::string filename = directory + "/" + std::to_string(level) + "/" + std::to_string(x) + "_" + std::to_string(y) + "." + extension;
+                int w, h, components;
+                stbi_uc *tile = stbi_load(filename.c_str(), &w, &h, &components, 4);
+                if (!tile) {
+                    return false;
+                }
+                const uint32_t tileSize = pageSize + 2 * tileBorder;
+                const bool result = static_cast<uint32_t>(w) == tileSize && static_cast<uint32_t>(h) == tileSize;
+                if (result) {
+                    // Crop the baked border down to the one asked for
+                    const uint32_t size = pageSize + 2 * border;
+                    const uint32_t skip = tileBorder - border;
+                    for (uint32_t row = 0; row < size; row++) {
+                        memcpy(texels + static_cast<size_t>(row) * size * 4, tile + (static_cast<size_t>(row + skip) * tileSize + skip) * 4, size * 4);
+                    }
+                }
+                stbi_image_free(tile);
+                return result;
+            };
+        }
+
+        VirtualTexture::VirtualTexture(Device *_device, VkQueue _queue, uint32_t frameCount, uint32_t _width, uint32_t _height,
+                                       PageReader _reader, uint32_t cacheSlots, uint32_t _pageSize, ThreadPool &_pool)
+            : device(_device)
+            , queue(_queue)
+            , pool(_pool)
+            , reader(std::move(_reader))
+            , width(_width)
+            , height(_height)
+            , pageSize(_pageSize)
+            , frames(frameCount) {
+            feedback = device->getEnabledFeatures().fragmentStoresAndAtomics == VK_TRUE;
+            if (!feedback) {
+                fprintf(stderr, "VirtualTexture: fragmentStoresAndAtomics is not enabled, only the pinned levels will be resident\n");
+            }
+            createLevels();
+            // The pinned coarsest level needs slots of its own
+            const Level &top = levels.back();
+            cacheSlots = std::max(cacheSlots, top.pagesX * top.pagesY + 1);
+
+            sparse = createSparseImage(cacheSlots);
+            if (!sparse) {
+                createAtlasImage(cacheSlots);
+            }
+            slotPages.assign(cacheSlots, notResident);
+            for (uint32_t slot = cacheSlots; slot > 0; slot--) {
+                freeSlots.push_back(slot - 1);
+            }
+
+            VkImageViewCreateInfo viewInfo = Initializers::imageViewCreateInfo();
+            viewInfo.image = image;
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format = pageFormat;
+            viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, sparse ? levelCount : 1, 0, 1 };
+            VK_CHECK_RESULT(vkCreateImageView(device->getLogicalDevice(), &viewInfo, nullptr, &view))
+
+            // Shaders pick the level themselves and atlas pages carry borders, so plain bilinear filtering suffices
+            VkSamplerCreateInfo samplerInfo = Initializers::samplerCreateInfo();
+            samplerInfo.magFilter = VK_FILTER_LINEAR;
+            samplerInfo.minFilter = VK_FILTER_LINEAR;
+            samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+            samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+            samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+            samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+            samplerInfo.maxLod = sparse ? static_cast<float>(levelCount) : 0.0f;
+            samplerInfo.maxAnisotropy = 1.0f;
+            samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+            VK_CHECK_RESULT(vkCreateSampler(device->getLogicalDevice(), &samplerInfo, nullptr, &sampler))
+
+            loadPinnedPages();
+            createDescriptors();
+        }
+
+        VirtualTexture::~VirtualTexture() {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [this]() { return reading == 0; });
+            }
+            VkDevice logicalDevice = device->getLogicalDevice();
+            for (Frame &frame : frames) {
+                if (frame.feedback.mapped) {
+                    frame.feedback.unmap();
+                }
+                frame.feedback.destroy();
+                if (frame.staging.mapped) {
+                    frame.staging.unmap();
+                }
+                frame.staging.destroy();
+            }
+            pageTable.destroy();
+            descriptorAllocator.destroy();
+            vkDestroyDescriptorSetLayout(logicalDevice, descriptorSetLayout, nullptr);
+            vkDestroySampler(logicalDevice, sampler, nullptr);
+            vkDestroyImageView(logicalDevice, view, nullptr);
+            vkDestroyImage(logicalDevice, image, nullptr);
+            vkFreeMemory(logicalDevice, imageMemory, nullptr);
+            if (mipTailMemory != VK_NULL_HANDLE) {
+                vkFreeMemory(logicalDevice, mipTailMemory, nullptr);
+            }
+            if (bindFence != VK_NULL_HANDLE) {
+                vkDestroyFence(logicalDevice, bindFence, nullptr);
+            }
+        }
+
+        void VirtualTexture::createLevels() {
+            // Levels stop once one page covers the whole texture, farther away it is sampled from that page
+            uint32_t levelWidth = width;
+            uint32_t levelHeight = height;
+            uint32_t pageCount = 0;
+            while (true) {
+                Level level{};
+                level.width = levelWidth;
+                level.height = levelHeight;
+                level.pagesX = (levelWidth + pageSize - 1) / pageSize;
+                level.pagesY = (levelHeight + pageSize - 1) / pageSize;
+                level.firstPage = pageCount;
+                levels.push_back(level);
+                pageCount += level.pagesX * level.pagesY;
+                if ((levelWidth <= pageSize && levelHeight <= pageSize) || levels.size() == maxLevels) {
+                    break;
+                }
+                levelWidth = std::max(1u, levelWidth >> 1);
+                levelHeight = std::max(1u, levelHeight >> 1);
+            }
+            levelCount = static_cast<uint32_t>(levels.size());
+            pages.resize(pageCount);
+            mipTailFirstLevel = levelCount;
+            firstPinnedLevel = levelCount - 1;
+        }
+
+        bool VirtualTexture::createSparseImage(uint32_t cacheSlots) {
+            if (!isSparseSupported(device)) {
+                return false;
+            }
+            VkPhysicalDevice physicalDevice = device->getPhysicalDevice();
+            VkDevice logicalDevice = device->getLogicalDevice();
+
+            // Pages have to be sparse blocks so every page binds on its own
+            uint32_t propertyCount = 0;
+            vkGetPhysicalDeviceSparseImageFormatProperties(physicalDevice, pageFormat, VK_IMAGE_TYPE_2D, VK_SAMPLE_COUNT_1_BIT, pageUsage,
+                                                           VK_IMAGE_TILING_OPTIMAL, &propertyCount, nullptr);
+            std::vector<VkSparseImageFormatProperties> formatProperties(propertyCount);
+            vkGetPhysicalDeviceSparseImageFormatProperties(physicalDevice, pageFormat, VK_IMAGE_TYPE_2D, VK_SAMPLE_COUNT_1_BIT, pageUsage,
+                                                           VK_IMAGE_TILING_OPTIMAL, &propertyCount, formatProperties.data());
+            auto color = std::find_if(formatProperties.begin(), formatProperties.end(), [](const VkSparseImageFormatProperties &properties) {
+                return (properties.aspectMask & VK_IMAGE_ASPECT_COLOR_BIT) != 0;
+            });
+            if (color == formatProperties.end() || color->imageGranularity.width != pageSize || color->imageGranularity.height != pageSize) {
+                return false;
+            }
+
+            // Virtual sizes beyond the image limits are what the atlas is for
+            const VkPhysicalDeviceLimits limits = device->getProperties().limits;
+            const VkImageCreateFlags sparseFlags = VK_IMAGE_CREATE_SPARSE_BINDING_BIT | VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT;
+            VkImageFormatProperties imageFormatProperties;
+            if (width > limits.maxImageDimension2D || height > limits.maxImageDimension2D ||
+                vkGetPhysicalDeviceImageFormatProperties(physicalDevice, pageFormat, VK_IMAGE_TYPE_2D, VK_IMAGE_TILING_OPTIMAL, pageUsage,
+                                                         sparseFlags, &imageFormatProperties) != VK_SUCCESS ||
+                width > imageFormatProperties.maxExtent.width || height > imageFormatProperties.maxExtent.height ||
+                levelCount > imageFormatProperties.maxMipLevels) {
+                return false;
+            }
+
+            VkImageCreateInfo imageCreateInfo = Initializers::imageCreateInfo();
+            imageCreateInfo.flags = sparseFlags;
+            imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageCreateInfo.format = pageFormat;
+            imageCreateInfo.extent = { width, height, 1 };
+            imageCreateInfo.mipLevels = levelCount;
+            imageCreateInfo.arrayLayers = 1;
+            imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageCreateInfo.usage = pageUsage;
+            imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            VK_CHECK_RESULT(vkCreateImage(logicalDevice, &imageCreateInfo, nullptr, &image))
+            auto discardImage = [this, logicalDevice]() {
+                vkDestroyImage(logicalDevice, image, nullptr);
+                image = VK_NULL_HANDLE;
+                return false;
+            };
+
+            // Sparse images reserve address space for every block of every level
+            VkMemoryRequirements memReqs;
+            vkGetImageMemoryRequirements(logicalDevice, image, &memReqs);
+            if (memReqs.size > limits.sparseAddressSpaceSize || memReqs.size > imageFormatProperties.maxResourceSize) {
+                return discardImage();
+            }
+
+            uint32_t requirementCount = 0;
+            vkGetImageSparseMemoryRequirements(logicalDevice, image, &requirementCount, nullptr);
+            std::vector<VkSparseImageMemoryRequirements> requirements(requirementCount);
+            vkGetImageSparseMemoryRequirements(logicalDevice, image, &requirementCount, requirements.data());
+            const VkSparseImageMemoryRequirements *colorRequirements = nullptr;
+            for (const VkSparseImageMemoryRequirements &requirement : requirements) {
+                if (requirement.formatProperties.aspectMask & VK_IMAGE_ASPECT_METADATA_BIT) {
+                    // Metadata would need binding of its own, the atlas does without
+                    colorRequirements = nullptr;
+                    break;
+                }
+                if (requirement.formatProperties.aspectMask & VK_IMAGE_ASPECT_COLOR_BIT) {
+                    colorRequirements = &requirement;
+                }
+            }
+            if (!colorRequirements) {
+                return discardImage();
+            }
+            // Levels smaller than a block share the mip tail, it stays bound and pinned. Devices reporting
+            // VK_SPARSE_IMAGE_FORMAT_ALIGNED_MIP_SIZE_BIT move every level that isn't a multiple of the block size
+            // there, the tail would then hold finer levels than the one the page table pins
+            mipTailFirstLevel = std::min(colorRequirements->imageMipTailFirstLod, levelCount);
+            if (mipTailFirstLevel < levelCount - 1) {
+                mipTailFirstLevel = levelCount;
+                return discardImage();
+            }
+
+            // The alignment of sparse images is their block size, every slot holds one block
+            slotSize = memReqs.alignment;
+            VkMemoryAllocateInfo memAllocInfo = Initializers::memoryAllocateInfo();
+            memAllocInfo.allocationSize = slotSize * cacheSlots;
+            memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            VK_CHECK_RESULT(vkAllocateMemory(logicalDevice, &memAllocInfo, nullptr, &imageMemory))
+
+            VkFenceCreateInfo fenceCreateInfo = Initializers::fenceCreateInfo();
+            VK_CHECK_RESULT(vkCreateFence(logicalDevice, &fenceCreateInfo, nullptr, &bindFence))
+
+            firstPinnedLevel = std::min(mipTailFirstLevel, levelCount - 1);
+            if (mipTailFirstLevel < levelCount) {
+                memAllocInfo.allocationSize = (colorRequirements->imageMipTailSize + slotSize - 1) / slotSize * slotSize;
+                VK_CHECK_RESULT(vkAllocateMemory(logicalDevice, &memAllocInfo, nullptr, &mipTailMemory))
+                VkSparseMemoryBind mipTailBind{};
+                mipTailBind.resourceOffset = colorRequirements->imageMipTailOffset;
+                mipTailBind.size = colorRequirements->imageMipTailSize;
+                mipTailBind.memory = mipTailMemory;
+                bindSparse({}, &mipTailBind);
+            }
+            // Pages are whole blocks, filtering across them reads the neighbouring blocks
+            border = 0;
+            return true;
+        }
+
+        void VirtualTexture::createAtlasImage(uint32_t &cacheSlots) {
+            border = atlasBorder;
+            const uint32_t physicalSize = pageSize + 2 * border;
+            const uint32_t maxSize = device->getProperties().limits.maxImageDimension2D;
+            slotsPerRow = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(cacheSlots))));
+            if (slotsPerRow * physicalSize > maxSize) {
+                slotsPerRow = maxSize / physicalSize;
+                cacheSlots = std::min(cacheSlots, slotsPerRow * slotsPerRow);
+                fprintf(stderr, "VirtualTexture: the atlas is limited to %u cache slots\n", cacheSlots);
+            }
+
+            VkImageCreateInfo imageCreateInfo = Initializers::imageCreateInfo();
+            imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageCreateInfo.format = pageFormat;
+            imageCreateInfo.extent = { slotsPerRow * physicalSize, slotsPerRow * physicalSize, 1 };
+            imageCreateInfo.mipLevels = 1;
+            imageCreateInfo.arrayLayers = 1;
+            imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageCreateInfo.usage = pageUsage;
+            imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            VK_CHECK_RESULT(vkCreateImage(device->getLogicalDevice(), &imageCreateInfo, nullptr, &image))
+
+            VkMemoryRequirements memReqs;
+            vkGetImageMemoryRequirements(device->getLogicalDevice(), image, &memReqs);
+            VkMemoryAllocateInfo memAllocInfo = Initializers::memoryAllocateInfo();
+            memAllocInfo.allocationSize = memReqs.size;
+            memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            VK_CHECK_RESULT(vkAllocateMemory(device->getLogicalDevice(), &memAllocInfo, nullptr, &imageMemory))
+            VK_CHECK_RESULT(vkBindImageMemory(device->getLogicalDevice(), image, imageMemory, 0))
+        }
+
+        void VirtualTexture::createDescriptors() {
+            VkDevice logicalDevice = device->getLogicalDevice();
+            std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+                    Initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+                    Initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),
+                    Initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 2),
+            };
+            VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = Initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+            VK_CHECK_RESULT(vkCreateDescriptorSetLayout(logicalDevice, &descriptorLayoutCI, nullptr, &descriptorSetLayout))
+            descriptorAllocator.init(logicalDevice, static_cast<uint32_t>(frames.size()),
+                                     { { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 }, { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 } });
+
+            // Feedback is read back by the host every frame, cached memory keeps the scan fast
+            VkBool32 cachedFound = VK_FALSE;
+            device->getMemoryType(UINT32_MAX, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
+                                              VK_MEMORY_PROPERTY_HOST_CACHED_BIT, &cachedFound);
+            const VkMemoryPropertyFlags feedbackFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
+                                                        (cachedFound ? VK_MEMORY_PROPERTY_HOST_CACHED_BIT : 0);
+            VkDescriptorImageInfo imageInfo = Initializers::descriptorImageInfo(sampler, view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+            for (Frame &frame : frames) {
+                const VkDeviceSize feedbackSize = pages.size() * sizeof(uint32_t);
+                VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, feedbackFlags, &frame.feedback, feedbackSize))
+                VK_CHECK_RESULT(frame.feedback.map())
+                memset(frame.feedback.mapped, 0, feedbackSize);
+
+                VK_CHECK_RESULT(descriptorAllocator.allocate(descriptorSetLayout, &frame.descriptorSet))
+                std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+                        Initializers::writeDescriptorSet(frame.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageInfo),
+                        Initializers::writeDescriptorSet(frame.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &pageTable.descriptor),
+                        Initializers::writeDescriptorSet(frame.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &frame.feedback.descriptor),
+                };
+                vkUpdateDescriptorSets(logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+            }
+        }
+
+        void VirtualTexture::loadPinnedPages() {
+            std::vector<uint32_t> pinned;
+            for (uint32_t level = firstPinnedLevel; level < levelCount; level++) {
+                for (uint32_t page = levels[level].firstPage; page < levels[level].firstPage + levels[level].pagesX * levels[level].pagesY; page++) {
+                    pinned.push_back(page);
+                }
+            }
+
+            // Pinned pages and the whole page table go through one staging buffer
+            const VkDeviceSize pagesSize = pinned.size() * pageBytes();
+            const VkDeviceSize tableSize = sizeof(PageTableHeader) + pages.size() * sizeof(uint32_t);
+            Buffers staging;
+            VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                 &staging, pagesSize + tableSize))
+            VK_CHECK_RESULT(staging.map())
+            auto *texels = static_cast<uint8_t *>(staging.mapped);
+            pool.parallelFor(pinned.size(), [&](size_t i) {
+                uint32_t level, x, y;
+                pageCoordinates(pinned[i], level, x, y);
+                uint8_t *page = texels + i * pageBytes();
+                if (!reader(level, x, y, pageSize, border, page)) {
+                    fprintf(stderr, "VirtualTexture: could not read pinned page %u of level %u\n", pinned[i], level);
+                    memset(page, 0xFF, pageBytes());
+                }
+            });
+
+            std::vector<VkSparseImageMemoryBind> binds;
+            std::vector<VkBufferImageCopy> copies;
+            for (size_t i = 0; i < pinned.size(); i++) {
+                Page &page = pages[pinned[i]];
+                uint32_t level, x, y;
+                pageCoordinates(pinned[i], level, x, y);
+                page.pinned = true;
+                if (level >= mipTailFirstLevel) {
+                    page.slot = mipTailSlot;
+                } else {
+                    page.slot = freeSlots.back();
+                    freeSlots.pop_back();
+                    slotPages[page.slot] = pinned[i];
+                    if (sparse) {
+                        binds.push_back(sparseBind(pinned[i], page.slot));
+                    }
+                }
+                copies.push_back(pageCopy(pinned[i], page.slot, i * pageBytes()));
+                residentPages++;
+            }
+            if (!binds.empty()) {
+                bindSparse(binds);
+            }
+
+            PageTableHeader header{};
+            header.virtualSize[0] = width;
+            header.virtualSize[1] = height;
+            header.pageSize = pageSize;
+            header.border = border;
+            header.levelCount = levelCount;
+            header.slotsPerRow = slotsPerRow;
+            header.sparse = sparse ? 1 : 0;
+            for (uint32_t level = 0; level < levelCount; level++) {
+                header.levels[level][0] = levels[level].pagesX;
+                header.levels[level][1] = levels[level].pagesY;
+                header.levels[level][2] = levels[level].firstPage;
+            }
+            memcpy(texels + pagesSize, &header, sizeof(header));
+            auto *entries = reinterpret_cast<uint32_t *>(texels + pagesSize + sizeof(header));
+            for (size_t page = 0; page < pages.size(); page++) {
+                entries[page] = pages[page].slot;
+            }
+            staging.unmap();
+
+            VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &pageTable, tableSize))
+
+            VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+            VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, sparse ? levelCount : 1, 0, 1 };
+            tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange,
+                                  VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+            vkCmdCopyBufferToImage(copyCmd, staging.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                   static_cast<uint32_t>(copies.size()), copies.data());
+            VkBufferCopy tableCopy{ pagesSize, 0, tableSize };
+            vkCmdCopyBuffer(copyCmd, staging.buffer, pageTable.buffer, 1, &tableCopy);
+            tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange,
+                                  VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+            VkBufferMemoryBarrier tableBarrier = Initializers::bufferMemoryBarrier();
+            tableBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            tableBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            tableBarrier.buffer = pageTable.buffer;
+            tableBarrier.size = VK_WHOLE_SIZE;
+            vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 1, &tableBarrier, 0, nullptr);
+            device->flushCommandBuffer(copyCmd, queue, true);
+            staging.destroy();
+        }
+
+        void VirtualTexture::pageCoordinates(uint32_t page, uint32_t &level, uint32_t &x, uint32_t &y) const {
+            level = levelCount - 1;
+            while (page < levels[level].firstPage) {
+                level--;
+            }
+            const uint32_t local = page - levels[level].firstPage;
+            x = local % levels[level].pagesX;
+            y = local / levels[level].pagesX;
+        }
+
+        uint32_t VirtualTexture::parentPage(uint32_t page) const {
+            uint32_t level, x, y;
+            pageCoordinates(page, level, x, y);
+            if (level + 1 >= levelCount) {
+                return notResident;
+            }
+            // Odd sizes round the coarser level down, its last page covers the remainder
+            const Level &parent = levels[level + 1];
+            return parent.firstPage + std::min(y >> 1, parent.pagesY - 1) * parent.pagesX + std::min(x >> 1, parent.pagesX - 1);
+        }
+
+        void VirtualTexture::requestPage(uint32_t page) {
+            pages[page].loading = true;
+            pagesLoading++;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                reading++;
+            }
+            uint32_t level, x, y;
+            pageCoordinates(page, level, x, y);
+            pool.submit([this, page, level, x, y]() {
+                LoadedPage result{ page, std::vector<uint8_t>(pageBytes()) };
+                if (!reader(level, x, y, pageSize, border, result.texels.data())) {
+                    fprintf(stderr, "VirtualTexture: could not read page %u, %u of level %u\n", x, y, level);
+                    result.texels.clear();
+                }
+                // Notify under the lock, the destructor may run as soon as reading reaches zero
+                std::lock_guard<std::mutex> lock(mutex);
+                loaded.push_back(std::move(result));
+                reading--;
+                condition.notify_all();
+            });
+        }
+
+        void VirtualTexture::releaseRetiredSlots(std::vector<VkSparseImageMemoryBind> &binds) {
+            auto retired = std::stable_partition(retiringSlots.begin(), retiringSlots.end(), [this](const RetiringSlot &retiring) {
+                return retiring.update > retiredUpdate;
+            });
+            for (auto retiring = retired; retiring != retiringSlots.end(); ++retiring) {
+                // Pages bound to another slot since then already replaced this binding
+                if (pages[retiring->page].slot == notResident) {
+                    binds.push_back(sparseBind(retiring->page, notResident));
+                }
+                slotPages[retiring->slot] = notResident;
+                freeSlots.push_back(retiring->slot);
+            }
+            retiringSlots.erase(retired, retiringSlots.end());
+        }
+
+        uint32_t VirtualTexture::acquireSlot(std::vector<uint32_t> &changedPages, size_t deferred) {
+            if (!freeSlots.empty()) {
+                const uint32_t slot = freeSlots.back();
+                freeSlots.pop_back();
+                return slot;
+            }
+            // Slots already retiring are enough for the pages waiting on them
+            if (retiringSlots.size() > deferred) {
+                return notResident;
+            }
+            // Recently requested pages are likely still on screen, feedback only samples some pixels so this is no guarantee
+            const uint64_t frameCount = frames.size();
+            uint32_t victim = notResident;
+            for (uint32_t slot = 0; slot < slotPages.size(); slot++) {
+                if (slotPages[slot] == notResident || pages[slotPages[slot]].slot != slot) {
+                    continue;
+                }
+                const Page &page = pages[slotPages[slot]];
+                if (page.pinned || page.lastUsed + frameCount >= updateCount) {
+                    continue;
+                }
+                if (victim == notResident || page.lastUsed < pages[slotPages[victim]].lastUsed) {
+                    victim = slot;
+                }
+            }
+            if (victim == notResident) {
+                return notResident;
+            }
+            const uint32_t evicted = slotPages[victim];
+            pages[evicted].slot = notResident;
+            changedPages.push_back(evicted);
+            residentPages--;
+            if (sparse) {
+                // Frames in flight may still sample the page, and sparse binds aren't ordered with their submissions.
+                // The slot stays bound until the frame that drops the page from the table has retired
+                retiringSlots.push_back({ victim, evicted, updateCount });
+                return notResident;
+            }
+            // Atlas slots are overwritten by copies recorded after the barrier on earlier fragment reads
+            slotPages[victim] = notResident;
+            return victim;
+        }
+
+        VkSparseImageMemoryBind VirtualTexture::sparseBind(uint32_t page, uint32_t slot) const {
+            uint32_t level, x, y;
+            pageCoordinates(page, level, x, y);
+            VkSparseImageMemoryBind bind{};
+            bind.subresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0 };
+            bind.offset = { static_cast<int32_t>(x * pageSize), static_cast<int32_t>(y * pageSize), 0 };
+            // Blocks at the right and bottom edge end with the level
+            bind.extent = { std::min(pageSize, levels[level].width - x * pageSize), std::min(pageSize, levels[level].height - y * pageSize), 1 };
+            bind.memory = slot == notResident ? VK_NULL_HANDLE : imageMemory;
+            bind.memoryOffset = slot == notResident ? 0 : slot * slotSize;
+            return bind;
+        }
+
+        VkBufferImageCopy VirtualTexture::pageCopy(uint32_t page, uint32_t slot, VkDeviceSize bufferOffset) const {
+            VkBufferImageCopy copy{};
+            copy.bufferOffset = bufferOffset;
+            copy.bufferRowLength = pageSize + 2 * border;
+            copy.bufferImageHeight = pageSize + 2 * border;
+            copy.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+            if (sparse) {
+                uint32_t level, x, y;
+                pageCoordinates(page, level, x, y);
+                copy.imageSubresource.mipLevel = level;
+                copy.imageOffset = { static_cast<int32_t>(x * pageSize), static_cast<int32_t>(y * pageSize), 0 };
+                copy.imageExtent = { std::min(pageSize, levels[level].width - x * pageSize), std::min(pageSize, levels[level].height - y * pageSize), 1 };
+            } else {
+                const uint32_t physicalSize = pageSize + 2 * border;
+                copy.imageOffset = { static_cast<int32_t>(slot % slotsPerRow * physicalSize), static_cast<int32_t>(slot / slotsPerRow * physicalSize), 0 };
+                copy.imageExtent = { physicalSize, physicalSize, 1 };
+            }
+            return copy;
+        }
+
+        void VirtualTexture::bindSparse(const std::vector<VkSparseImageMemoryBind> &binds, const VkSparseMemoryBind *mipTailBind) {
+            VkSparseImageMemoryBindInfo imageBindInfo{};
+            imageBindInfo.image = image;
+            imageBindInfo.bindCount = static_cast<uint32_t>(binds.size());
+            imageBindInfo.pBinds = binds.data();
+            VkSparseImageOpaqueMemoryBindInfo opaqueBindInfo{};
+            opaqueBindInfo.image = image;
+            opaqueBindInfo.bindCount = 1;
+            opaqueBindInfo.pBinds = mipTailBind;
+
+            VkBindSparseInfo bindSparseInfo = Initializers::bindSparseInfo();
+            bindSparseInfo.imageBindCount = binds.empty() ? 0 : 1;
+            bindSparseInfo.pImageBinds = &imageBindInfo;
+            bindSparseInfo.imageOpaqueBindCount = mipTailBind ? 1 : 0;
+            bindSparseInfo.pImageOpaqueBinds = &opaqueBindInfo;
+            // Pages are copied right after binding, wait here instead of chaining semaphores into the frame
+            VK_CHECK_RESULT(vkQueueBindSparse(queue, 1, &bindSparseInfo, bindFence))
+            VK_CHECK_RESULT(vkWaitForFences(device->getLogicalDevice(), 1, &bindFence, VK_TRUE, UINT64_MAX))
+            VK_CHECK_RESULT(vkResetFences(device->getLogicalDevice(), 1, &bindFence))
+        }
+
+        void VirtualTexture::update(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t maxUploads) {
+            Frame &frame = frames[frameIndex];
+            updateCount++;
+            // The frame previously recorded with frameIndex completed, and every update submitted before it
+            retiredUpdate = std::max(retiredUpdate, frame.lastUpdate);
+            frame.lastUpdate = updateCount;
+
+            // Pages the frame asked for, coarsest first since those replace the blurriest fallbacks
+            auto *requests = static_cast<uint32_t *>(frame.feedback.mapped);
+            std::vector<uint32_t> missing;
+            for (uint32_t page = 0; feedback && page < pages.size(); page++) {
+                if (requests[page] == 0) {
+                    continue;
+                }
+                requests[page] = 0;
+                // The shader sampled an ancestor until the page arrives, the whole chain stays in use
+                for (uint32_t used = page; used != notResident && pages[used].lastUsed != updateCount; used = parentPage(used)) {
+                    pages[used].lastUsed = updateCount;
+                }
+                if (pages[page].slot == notResident && !pages[page].loading) {
+                    missing.push_back(page);
+                }
+            }
+            for (auto page = missing.rbegin(); page != missing.rend() && pagesLoading < maxUploads * readsPerUpload; ++page) {
+                requestPage(*page);
+            }
+
+            std::vector<LoadedPage> uploads;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                while (!loaded.empty() && uploads.size() < maxUploads) {
+                    uploads.push_back(std::move(loaded.front()));
+                    loaded.pop_front();
+                }
+            }
+
+            std::vector<uint32_t> changedPages;
+            std::vector<VkSparseImageMemoryBind> binds;
+            if (sparse) {
+                releaseRetiredSlots(binds);
+            }
+            std::vector<const LoadedPage *> staged;
+            std::vector<LoadedPage> deferred;
+            for (LoadedPage &upload : uploads) {
+                Page &page = pages[upload.page];
+                // A page read again before its old sparse slot retired takes that slot back, it is still bound there
+                auto retiring = std::find_if(retiringSlots.begin(), retiringSlots.end(), [&upload](const RetiringSlot &slot) {
+                    return slot.page == upload.page;
+                });
+                const bool reclaimed = retiring != retiringSlots.end() && !upload.texels.empty();
+                uint32_t slot = notResident;
+                if (reclaimed) {
+                    slot = retiring->slot;
+                    retiringSlots.erase(retiring);
+                } else if (!upload.texels.empty()) {
+                    slot = acquireSlot(changedPages, deferred.size());
+                }
+                if (slot == notResident && !upload.texels.empty() && retiringSlots.size() > deferred.size()) {
+                    // A sparse slot frees once its frames retired, the page waits for it
+                    deferred.push_back(std::move(upload));
+                    continue;
+                }
+                page.loading = false;
+                pagesLoading--;
+                if (slot == notResident) {
+                    // Unreadable, or every page is in use, later feedback asks for this one again
+                    continue;
+                }
+                page.slot = slot;
+                // Fresh pages count as used so the next acquireSlot doesn't take them back right away
+                page.lastUsed = updateCount;
+                slotPages[slot] = upload.page;
+                residentPages++;
+                changedPages.push_back(upload.page);
+                staged.push_back(&upload);
+                if (sparse && !reclaimed) {
+                    binds.push_back(sparseBind(upload.page, slot));
+                }
+            }
+            if (!binds.empty()) {
+                bindSparse(binds);
+            }
+            if (!deferred.empty()) {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (auto upload = deferred.rbegin(); upload != deferred.rend(); ++upload) {
+                    loaded.push_front(std::move(*upload));
+                }
+            }
+
+            const VkDeviceSize pagesSize = staged.size() * pageBytes();
+            const VkDeviceSize stagingSize = pagesSize + changedPages.size() * sizeof(uint32_t);
+            if (stagingSize > frame.stagingCapacity) {
+                if (frame.staging.mapped) {
+                    frame.staging.unmap();
+                }
+                frame.staging.destroy();
+                frame.staging = Buffers{};
+                frame.stagingCapacity = std::max(stagingSize, static_cast<VkDeviceSize>(maxUploads) * pageBytes());
+                VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                     &frame.staging, frame.stagingCapacity))
+                VK_CHECK_RESULT(frame.staging.map())
+            }
+
+            // Page table reads of earlier frames have to finish before the table and the cache change
+            VkBufferMemoryBarrier tableBarrier = Initializers::bufferMemoryBarrier();
+            tableBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            tableBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            tableBarrier.buffer = pageTable.buffer;
+            tableBarrier.size = VK_WHOLE_SIZE;
+            VkImageMemoryBarrier imageBarrier = Initializers::imageMemoryBarrier();
+            imageBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            imageBarrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            imageBarrier.image = image;
+            imageBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, sparse ? levelCount : 1, 0, 1 };
+            const uint32_t imageBarrierCount = staged.empty() ? 0 : 1;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr,
+                                 1, &tableBarrier, imageBarrierCount, &imageBarrier);
+
+            // The shader rotates the pixels that write feedback with the frame
+            const auto frameStamp = static_cast<uint32_t>(updateCount);
+            vkCmdUpdateBuffer(commandBuffer, pageTable.buffer, offsetof(PageTableHeader, frame), sizeof(frameStamp), &frameStamp);
+
+            auto *stagingData = static_cast<uint8_t *>(frame.staging.mapped);
+            if (!staged.empty()) {
+                std::vector<VkBufferImageCopy> copies;
+                for (size_t i = 0; i < staged.size(); i++) {
+                    memcpy(stagingData + i * pageBytes(), staged[i]->texels.data(), pageBytes());
+                    copies.push_back(pageCopy(staged[i]->page, pages[staged[i]->page].slot, i * pageBytes()));
+                }
+                vkCmdCopyBufferToImage(commandBuffer, frame.staging.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                       static_cast<uint32_t>(copies.size()), copies.data());
+            }
+            if (!changedPages.empty()) {
+                auto *entries = reinterpret_cast<uint32_t *>(stagingData + pagesSize);
+                std::vector<VkBufferCopy> tableCopies;
+                for (size_t i = 0; i < changedPages.size(); i++) {
+                    entries[i] = pages[changedPages[i]].slot;
+                    tableCopies.push_back({ pagesSize + i * sizeof(uint32_t), sizeof(PageTableHeader) + changedPages[i] * sizeof(uint32_t), sizeof(uint32_t) });
+                }
+                vkCmdCopyBuffer(commandBuffer, frame.staging.buffer, pageTable.buffer, static_cast<uint32_t>(tableCopies.size()), tableCopies.data());
+            }
+
+            tableBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            tableBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            imageBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr,
+                                 1, &tableBarrier, imageBarrierCount, &imageBarrier);
+        }
+
+        void VirtualTexture::recordFeedbackBarrier(VkCommandBuffer commandBuffer) const {
+            VkMemoryBarrier memoryBarrier = Initializers::memoryBarrier();
+            memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+        }
+
+        void VirtualTexture::bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t set, uint32_t frameIndex) const {
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, set, 1, &frames[frameIndex].descriptorSet, 0, nullptr);
+        }
+    }
+}
@@ -0,0 +1,258 @@
+//
+// Created by agent on 10/19/26.
+//
+
+#ifndef LIGHTFIELDFORWARDRENDERER_VIRTUALTEXTURE_H
+#define LIGHTFIELDFORWARDRENDERER_VIRTUALTEXTURE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "Buffers.h"
+#include "DescriptorAllocator.h"
+#include "../ThreadPool.h"
+
+class Device;
+
+namespace Util {
+    namespace Renderer {
+        /*
+            RGBA8 texture of any size streamed page by page, only the pages fragment shaders asked for are resident
+            Pages live in a fixed number of cache slots, either an atlas image or memory bound to a sparse resident
+            image where the device supports it, so device memory stays bounded whatever the virtual size
+            Shaders sample through Shaders/virtualtexture.glsl, which walks the page table up to the finest resident
+            level and records the pages it wanted in the frame's feedback buffer
+            Without fragmentStoresAndAtomics shaders define VIRTUAL_TEXTURE_NO_FEEDBACK and only the pinned levels show
+            update reads that feedback once the frame completed, reads missing pages on the thread pool and uploads
+            the ones that finished, coarser levels first
+        */
+        class VirtualTexture {
+        public:
+            /**
+            * Reads a page on a worker thread
+            *
+            * @param texels (pageSize + 2 * border)² RGBA8 texels, starting border texels above and left of the page,
+            * coordinates outside the level are clamped to its edge
+            * @return False if the page could not be read, it is requested again by later feedback
+            */
+            using PageReader = std::function<bool(uint32_t level, uint32_t x, uint32_t y, uint32_t pageSize, uint32_t border, uint8_t *texels)>;
+
+            // Matches the page table header in Shaders/virtualtexture.glsl
+            static constexpr uint32_t maxLevels = 16;
+            // Page table entry of pages that are not resident, resident ones hold their cache slot
+            static constexpr uint32_t notResident = UINT32_MAX;
+            // Atlas pages repeat this many texels of their neighbours so bilinear filtering never crosses a page
+            static constexpr uint32_t atlasBorder = 4;
+
+            struct PageTableHeader {
+                uint32_t virtualSize[2];
+                uint32_t pageSize;
+                uint32_t border;
+                uint32_t levelCount;
+                uint32_t slotsPerRow;
+                uint32_t sparse;
+                uint32_t frame;
+                // Pages in x and y and the first entry of every level
+                uint32_t levels[maxLevels][4];
+            };
+
+            /** @brief Whether sparse residency was enabled on device and its graphics queue family can bind sparse memory */
+            static bool isSparseSupported(Device *device);
+
+            /**
+            * Requests fragmentStoresAndAtomics, which the feedback writes need, and the sparse residency features where
+            * the physical device supports them
+            */
+            static void enableFeatures(VkPhysicalDevice physicalDevice, VkPhysicalDeviceFeatures &features);
+
+            /**
+            * Reads pages baked offline as <directory>/<level>/<x>_<y>.<extension>
+            *
+            * @param tileBorder Border texels baked around every tile, at least the border pages are read with
+            */
+            static PageReader tileDirectory(const std::string &directory, uint32_t tileBorder, const std::string &extension = "png");
+
+            /**
+            * Creates the cache, page table and feedback buffers and makes the coarsest levels resident
+            *
+            * @param queue Queue of the graphics family, sparse bindings and the initial upload are submitted to it
+            * @param cacheSlots Pages resident at once, sparse images only use pageSize² texels per slot
+            * @param pageSize Sparse residency is only used when it matches the image granularity, 128 for RGBA8
+            */
+            VirtualTexture(Device *device, VkQueue queue, uint32_t frameCount, uint32_t width, uint32_t height, PageReader reader,
+                           uint32_t cacheSlots = 1024, uint32_t pageSize = 128, ThreadPool &pool = ThreadPool::global());
+
+            /** @brief Waits for outstanding page reads, the GPU must be done with the texture */
+            ~VirtualTexture();
+
+            VirtualTexture(const VirtualTexture &) = delete;
+
+            VirtualTexture &operator=(const VirtualTexture &) = delete;
+
+            /**
+            * Reads the feedback of frameIndex and queues reads of missing pages, then records the upload of pages read
+            * since the last call and the page table changes
+            *
+            * @note The GPU must be done with the previous frame that used frameIndex, record outside of a render pass
+            * before the draws sampling the texture. Frames have to be submitted to one queue in the order of their updates,
+            * sparse slots are reused once that order shows the frames sampling them retired
+            * @param maxUploads Pages uploaded by this call, more finished pages wait for the next one
+            */
+            void update(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t maxUploads = 32);
+
+            /** @brief Makes the feedback written by the frame's draws readable by update, record after them */
+            void recordFeedbackBarrier(VkCommandBuffer commandBuffer) const;
+
+            [[nodiscard]] VkDescriptorSetLayout getDescriptorSetLayout() const { return descriptorSetLayout; }
+
+            [[nodiscard]] VkDescriptorSet getDescriptorSet(uint32_t frameIndex) const { return frames[frameIndex].descriptorSet; }
+
+            void bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t set, uint32_t frameIndex) const;
+
+            [[nodiscard]] bool isSparse() const { return sparse; }
+
+            /** @brief Whether fragment shaders may write feedback, false if fragmentStoresAndAtomics wasn't enabled on device */
+            [[nodiscard]] bool hasFeedback() const { return feedback; }
+
+            [[nodiscard]] uint32_t getLevelCount() const { return levelCount; }
+
+            [[nodiscard]] uint32_t getCacheSlots() const { return static_cast<uint32_t>(slotPages.size()); }
+
+            /** @brief Pages resident in the cache, including the pinned ones */
+            [[nodiscard]] uint32_t getResidentPages() const { return residentPages; }
+
+        private:
+            struct Level {
+                uint32_t width;
+                uint32_t height;
+                uint32_t pagesX;
+                uint32_t pagesY;
+                uint32_t firstPage;
+            };
+
+            struct Page {
+                uint32_t slot = notResident;
+                // Update that last saw the page or one of its descendants requested
+                uint64_t lastUsed = 0;
+                bool loading = false;
+                // Pinned pages are never evicted, the shader's walk up the levels ends at them
+                bool pinned = false;
+            };
+
+            struct LoadedPage {
+                uint32_t page;
+                std::vector<uint8_t> texels;
+            };
+
+            struct Frame {
+                Buffers feedback;
+                Buffers staging;
+                VkDeviceSize stagingCapacity = 0;
+                VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+                // Update that last recorded this frame
+                uint64_t lastUpdate = 0;
+            };
+
+            // Sparse slot of an evicted page, its memory stays bound to the page until update retired
+            struct RetiringSlot {
+                uint32_t slot;
+                uint32_t page;
+                uint64_t update;
+            };
+
+            Device *device;
+            VkQueue queue;
+            ThreadPool &pool;
+            PageReader reader;
+            uint32_t width;
+            uint32_t height;
+            uint32_t pageSize;
+            uint32_t border = atlasBorder;
+            bool sparse = false;
+            bool feedback = false;
+
+            uint32_t levelCount = 0;
+            // Levels from here on are pinned, sparse images keep the levels of their mip tail resident
+            uint32_t firstPinnedLevel = 0;
+            uint32_t mipTailFirstLevel = 0;
+            std::vector<Level> levels;
+            std::vector<Page> pages;
+            // Page held by every cache slot
+            std::vector<uint32_t> slotPages;
+            std::vector<uint32_t> freeSlots;
+            uint32_t slotsPerRow = 0;
+            uint32_t residentPages = 0;
+            uint32_t pagesLoading = 0;
+            uint64_t updateCount = 0;
+            // Updates up to this one were recorded into frames the GPU completed
+            uint64_t retiredUpdate = 0;
+            std::vector<RetiringSlot> retiringSlots;
+
+            VkImage image = VK_NULL_HANDLE;
+            VkDeviceMemory imageMemory = VK_NULL_HANDLE;
+            // Sparse images only: memory backing the mip tail
+            VkDeviceMemory mipTailMemory = VK_NULL_HANDLE;
+            VkDeviceSize slotSize = 0;
+            VkFence bindFence = VK_NULL_HANDLE;
+            VkImageView view = VK_NULL_HANDLE;
+            VkSampler sampler = VK_NULL_HANDLE;
+            Buffers pageTable;
+            std::vector<Frame> frames;
+            VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+            DescriptorAllocator descriptorAllocator;
+
+            std::mutex mutex;
+            std::condition_variable condition;
+            std::deque<LoadedPage> loaded;
+            // Reads queued on the pool and not handed to loaded yet
+            size_t reading = 0;
+
+            [[nodiscard]] uint32_t pageBytes() const { return (pageSize + 2 * border) * (pageSize + 2 * border) * 4; }
+
+            void createLevels();
+
+            bool createSparseImage(uint32_t cacheSlots);
+
+            /** @brief Lowers cacheSlots when the atlas would exceed the image size limit */
+            void createAtlasImage(uint32_t &cacheSlots);
+
+            void createDescriptors();
+
+            void loadPinnedPages();
+
+            void pageCoordinates(uint32_t page, uint32_t &level, uint32_t &x, uint32_t &y) const;
+
+            uint32_t parentPage(uint32_t page) const;
+
+            void requestPage(uint32_t page);
+
+            /** @brief Unbinds the pages of retiring sparse slots whose frames completed and frees the slots */
+            void releaseRetiredSlots(std::vector<VkSparseImageMemoryBind> &binds);
+
+            /**
+            * Frees a slot, evicting the least recently used page nobody requested in the frames still in flight
+            *
+            * @param deferred Pages of this update already waiting for a retiring slot
+            * @return The slot with the evicted page's entry added, notResident if every page is in use or, for sparse
+            * images, if the slot first has to retire
+            */
+            uint32_t acquireSlot(std::vector<uint32_t> &changedPages, size_t deferred);
+
+            VkSparseImageMemoryBind sparseBind(uint32_t page, uint32_t slot) const;
+
+            /** @brief Submits binds to the queue and waits for them */
+            void bindSparse(const std::vector<VkSparseImageMemoryBind> &binds, const VkSparseMemoryBind *mipTailBind = nullptr);
+
+            VkBufferImageCopy pageCopy(uint32_t page, uint32_t slot, VkDeviceSize bufferOffset) const;
+        };
+    }
+}
+
+#endif //LIGHTFIELDFORWARDRENDERER_VIRTUALTEXTURE_H
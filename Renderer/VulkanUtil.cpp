@@ -17,6 +17,7 @@
 #include "VulkanUtil.h"
 #include "Vulkan/Initializers.h"
 #include "Vulkan/Debug.h"
+#include "Vulkan/TextureCache.h"
 
 namespace Util {
     namespace Renderer {
@@ -756,6 +757,8 @@ namespace Util {
 
         bool VulkanUtil::destroyVulkan() {
             // Clean up Vulkan resources
+            // Models are gone by now, free the textures they left in the cache
+            vkglTF::TextureCache::global().clear();
             syncDevices.destroySemaphores();
             swapChain.cleanup();
             xrSwapChains.cleanup();
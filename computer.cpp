@@ -94,7 +94,7 @@ void computer::buildCommandBuffers()
         // Bind scene matrices descriptor to set 0
 //        vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
 //        vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, wireframe ? pipelines.wireframe : pipelines.solid);
-        glTFModel.draw(drawCmdBuffers[i], 0, pipelineLayout);
+        glTFModel.draw(drawCmdBuffers[i], Util::Renderer::vkglTF::RenderFlags::PushMeshMatrix, pipelineLayout);
         vkCmdEndRenderPass(drawCmdBuffers[i]);
         VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]))
     }
@@ -142,8 +142,8 @@ void computer::setupDescriptors()
             descriptorSetLayouts.textures};
     VkPipelineLayoutCreateInfo pipelineLayoutCI = Initializers::pipelineLayoutCreateInfo(setLayouts.data(), static_cast<uint32_t>(setLayouts.size()));
 
-    // We will use push constants to push the local matrices of a primitive to the vertex shader
-    VkPushConstantRange pushConstantRange = Initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT, sizeof(glm::mat4), 0);
+    // We will use push constants to push the local matrices of a primitive and its joint palette offset to the vertex shader
+    VkPushConstantRange pushConstantRange = Initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT, Util::Renderer::vkglTF::Mesh::pushConstantSize, 0);
     // Push constant ranges are part of the pipeline layout
     pipelineLayoutCI.pushConstantRangeCount = 1;
     pipelineLayoutCI.pPushConstantRanges    = &pushConstantRange;
@@ -16,6 +16,8 @@ layout (set = 0, binding = 0) uniform UBOScene
 
 layout(push_constant) uniform PushConsts {
     mat4 model;
+    // First palette entry of the mesh's skin
+    uint jointOffset;
 } primitive;
 
 layout(std430, set = 1, binding = 0) readonly buffer JointMatrices {
@@ -35,11 +37,12 @@ void main()
     outUV = inUV;
 
     // Calculate skinned matrix from weights and joint indices of the current vertex
+    uint base = primitive.jointOffset;
     mat4 skinMat =
-    inJointWeights.x * jointMatrices[int(inJointIndices.x)] +
-    inJointWeights.y * jointMatrices[int(inJointIndices.y)] +
-    inJointWeights.z * jointMatrices[int(inJointIndices.z)] +
-    inJointWeights.w * jointMatrices[int(inJointIndices.w)];
+    inJointWeights.x * jointMatrices[base + uint(inJointIndices.x)] +
+    inJointWeights.y * jointMatrices[base + uint(inJointIndices.y)] +
+    inJointWeights.z * jointMatrices[base + uint(inJointIndices.z)] +
+    inJointWeights.w * jointMatrices[base + uint(inJointIndices.w)];
 
     gl_Position = uboScene.projection * uboScene.view * primitive.model * skinMat * vec4(inPos.xyz, 1.0);
 